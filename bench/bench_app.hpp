@@ -0,0 +1,84 @@
+//
+// Created by Alcachofa
+//
+
+#pragma once
+
+#include <utility>
+#include <functional>
+
+#include <benchmark/benchmark.h>
+
+#include <app.hpp>
+
+namespace arti::bench {
+
+    // Headless app that hands the renderer to `frame` from every onUpdate, the
+    // app exits as soon as `frame` returns false
+    class bench_app : public app {
+
+    public:
+        using frame_fn = std::function<bool(renderer&)>;
+
+        explicit bench_app(frame_fn frame) : frame(std::move(frame)) {}
+
+        bool onUpdate(float) override {
+            return frame(*graphics);
+        }
+
+    private:
+        frame_fn frame;
+    };
+
+    inline constexpr int benchWidth = 1280;
+    inline constexpr int benchHeight = 720;
+
+    // Runs `frame` once per benchmark iteration, so every iteration is a full headless
+    // frame (update, layer composition and display). `finish` gets the renderer once the
+    // last frame has been rendered, for counters out of renderer::getFrameStats()
+    inline void runFrames(benchmark::State& state, const std::function<void(renderer&)>& setup, const std::function<void(renderer&)>& frame,
+                          const std::function<void(renderer&)>& finish = {}) {
+        bool initialized = false;
+
+        bench_app bench([&](renderer& graphics) {
+            if (! initialized) {
+                setup(graphics);
+                initialized = true;
+            }
+
+            if (! state.KeepRunning()) {
+                if (finish) {
+                    finish(graphics);
+                }
+                return false;
+            }
+
+            frame(graphics);
+            return true;
+        });
+
+        if (! bench.initHeadless("ArtiApp_bench", { benchWidth, benchHeight })) {
+            state.SkipWithError("Couldn't create the headless target");
+            return;
+        }
+
+        bench.run();
+    }
+
+    // Runs the whole benchmark loop inside the first onUpdate, for code that needs a
+    // live renderer but doesn't care about frames
+    inline void runInFrame(benchmark::State& state, const std::function<void(benchmark::State&, renderer&)>& body) {
+        bench_app bench([&](renderer& graphics) {
+            body(state, graphics);
+            return false;
+        });
+
+        if (! bench.initHeadless("ArtiApp_bench", { benchWidth, benchHeight })) {
+            state.SkipWithError("Couldn't create the headless target");
+            return;
+        }
+
+        bench.run();
+    }
+
+}
@@ -0,0 +1,40 @@
+//
+// Created by Alcachofa
+//
+
+#include <string>
+#include <vector>
+#include <cstring>
+
+#include <benchmark/benchmark.h>
+
+// Same as benchmark_main, but unless --benchmark_out is given the results are also
+// written to ArtiApp_bench.json so runs can be compared across commits
+int main(int argc, char** argv) {
+    std::vector<char*> args(argv, argv + argc);
+
+    bool hasOut = false;
+    for (int i = 1; i < argc; ++i) {
+        if (std::strncmp(argv[i], "--benchmark_out=", 16) == 0) {
+            hasOut = true;
+        }
+    }
+
+    std::string outArg = "--benchmark_out=ArtiApp_bench.json";
+    std::string formatArg = "--benchmark_out_format=json";
+    if (! hasOut) {
+        args.push_back(outArg.data());
+        args.push_back(formatArg.data());
+    }
+
+    int count = static_cast<int>(args.size());
+    benchmark::Initialize(&count, args.data());
+
+    if (benchmark::ReportUnrecognizedArguments(count, args.data())) {
+        return 1;
+    }
+
+    benchmark::RunSpecifiedBenchmarks();
+    benchmark::Shutdown();
+    return 0;
+}
@@ -0,0 +1,23 @@
+//
+// Created by Alcachofa
+//
+
+#include <benchmark/benchmark.h>
+
+#include <input.hpp>
+
+namespace {
+
+    // update() walks every key and button each frame whether or not anything changed,
+    // so the idle case is the one that matters
+    void BM_inputUpdate(benchmark::State& state) {
+        arti::input_manager input(nullptr);
+        for (auto _ : state) {
+            input.update();
+            benchmark::DoNotOptimize(input.isKeyPressed(arti::key_t::Space));
+        }
+    }
+
+}
+
+BENCHMARK(BM_inputUpdate);
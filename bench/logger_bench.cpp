@@ -0,0 +1,106 @@
+//
+// Created by Alcachofa
+//
+
+#include <string>
+#include <filesystem>
+
+#include <benchmark/benchmark.h>
+
+#include <utils/logger.hpp>
+
+namespace {
+
+    using namespace arti;
+
+    // Console output is turned off and everything goes to a file, so the numbers don't
+    // depend on the terminal. Timing is per call on every logging thread
+    std::string benchLogPath() {
+        return (std::filesystem::temp_directory_path() / "arti_logger_bench.log").string();
+    }
+
+    uint64_t droppedBefore = 0;
+
+    void beginLogging(benchmark::State& state, bool async, logger::overflow_policy policy) {
+        if (state.thread_index() != 0) {
+            return;
+        }
+
+        logger::setConsoleOutput(false);
+        logger::setLogFile(benchLogPath());
+        droppedBefore = logger::getDroppedCount();
+
+        if (async) {
+            logger::startAsync(logger::defaultQueueSize, policy);
+        }
+    }
+
+    void endLogging(benchmark::State& state) {
+        if (state.thread_index() != 0) {
+            return;
+        }
+
+        const auto dropped = logger::getDroppedCount() - droppedBefore;
+
+        logger::stopAsync();
+        logger::setLogFile({});
+        logger::setConsoleOutput(true);
+
+        state.counters["dropped"] = benchmark::Counter(static_cast<double>(dropped));
+    }
+
+    void logLoop(benchmark::State& state) {
+        int64_t i = 0;
+        for (auto _ : state) {
+            logger::info("Frame {} took {:.3f} ms on thread {}", i++, 16.6, state.thread_index());
+        }
+        state.SetItemsProcessed(state.iterations());
+    }
+
+    // Same message through ARTI_LOG_INFO, the arguments are copied raw and formatted by the writer
+    void deferredLoop(benchmark::State& state) {
+        int64_t i = 0;
+        for (auto _ : state) {
+            ARTI_LOG_INFO("Frame {} took {:.3f} ms on thread {}", i++, 16.6, state.thread_index());
+        }
+        state.SetItemsProcessed(state.iterations());
+    }
+
+    void BM_loggerSync(benchmark::State& state) {
+        beginLogging(state, false, logger::overflow_policy::Drop);
+        logLoop(state);
+        endLogging(state);
+    }
+
+    void BM_loggerAsyncDrop(benchmark::State& state) {
+        beginLogging(state, true, logger::overflow_policy::Drop);
+        logLoop(state);
+        endLogging(state);
+    }
+
+    void BM_loggerAsyncBlock(benchmark::State& state) {
+        beginLogging(state, true, logger::overflow_policy::Block);
+        logLoop(state);
+        endLogging(state);
+    }
+
+    void BM_loggerAsyncDeferred(benchmark::State& state) {
+        beginLogging(state, true, logger::overflow_policy::Drop);
+        deferredLoop(state);
+        endLogging(state);
+    }
+
+    // Below the runtime level nothing is formatted or queued
+    void BM_loggerFiltered(benchmark::State& state) {
+        logger::setLevel(logger::level::Warning);
+        deferredLoop(state);
+        logger::setLevel(logger::level::Debug);
+    }
+
+}
+
+BENCHMARK(BM_loggerSync)->ThreadRange(1, 8)->UseRealTime();
+BENCHMARK(BM_loggerAsyncDrop)->ThreadRange(1, 8)->UseRealTime();
+BENCHMARK(BM_loggerAsyncBlock)->ThreadRange(1, 8)->UseRealTime();
+BENCHMARK(BM_loggerAsyncDeferred)->ThreadRange(1, 8)->UseRealTime();
+BENCHMARK(BM_loggerFiltered);
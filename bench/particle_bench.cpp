@@ -0,0 +1,72 @@
+//
+// Created by Alcachofa
+//
+
+#include <benchmark/benchmark.h>
+
+#include <particle_emitter.hpp>
+
+#include <utils/simd.hpp>
+#include <utils/random.hpp>
+
+#include "bench_app.hpp"
+
+namespace {
+
+    using namespace arti;
+    using arti::bench::benchWidth;
+    using arti::bench::benchHeight;
+    using simd_level = arti::simd::level;
+
+    // Spread over the screen with slow velocities and lifetimes long enough that nothing dies
+    void fill(particle_emitter& emitter, std::size_t count) {
+        emitter.setCapacity(count);
+        emitter.setGravity({ 0.0f, 9.8f });
+        emitter.setDrag(0.1f);
+
+        for (std::size_t i = 0; i < count; ++i) {
+            emitter.spawn({ f_random<float>::GetUnder(benchWidth), f_random<float>::GetUnder(benchHeight) },
+                          { f_random<float>::GetRange(-1.0f, 1.0f), f_random<float>::GetRange(-1.0f, 1.0f) },
+                          1e9f, pixel(255, 160, 32));
+        }
+    }
+
+    // Arguments are (particles, simd_level)
+    void BM_particleUpdate(benchmark::State& state) {
+        particle_emitter emitter;
+        fill(emitter, state.range(0));
+
+        const auto level = simd_level(state.range(1));
+        if (simd::setLevel(level) != level) {
+            state.SkipWithError("SIMD level not supported by this CPU");
+            simd::setLevel(simd::bestLevel());
+            return;
+        }
+
+        for (auto _ : state) {
+            emitter.update(1.0f / 60.0f);
+            benchmark::ClobberMemory();
+        }
+
+        simd::setLevel(simd::bestLevel());
+        state.SetItemsProcessed(state.iterations() * state.range(0));
+    }
+
+    // Arguments are (particles, threads), 0 threads uses every core. Full frames, update and draw
+    void BM_particleFrame(benchmark::State& state) {
+        particle_emitter emitter;
+        fill(emitter, state.range(0));
+        emitter.setThreadCount(to<uint32_t>(state.range(1)));
+
+        bench::runFrames(state, [](renderer&) {}, [&](renderer& graphics) {
+            emitter.update(1.0f / 60.0f);
+            emitter.render(graphics);
+        });
+
+        state.SetItemsProcessed(state.iterations() * state.range(0));
+    }
+
+}
+
+BENCHMARK(BM_particleUpdate)->ArgsProduct({ { 100000, 1000000 }, { 0, 1, 2 } })->Unit(benchmark::kMillisecond);
+BENCHMARK(BM_particleFrame)->ArgsProduct({ { 100000, 1000000 }, { 1, 0 } })->Unit(benchmark::kMillisecond);
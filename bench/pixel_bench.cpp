@@ -0,0 +1,116 @@
+//
+// Created by Alcachofa
+//
+
+#include <vector>
+
+#include <benchmark/benchmark.h>
+
+#include <pixel.hpp>
+
+#include <utils/random.hpp>
+
+namespace {
+
+    using arti::pixel;
+
+    std::vector<pixel> randomPixels(std::size_t count) {
+        std::vector<pixel> pixels(count);
+        for (auto& p : pixels) {
+            p.n = arti::i_random<uint32_t>::Get();
+        }
+        return pixels;
+    }
+
+    void BM_pixelScale(benchmark::State& state) {
+        auto pixels = randomPixels(state.range(0));
+        for (auto _ : state) {
+            for (auto& p : pixels) {
+                p = p * 0.99f;
+            }
+            benchmark::ClobberMemory();
+        }
+        state.SetItemsProcessed(state.iterations() * state.range(0));
+    }
+
+    void BM_pixelDivide(benchmark::State& state) {
+        auto pixels = randomPixels(state.range(0));
+        for (auto _ : state) {
+            for (auto& p : pixels) {
+                p /= 1.01f;
+            }
+            benchmark::ClobberMemory();
+        }
+        state.SetItemsProcessed(state.iterations() * state.range(0));
+    }
+
+    void BM_pixelAdd(benchmark::State& state) {
+        auto pixels = randomPixels(state.range(0));
+        auto other = randomPixels(state.range(0));
+        for (auto _ : state) {
+            for (std::size_t i = 0; i < pixels.size(); ++i) {
+                pixels[i] = pixels[i] + other[i];
+            }
+            benchmark::ClobberMemory();
+        }
+        state.SetItemsProcessed(state.iterations() * state.range(0));
+    }
+
+    void BM_pixelSub(benchmark::State& state) {
+        auto pixels = randomPixels(state.range(0));
+        auto other = randomPixels(state.range(0));
+        for (auto _ : state) {
+            for (std::size_t i = 0; i < pixels.size(); ++i) {
+                pixels[i] -= other[i];
+            }
+            benchmark::ClobberMemory();
+        }
+        state.SetItemsProcessed(state.iterations() * state.range(0));
+    }
+
+    void BM_pixelInv(benchmark::State& state) {
+        auto pixels = randomPixels(state.range(0));
+        for (auto _ : state) {
+            for (auto& p : pixels) {
+                p = p.inv();
+            }
+            benchmark::ClobberMemory();
+        }
+        state.SetItemsProcessed(state.iterations() * state.range(0));
+    }
+
+    void BM_pixelLerp(benchmark::State& state) {
+        auto from = randomPixels(state.range(0));
+        auto to = randomPixels(state.range(0));
+        std::vector<pixel> out(state.range(0));
+        for (auto _ : state) {
+            for (std::size_t i = 0; i < out.size(); ++i) {
+                out[i] = arti::pixelLerp(from[i], to[i], 0.25f);
+            }
+            benchmark::ClobberMemory();
+        }
+        state.SetItemsProcessed(state.iterations() * state.range(0));
+    }
+
+    void BM_pixelF(benchmark::State& state) {
+        std::vector<pixel> out(state.range(0));
+        for (auto _ : state) {
+            float t = 0.0f;
+            for (auto& p : out) {
+                p = arti::pixelF(t, 1.0f - t, 0.5f);
+                t += 1.0f / out.size();
+            }
+            benchmark::ClobberMemory();
+        }
+        state.SetItemsProcessed(state.iterations() * state.range(0));
+    }
+
+}
+
+BENCHMARK(BM_pixelScale)->Arg(4096)->Arg(1 << 20);
+BENCHMARK(BM_pixelDivide)->Arg(4096)->Arg(1 << 20);
+BENCHMARK(BM_pixelAdd)->Arg(4096)->Arg(1 << 20);
+BENCHMARK(BM_pixelSub)->Arg(4096)->Arg(1 << 20);
+BENCHMARK(BM_pixelInv)->Arg(4096)->Arg(1 << 20);
+BENCHMARK(BM_pixelLerp)->Arg(4096)->Arg(1 << 20);
+BENCHMARK(BM_pixelF)->Arg(4096);
@@ -0,0 +1,130 @@
+//
+// Created by Alcachofa
+//
+
+#include <vector>
+
+#include <benchmark/benchmark.h>
+
+#include <pixel_ops.hpp>
+
+#include <utils/simd.hpp>
+#include <utils/random.hpp>
+
+namespace {
+
+    using arti::pixel;
+    using simd_level = arti::simd::level;
+
+    // One 3840x2160 frame
+    constexpr std::size_t pixelCount4K = 3840 * 2160;
+
+    std::vector<pixel> randomPixels(std::size_t count) {
+        std::vector<pixel> pixels(count);
+        for (auto& p : pixels) {
+            p.n = arti::i_random<uint32_t>::Get();
+        }
+        return pixels;
+    }
+
+    // Forces the benchmarked path and restores the best one afterwards; the range argument
+    // is the simd_level, and -1 runs the plain per pixel operator loop
+    template <typename Kernel, typename Loop>
+    void runSpanBenchmark(benchmark::State& state, Kernel kernel, Loop loop) {
+        auto dst = randomPixels(pixelCount4K);
+        auto src = randomPixels(pixelCount4K);
+
+        const auto level = state.range(0);
+        if (level >= 0 && arti::simd::setLevel(simd_level(level)) != simd_level(level)) {
+            state.SkipWithError("SIMD level not supported by this CPU");
+            arti::simd::setLevel(arti::simd::bestLevel());
+            return;
+        }
+
+        for (auto _ : state) {
+            if (level >= 0) {
+                kernel(dst, src);
+            }
+            else {
+                loop(dst, src);
+            }
+            benchmark::ClobberMemory();
+        }
+
+        arti::simd::setLevel(arti::simd::bestLevel());
+        state.SetItemsProcessed(state.iterations() * pixelCount4K);
+        state.SetBytesProcessed(state.iterations() * pixelCount4K * sizeof(pixel));
+    }
+
+    void BM_spanScale(benchmark::State& state) {
+        runSpanBenchmark(state,
+            [](std::vector<pixel>& dst, const std::vector<pixel>&) { arti::pixel_ops::scale(dst, 0.99f); },
+            [](std::vector<pixel>& dst, const std::vector<pixel>&) {
+                for (auto& p : dst) {
+                    p *= 0.99f;
+                }
+            });
+    }
+
+    void BM_spanAdd(benchmark::State& state) {
+        runSpanBenchmark(state,
+            [](std::vector<pixel>& dst, const std::vector<pixel>& src) { arti::pixel_ops::add(dst, src); },
+            [](std::vector<pixel>& dst, const std::vector<pixel>& src) {
+                for (std::size_t i = 0; i < dst.size(); ++i) {
+                    dst[i] += src[i];
+                }
+            });
+    }
+
+    void BM_spanSub(benchmark::State& state) {
+        runSpanBenchmark(state,
+            [](std::vector<pixel>& dst, const std::vector<pixel>& src) { arti::pixel_ops::sub(dst, src); },
+            [](std::vector<pixel>& dst, const std::vector<pixel>& src) {
+                for (std::size_t i = 0; i < dst.size(); ++i) {
+                    dst[i] -= src[i];
+                }
+            });
+    }
+
+    void BM_spanLerp(benchmark::State& state) {
+        runSpanBenchmark(state,
+            [](std::vector<pixel>& dst, const std::vector<pixel>& src) { arti::pixel_ops::lerp(dst, src, 0.1f); },
+            [](std::vector<pixel>& dst, const std::vector<pixel>& src) {
+                for (std::size_t i = 0; i < dst.size(); ++i) {
+                    dst[i] = arti::pixelLerp(dst[i], src[i], 0.1f);
+                }
+            });
+    }
+
+    void BM_spanInv(benchmark::State& state) {
+        runSpanBenchmark(state,
+            [](std::vector<pixel>& dst, const std::vector<pixel>&) { arti::pixel_ops::inv(dst); },
+            [](std::vector<pixel>& dst, const std::vector<pixel>&) {
+                for (auto& p : dst) {
+                    p = p.inv();
+                }
+            });
+    }
+
+    void BM_spanBlend(benchmark::State& state) {
+        runSpanBenchmark(state,
+            [](std::vector<pixel>& dst, const std::vector<pixel>& src) { arti::pixel_ops::blend(dst, src); },
+            [](std::vector<pixel>& dst, const std::vector<pixel>& src) {
+                for (std::size_t i = 0; i < dst.size(); ++i) {
+                    dst[i] = arti::pixelBlend(dst[i], src[i]);
+                }
+            });
+    }
+
+    void spanLevels(benchmark::internal::Benchmark* bench) {
+        bench->ArgName("level")->Arg(-1)->Arg(int(simd_level::Scalar))->Arg(int(simd_level::SSE2))->Arg(int(simd_level::AVX2))->Unit(benchmark::kMicrosecond);
+    }
+
+}
+
+BENCHMARK(BM_spanScale)->Apply(spanLevels);
+BENCHMARK(BM_spanAdd)->Apply(spanLevels);
+BENCHMARK(BM_spanSub)->Apply(spanLevels);
+BENCHMARK(BM_spanLerp)->Apply(spanLevels);
+BENCHMARK(BM_spanInv)->Apply(spanLevels);
+BENCHMARK(BM_spanBlend)->Apply(spanLevels);
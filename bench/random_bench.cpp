@@ -0,0 +1,232 @@
+//
+// Created by Alcachofa
+//
+
+#include <cmath>
+#include <random>
+#include <vector>
+
+#include <benchmark/benchmark.h>
+
+#include <utils/simd.hpp>
+#include <utils/utils.hpp>
+#include <utils/random.hpp>
+
+namespace {
+
+    using namespace arti;
+    using simd_level = arti::simd::level;
+
+    // Enough for a big particle burst
+    constexpr std::size_t fillCount = 1 << 20;
+
+    // What the generator used to be: std::mt19937 behind uniform_real_distribution
+    void BM_randomMt19937Float(benchmark::State& state) {
+        std::mt19937 gen(42);
+        std::uniform_real_distribution<float> distribution(0, 1);
+
+        for (auto _ : state) {
+            benchmark::DoNotOptimize(distribution(gen));
+        }
+        state.SetItemsProcessed(state.iterations());
+    }
+
+    template <typename Engine>
+    void BM_randomEngine(benchmark::State& state) {
+        Engine engine(42);
+
+        for (auto _ : state) {
+            benchmark::DoNotOptimize(engine());
+        }
+        state.SetItemsProcessed(state.iterations());
+    }
+
+    void BM_fRandomGet(benchmark::State& state) {
+        for (auto _ : state) {
+            benchmark::DoNotOptimize(f_random<float>::Get());
+        }
+        state.SetItemsProcessed(state.iterations());
+    }
+
+    // Constructing an instance used to seed a fresh std::mt19937 from std::random_device
+    void BM_fRandomConstruct(benchmark::State& state) {
+        for (auto _ : state) {
+            f_random<float> random(0, 10);
+            benchmark::DoNotOptimize(random.get());
+        }
+        state.SetItemsProcessed(state.iterations());
+    }
+
+    // Range argument is the simd_level, -1 runs the Get() loop
+    void BM_fRandomFill(benchmark::State& state) {
+        std::vector<float> values(fillCount);
+
+        const auto level = state.range(0);
+        if (level >= 0 && simd::setLevel(simd_level(level)) != simd_level(level)) {
+            state.SkipWithError("SIMD level not supported by this CPU");
+            simd::setLevel(simd::bestLevel());
+            return;
+        }
+
+        for (auto _ : state) {
+            if (level >= 0) {
+                f_random<float>::Fill(values);
+            }
+            else {
+                for (auto& value : values) {
+                    value = f_random<float>::Get();
+                }
+            }
+            benchmark::ClobberMemory();
+        }
+
+        simd::setLevel(simd::bestLevel());
+        state.SetItemsProcessed(state.iterations() * fillCount);
+    }
+
+    // Every thread draws from its own engine, nothing is shared
+    void BM_fRandomGetThreaded(benchmark::State& state) {
+        for (auto _ : state) {
+            benchmark::DoNotOptimize(f_random<float>::GetRange(-1, 1));
+        }
+        state.SetItemsProcessed(state.iterations());
+    }
+
+    // Range argument is the bound, the last one rejects about a quarter of the draws
+    void boundedArgs(benchmark::internal::Benchmark* bench) {
+        bench->ArgName("max")->Arg(6)->Arg(1000)->Arg(int64_t(3) << 30);
+    }
+
+    // How GetUnder used to work: one division per call and a bias to the low values
+    void BM_iRandomModulo(benchmark::State& state) {
+        const auto max = static_cast<uint32_t>(state.range(0));
+
+        for (auto _ : state) {
+            benchmark::DoNotOptimize(i_random<uint32_t>::Get() % max);
+        }
+        state.SetItemsProcessed(state.iterations());
+    }
+
+    void BM_iRandomGetUnder(benchmark::State& state) {
+        const auto max = static_cast<uint32_t>(state.range(0));
+
+        for (auto _ : state) {
+            benchmark::DoNotOptimize(i_random<uint32_t>::GetUnder(max));
+        }
+        state.SetItemsProcessed(state.iterations());
+    }
+
+    void BM_iRandomGetUnderSpan(benchmark::State& state) {
+        const auto max = static_cast<uint32_t>(state.range(0));
+        std::vector<uint32_t> values(fillCount);
+
+        for (auto _ : state) {
+            i_random<uint32_t>::GetUnder(values, max);
+            benchmark::ClobberMemory();
+        }
+        state.SetItemsProcessed(state.iterations() * fillCount);
+    }
+
+    // Chi-square statistic of `values` against a uniform [0, bound)
+    template <typename Int>
+    double chiSquare(const std::vector<Int>& values, uint32_t bound, std::vector<uint64_t>& counts) {
+        counts.assign(bound, 0);
+        for (auto value : values) {
+            ++counts[to<std::size_t>(value)];
+        }
+
+        const double expected = static_cast<double>(values.size()) / bound;
+        double statistic = 0;
+        for (auto count : counts) {
+            const double diff = static_cast<double>(count) - expected;
+            statistic += diff * diff / expected;
+        }
+        return statistic;
+    }
+
+    // Critical value of a chi-square with `dof` degrees of freedom at normal quantile z
+    // (Wilson-Hilferty), |z| = 3.09 leaves 0.1% on each side
+    double chiSquareQuantile(double dof, double z) {
+        const double term = 2.0 / (9.0 * dof);
+        return dof * std::pow(1.0 - term + z * std::sqrt(term), 3.0);
+    }
+
+    // Statistical check of the bounded generators, not a timing: each iteration draws a
+    // seeded million values under `bound` (first argument) through GetUnder(max) or, when
+    // the second argument is 1, GetUnder(span, max). Errors out if the statistic is too
+    // far from uniform on either side, run it with --benchmark_filter=ChiSquare
+    template <typename Int>
+    void BM_iRandomChiSquare(benchmark::State& state) {
+        const auto bound = static_cast<uint32_t>(state.range(0));
+        const bool batched = state.range(1) != 0;
+        const double dof = bound - 1;
+        const double low = chiSquareQuantile(dof, -3.09);
+        const double high = chiSquareQuantile(dof, 3.09);
+
+        std::vector<Int> values(fillCount);
+        std::vector<uint64_t> counts;
+        double worst = dof;
+        uint64_t seed = 0;
+
+        for (auto _ : state) {
+            random_generator::setSeed(++seed);
+
+            if (batched) {
+                i_random<Int>::GetUnder(values, static_cast<Int>(bound));
+            }
+            else {
+                for (auto& value : values) {
+                    value = i_random<Int>::GetUnder(static_cast<Int>(bound));
+                }
+            }
+
+            const double statistic = chiSquare(values, bound, counts);
+            if (std::abs(statistic - dof) > std::abs(worst - dof)) {
+                worst = statistic;
+            }
+
+            if (statistic < low || statistic > high) {
+                state.SkipWithError("Chi-square statistic out of bounds, the values aren't uniform");
+                break;
+            }
+        }
+
+        // The statistic furthest from its expected value, dof
+        state.counters["chiSquare"] = worst;
+        state.counters["dof"] = dof;
+    }
+
+    void chiSquareBounds(benchmark::internal::Benchmark* bench, std::initializer_list<int64_t> bounds) {
+        bench->ArgNames({ "bound", "span" });
+        for (auto bound : bounds) {
+            bench->Args({ bound, 0 })->Args({ bound, 1 });
+        }
+        bench->Iterations(8)->Unit(benchmark::kMillisecond);
+    }
+
+    void chiSquareArgs(benchmark::internal::Benchmark* bench) {
+        chiSquareBounds(bench, { 2, 3, 7, 10, 100, 1000, 6007 });
+    }
+
+    // Bounds an int8_t holds
+    void smallChiSquareArgs(benchmark::internal::Benchmark* bench) {
+        chiSquareBounds(bench, { 2, 3, 7, 10, 100 });
+    }
+
+}
+
+BENCHMARK(BM_randomMt19937Float);
+BENCHMARK_TEMPLATE(BM_randomEngine, std::mt19937_64);
+BENCHMARK_TEMPLATE(BM_randomEngine, xoshiro256ss);
+BENCHMARK_TEMPLATE(BM_randomEngine, pcg32);
+BENCHMARK_TEMPLATE(BM_randomEngine, wyrand);
+BENCHMARK(BM_fRandomGet);
+BENCHMARK(BM_fRandomConstruct);
+BENCHMARK(BM_fRandomFill)->ArgName("level")->Arg(-1)->Arg(int(simd_level::Scalar))->Arg(int(simd_level::SSE2))->Arg(int(simd_level::AVX2))->Unit(benchmark::kMicrosecond);
+BENCHMARK(BM_fRandomGetThreaded)->ThreadRange(1, 8)->UseRealTime();
+BENCHMARK(BM_iRandomModulo)->Apply(boundedArgs);
+BENCHMARK(BM_iRandomGetUnder)->Apply(boundedArgs);
+BENCHMARK(BM_iRandomGetUnderSpan)->Apply(boundedArgs)->Unit(benchmark::kMicrosecond);
+BENCHMARK_TEMPLATE(BM_iRandomChiSquare, uint32_t)->Apply(chiSquareArgs);
+BENCHMARK_TEMPLATE(BM_iRandomChiSquare, int8_t)->Apply(smallChiSquareArgs);
+BENCHMARK_TEMPLATE(BM_iRandomChiSquare, int64_t)->Apply(chiSquareArgs);
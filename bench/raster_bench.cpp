@@ -0,0 +1,86 @@
+//
+// Created by Alcachofa
+//
+
+#include <vector>
+
+#include <benchmark/benchmark.h>
+
+#include <software_rasterizer.hpp>
+
+#include <utils/random.hpp>
+
+namespace {
+
+    using namespace arti;
+
+    const math::vec2di targetSize = { 1920, 1080 };
+
+    std::vector<math::vec2df> randomPositions(std::size_t count) {
+        std::vector<math::vec2df> positions(count);
+        for (auto& p : positions) {
+            p = { f_random<float>::GetUnder(targetSize.x), f_random<float>::GetUnder(targetSize.y) };
+        }
+        return positions;
+    }
+
+    // Arguments are (shapes per frame, threads), 0 threads uses every hardware thread.
+    // Same workloads as the BM_frame* renderer benchmarks, for GPU vs CPU comparisons
+    template <typename Draw>
+    void runRaster(benchmark::State& state, Draw draw) {
+        std::vector<pixel> pixels(to<std::size_t>(targetSize.x) * targetSize.y);
+        auto positions = randomPositions(state.range(0) + 1);
+
+        software_rasterizer raster(to<uint32_t>(state.range(1)));
+        raster.setTarget(pixels, targetSize);
+
+        for (auto _ : state) {
+            raster.clear();
+            draw(raster, positions);
+            raster.flush();
+            benchmark::ClobberMemory();
+        }
+
+        state.SetItemsProcessed(state.iterations() * state.range(0));
+    }
+
+    void BM_rasterCircles(benchmark::State& state) {
+        runRaster(state, [](software_rasterizer& raster, const std::vector<math::vec2df>& positions) {
+            for (std::size_t i = 0; i + 1 < positions.size(); ++i) {
+                raster.renderCircle(positions[i], 6.0f, 1.0f, pixel(200, 80, 40), pixel(255, 255, 255));
+            }
+        });
+    }
+
+    void BM_rasterRectangles(benchmark::State& state) {
+        runRaster(state, [](software_rasterizer& raster, const std::vector<math::vec2df>& positions) {
+            float rotation = 0.0f;
+            for (std::size_t i = 0; i + 1 < positions.size(); ++i) {
+                raster.renderRectangle(positions[i], { 12.0f, 8.0f }, pixel(40, 80, 200), rotation);
+                rotation += 1.0f;
+            }
+        });
+    }
+
+    void BM_rasterLines(benchmark::State& state) {
+        runRaster(state, [](software_rasterizer& raster, const std::vector<math::vec2df>& positions) {
+            for (std::size_t i = 0; i + 1 < positions.size(); ++i) {
+                raster.renderLine(positions[i], positions[i + 1], 2.0f, pixel(80, 200, 40));
+            }
+        });
+    }
+
+    void BM_rasterTranslucentCircles(benchmark::State& state) {
+        runRaster(state, [](software_rasterizer& raster, const std::vector<math::vec2df>& positions) {
+            for (std::size_t i = 0; i + 1 < positions.size(); ++i) {
+                raster.renderCircle(positions[i], 16.0f, pixel(200, 80, 40, 96));
+            }
+        });
+    }
+
+}
+
+BENCHMARK(BM_rasterCircles)->ArgsProduct({ { 1000, 10000, 100000 }, { 1, 0 } })->Unit(benchmark::kMillisecond);
+BENCHMARK(BM_rasterRectangles)->ArgsProduct({ { 1000, 10000, 100000 }, { 1, 0 } })->Unit(benchmark::kMillisecond);
+BENCHMARK(BM_rasterLines)->ArgsProduct({ { 1000, 10000 }, { 1, 0 } })->Unit(benchmark::kMillisecond);
+BENCHMARK(BM_rasterTranslucentCircles)->ArgsProduct({ { 1000, 10000 }, { 1, 0 } })->Unit(benchmark::kMillisecond);
@@ -0,0 +1,143 @@
+//
+// Created by Alcachofa
+//
+
+#include <vector>
+
+#include <benchmark/benchmark.h>
+
+#include <utils/random.hpp>
+
+#include "bench_app.hpp"
+
+namespace {
+
+    using namespace arti;
+    using arti::bench::benchWidth;
+    using arti::bench::benchHeight;
+
+    // Scattered over twice the screen, so roughly a quarter of them is visible
+    std::vector<math::vec2df> randomPositions(std::size_t count) {
+        std::vector<math::vec2df> positions(count);
+        for (auto& p : positions) {
+            p = { f_random<float>::GetRange(-benchWidth / 2.0f, benchWidth * 1.5f), f_random<float>::GetRange(-benchHeight / 2.0f, benchHeight * 1.5f) };
+        }
+        return positions;
+    }
+
+    void BM_rendererIsVisible(benchmark::State& state) {
+        auto positions = randomPositions(state.range(0));
+
+        bench::runInFrame(state, [&](benchmark::State& st, renderer& graphics) {
+            for (auto _ : st) {
+                std::size_t visible = 0;
+                for (const auto& p : positions) {
+                    visible += graphics.isVisible(p, 4.0f);
+                }
+                benchmark::DoNotOptimize(visible);
+            }
+            st.SetItemsProcessed(st.iterations() * st.range(0));
+        });
+    }
+
+    void BM_rendererCullBatch(benchmark::State& state) {
+        auto positions = randomPositions(state.range(0));
+        std::vector<float> radii(positions.size(), 4.0f);
+        std::vector<uint32_t> visible;
+        visible.reserve(positions.size());
+
+        bench::runInFrame(state, [&](benchmark::State& st, renderer& graphics) {
+            for (auto _ : st) {
+                visible.clear();
+                graphics.cullBatch(positions, radii, visible);
+                benchmark::DoNotOptimize(visible.data());
+            }
+            st.SetItemsProcessed(st.iterations() * st.range(0));
+        });
+    }
+
+    // Arguments are (shapes per frame, batched layer)
+    void setupLayer(benchmark::State& state, renderer& graphics) {
+        if (state.range(1) != 0) {
+            graphics.setLayerBatching(true, 64 * state.range(0));
+        }
+    }
+
+    // Draw calls and vertices of the last frame, to compare batching off and on
+    void reportFrameStats(benchmark::State& state, const renderer& graphics) {
+        const auto& stats = graphics.getFrameStats();
+        state.counters["drawCalls"] = benchmark::Counter(to<double>(stats.drawCalls));
+        state.counters["vertices"] = benchmark::Counter(to<double>(stats.vertices));
+    }
+
+    void BM_frameCircles(benchmark::State& state) {
+        auto positions = randomPositions(state.range(0));
+
+        bench::runFrames(state, [&](renderer& graphics) { setupLayer(state, graphics); }, [&](renderer& graphics) {
+            graphics.clear();
+            for (const auto& p : positions) {
+                graphics.renderCircle(p, 6.0f, 1.0f, pixel(200, 80, 40), pixel(255, 255, 255));
+            }
+        }, [&](renderer& graphics) { reportFrameStats(state, graphics); });
+        state.SetItemsProcessed(state.iterations() * state.range(0));
+    }
+
+    void BM_frameRectangles(benchmark::State& state) {
+        auto positions = randomPositions(state.range(0));
+
+        bench::runFrames(state, [&](renderer& graphics) { setupLayer(state, graphics); }, [&](renderer& graphics) {
+            graphics.clear();
+            float rotation = 0.0f;
+            for (const auto& p : positions) {
+                graphics.renderRectangle(p, { 12.0f, 8.0f }, pixel(40, 80, 200), rotation);
+                rotation += 1.0f;
+            }
+        }, [&](renderer& graphics) { reportFrameStats(state, graphics); });
+        state.SetItemsProcessed(state.iterations() * state.range(0));
+    }
+
+    void BM_frameLines(benchmark::State& state) {
+        auto positions = randomPositions(state.range(0) + 1);
+
+        bench::runFrames(state, [&](renderer& graphics) { setupLayer(state, graphics); }, [&](renderer& graphics) {
+            graphics.clear();
+            for (std::size_t i = 0; i + 1 < positions.size(); ++i) {
+                graphics.renderLine(positions[i], positions[i + 1], 2.0f, pixel(80, 200, 40));
+            }
+        }, [&](renderer& graphics) { reportFrameStats(state, graphics); });
+        state.SetItemsProcessed(state.iterations() * state.range(0));
+    }
+
+    void BM_frameSprites(benchmark::State& state) {
+        auto positions = randomPositions(state.range(0));
+        std::vector<renderer::texture_id> textures;
+
+        auto setup = [&](renderer& graphics) {
+            setupLayer(state, graphics);
+
+            // A handful of small textures, all of them end up in the same atlas page
+            for (uint8_t i = 0; i < 8; ++i) {
+                sf::Image image;
+                image.create(16 + 4 * i, 16 + 4 * i, pixel(to<uint8_t>(32 * i), 128, to<uint8_t>(255 - 32 * i)));
+                textures.push_back(graphics.loadTexture(image));
+            }
+        };
+
+        bench::runFrames(state, setup, [&](renderer& graphics) {
+            graphics.clear();
+            for (std::size_t i = 0; i < positions.size(); ++i) {
+                graphics.renderSprite(textures[i % textures.size()], positions[i], { 1.0f, 1.0f }, to<float>(i % 360));
+            }
+        }, [&](renderer& graphics) { reportFrameStats(state, graphics); });
+        state.SetItemsProcessed(state.iterations() * state.range(0));
+    }
+
+}
+
+BENCHMARK(BM_rendererIsVisible)->Arg(1 << 16);
+BENCHMARK(BM_rendererCullBatch)->Arg(1 << 16);
+
+BENCHMARK(BM_frameCircles)->ArgsProduct({ { 1000, 10000, 100000 }, { 0, 1 } })->Unit(benchmark::kMillisecond);
+BENCHMARK(BM_frameRectangles)->ArgsProduct({ { 1000, 10000, 100000 }, { 0, 1 } })->Unit(benchmark::kMillisecond);
+BENCHMARK(BM_frameLines)->ArgsProduct({ { 1000, 10000, 100000 }, { 0, 1 } })->Unit(benchmark::kMillisecond);
+BENCHMARK(BM_frameSprites)->ArgsProduct({ { 1000, 10000, 100000 }, { 0, 1 } })->Unit(benchmark::kMillisecond);
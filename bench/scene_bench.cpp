@@ -0,0 +1,89 @@
+//
+// Created by Alcachofa
+//
+
+#include <memory>
+#include <vector>
+
+#include <benchmark/benchmark.h>
+
+#include <scene_graph.hpp>
+
+#include "bench_app.hpp"
+
+namespace {
+
+    using namespace arti;
+
+    // A dashboard of panels, each a frame with a grid of cells inside
+    constexpr int32_t cellsPerPanel = 64;
+
+    math::vec2df panelPosition(int32_t panel) {
+        return { to<float>(panel % 16) * 80.0f, to<float>(panel / 16) * 80.0f };
+    }
+
+    math::vec2df cellPosition(int32_t cell) {
+        return { 4.0f + to<float>(cell % 8) * 9.0f, 4.0f + to<float>(cell / 8) * 9.0f };
+    }
+
+    // Everything issued again every frame, the way dashboards are drawn today. Argument is the panel count
+    void BM_sceneImmediate(benchmark::State& state) {
+        const auto panels = to<int32_t>(state.range(0));
+
+        bench::runFrames(state, [](renderer& graphics) {
+            graphics.setLayerBatching(true);
+        }, [&](renderer& graphics) {
+            for (int32_t p = 0; p < panels; ++p) {
+                auto origin = panelPosition(p);
+                graphics.renderRectangle(origin, { 76.0f, 76.0f }, 1.0f, pixel(30, 30, 40), pixel(200, 200, 200));
+                for (int32_t c = 0; c < cellsPerPanel; ++c) {
+                    graphics.renderRectangle(origin + cellPosition(c), { 8.0f, 8.0f }, pixel(to<uint8_t>(c * 4), 120, 60));
+                }
+            }
+        });
+
+        state.SetItemsProcessed(state.iterations() * panels * (cellsPerPanel + 1));
+    }
+
+    // Arguments are (panel count, panels moved per frame)
+    void BM_sceneRetained(benchmark::State& state) {
+        const auto panels = to<int32_t>(state.range(0));
+        const auto moved = to<int32_t>(state.range(1));
+        std::unique_ptr<scene_graph> scene;
+        std::vector<scene_graph::node_id> panelNodes;
+        int64_t frame = 0;
+
+        bench::runFrames(state, [&](renderer&) {
+            scene = std::make_unique<scene_graph>();
+            panelNodes.clear();
+
+            for (int32_t p = 0; p < panels; ++p) {
+                auto panel = scene->createNode();
+                scene->setPosition(panel, panelPosition(p));
+                scene->setRectangle(panel, { 76.0f, 76.0f }, pixel(30, 30, 40), 1.0f, pixel(200, 200, 200));
+
+                for (int32_t c = 0; c < cellsPerPanel; ++c) {
+                    auto cell = scene->createNode(panel);
+                    scene->setPosition(cell, cellPosition(c));
+                    scene->setRectangle(cell, { 8.0f, 8.0f }, pixel(to<uint8_t>(c * 4), 120, 60));
+                }
+
+                panelNodes.push_back(panel);
+            }
+        }, [&](renderer& graphics) {
+            for (int32_t i = 0; i < moved; ++i) {
+                auto p = to<int32_t>((frame * moved + i) % panels);
+                scene->setPosition(panelNodes[p], panelPosition(p) + to<float>(frame % 2));
+            }
+            ++frame;
+
+            scene->render(graphics);
+        });
+
+        state.SetItemsProcessed(state.iterations() * panels * (cellsPerPanel + 1));
+    }
+
+}
+
+BENCHMARK(BM_sceneImmediate)->Arg(16)->Arg(128)->Unit(benchmark::kMicrosecond);
+BENCHMARK(BM_sceneRetained)->ArgsProduct({ { 16, 128 }, { 0, 1, 16 } })->Unit(benchmark::kMicrosecond);
@@ -0,0 +1,189 @@
+//
+// Created by Alcachofa
+//
+
+#include <vector>
+
+#include <benchmark/benchmark.h>
+
+#include <spatial_index.hpp>
+
+#include <utils/random.hpp>
+
+#include "bench_app.hpp"
+
+namespace {
+
+    using namespace arti;
+    using arti::bench::benchWidth;
+    using arti::bench::benchHeight;
+
+    // Big enough that a screen sized query sees well under one percent of it
+    constexpr float worldSize = 40000.0f;
+
+    std::vector<math::vec2df> randomPositions(std::size_t count) {
+        std::vector<math::vec2df> positions(count);
+        for (auto& p : positions) {
+            p = { f_random<float>::GetRange(0.0f, worldSize), f_random<float>::GetRange(0.0f, worldSize) };
+        }
+        return positions;
+    }
+
+    std::vector<math::vec2df> randomSteps(std::size_t count) {
+        std::vector<math::vec2df> steps(count);
+        for (auto& s : steps) {
+            s = { f_random<float>::GetRange(-4.0f, 4.0f), f_random<float>::GetRange(-4.0f, 4.0f) };
+        }
+        return steps;
+    }
+
+    spatial_hash makeHash(const std::vector<math::vec2df>& positions) {
+        spatial_hash index;
+        for (std::size_t i = 0; i < positions.size(); ++i) {
+            index.insert(to<uint32_t>(i), positions[i], 4.0f);
+        }
+        return index;
+    }
+
+    loose_quadtree makeQuadtree(const std::vector<math::vec2df>& positions) {
+        loose_quadtree index({ 0.0f, 0.0f }, { worldSize, worldSize });
+        for (std::size_t i = 0; i < positions.size(); ++i) {
+            index.insert(to<uint32_t>(i), positions[i], 4.0f);
+        }
+        return index;
+    }
+
+    // Every point takes a small step each iteration, a typical frame of moving entities
+    template <typename Index>
+    void moveAll(benchmark::State& state, Index& index, std::vector<math::vec2df>& positions) {
+        const auto steps = randomSteps(positions.size());
+        float direction = 1.0f;
+
+        for (auto _ : state) {
+            for (std::size_t i = 0; i < positions.size(); ++i) {
+                positions[i] += steps[i] * direction;
+                index.move(to<uint32_t>(i), positions[i]);
+            }
+            // Back and forth, so the points stay where they were spread
+            direction = -direction;
+        }
+        state.SetItemsProcessed(state.iterations() * state.range(0));
+    }
+
+    template <typename Index>
+    void queryScreens(benchmark::State& state, const Index& index) {
+        std::vector<uint32_t> found;
+        const math::vec2df screen(benchWidth, benchHeight);
+        math::vec2df corner;
+
+        for (auto _ : state) {
+            found.clear();
+            corner = { f_random<float>::GetUnder(worldSize - screen.x), f_random<float>::GetUnder(worldSize - screen.y) };
+            index.queryRange(corner, corner + screen, found);
+            benchmark::DoNotOptimize(found.data());
+        }
+        state.counters["found"] = benchmark::Counter(to<double>(found.size()));
+    }
+
+    void BM_spatialHashInsert(benchmark::State& state) {
+        auto positions = randomPositions(state.range(0));
+        for (auto _ : state) {
+            auto index = makeHash(positions);
+            benchmark::DoNotOptimize(index.size());
+        }
+        state.SetItemsProcessed(state.iterations() * state.range(0));
+    }
+
+    void BM_quadtreeInsert(benchmark::State& state) {
+        auto positions = randomPositions(state.range(0));
+        for (auto _ : state) {
+            auto index = makeQuadtree(positions);
+            benchmark::DoNotOptimize(index.size());
+        }
+        state.SetItemsProcessed(state.iterations() * state.range(0));
+    }
+
+    void BM_spatialHashMove(benchmark::State& state) {
+        auto positions = randomPositions(state.range(0));
+        auto index = makeHash(positions);
+        moveAll(state, index, positions);
+    }
+
+    void BM_quadtreeMove(benchmark::State& state) {
+        auto positions = randomPositions(state.range(0));
+        auto index = makeQuadtree(positions);
+        moveAll(state, index, positions);
+    }
+
+    // What the index replaces, testing every position against the screen
+    void BM_linearQuery(benchmark::State& state) {
+        auto positions = randomPositions(state.range(0));
+        std::vector<uint32_t> found;
+        const math::vec2df screen(benchWidth, benchHeight);
+
+        for (auto _ : state) {
+            found.clear();
+            math::vec2df min(f_random<float>::GetUnder(worldSize - screen.x), f_random<float>::GetUnder(worldSize - screen.y));
+            auto max = min + screen;
+            for (std::size_t i = 0; i < positions.size(); ++i) {
+                const auto& p = positions[i];
+                if (p.x + 4.0f >= min.x && p.x - 4.0f <= max.x && p.y + 4.0f >= min.y && p.y - 4.0f <= max.y) {
+                    found.push_back(to<uint32_t>(i));
+                }
+            }
+            benchmark::DoNotOptimize(found.data());
+        }
+    }
+
+    void BM_spatialHashQuery(benchmark::State& state) {
+        auto index = makeHash(randomPositions(state.range(0)));
+        queryScreens(state, index);
+    }
+
+    void BM_quadtreeQuery(benchmark::State& state) {
+        auto index = makeQuadtree(randomPositions(state.range(0)));
+        queryScreens(state, index);
+    }
+
+    void BM_quadtreeQueryRadius(benchmark::State& state) {
+        auto index = makeQuadtree(randomPositions(state.range(0)));
+        std::vector<uint32_t> found;
+
+        for (auto _ : state) {
+            found.clear();
+            math::vec2df center(f_random<float>::GetUnder(worldSize), f_random<float>::GetUnder(worldSize));
+            index.queryRadius(center, 256.0f, found);
+            benchmark::DoNotOptimize(found.data());
+        }
+    }
+
+    // Through the renderer view, the points are packed around the default view so most of the screen is busy
+    void BM_spatialHashQueryVisible(benchmark::State& state) {
+        std::vector<math::vec2df> positions(state.range(0));
+        for (auto& p : positions) {
+            p = { f_random<float>::GetRange(-benchWidth * 4.0f, benchWidth * 5.0f), f_random<float>::GetRange(-benchHeight * 4.0f, benchHeight * 5.0f) };
+        }
+        auto index = makeHash(positions);
+        std::vector<uint32_t> visible;
+
+        bench::runInFrame(state, [&](benchmark::State& st, renderer& graphics) {
+            for (auto _ : st) {
+                visible.clear();
+                index.queryVisible(graphics, visible);
+                benchmark::DoNotOptimize(visible.data());
+            }
+            st.counters["found"] = benchmark::Counter(to<double>(visible.size()));
+        });
+    }
+
+}
+
+BENCHMARK(BM_spatialHashInsert)->Arg(100000)->Arg(1000000)->Unit(benchmark::kMillisecond);
+BENCHMARK(BM_quadtreeInsert)->Arg(100000)->Arg(1000000)->Unit(benchmark::kMillisecond);
+BENCHMARK(BM_spatialHashMove)->Arg(100000)->Arg(1000000)->Unit(benchmark::kMillisecond);
+BENCHMARK(BM_quadtreeMove)->Arg(100000)->Arg(1000000)->Unit(benchmark::kMillisecond);
+BENCHMARK(BM_linearQuery)->Arg(100000)->Arg(1000000)->Unit(benchmark::kMicrosecond);
+BENCHMARK(BM_spatialHashQuery)->Arg(100000)->Arg(1000000)->Unit(benchmark::kMicrosecond);
+BENCHMARK(BM_quadtreeQuery)->Arg(100000)->Arg(1000000)->Unit(benchmark::kMicrosecond);
+BENCHMARK(BM_quadtreeQueryRadius)->Arg(100000)->Arg(1000000)->Unit(benchmark::kMicrosecond);
+BENCHMARK(BM_spatialHashQueryVisible)->Arg(100000)->Arg(1000000)->Unit(benchmark::kMicrosecond);
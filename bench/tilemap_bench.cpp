@@ -0,0 +1,72 @@
+//
+// Created by Alcachofa
+//
+
+#include <memory>
+
+#include <benchmark/benchmark.h>
+
+#include <tilemap.hpp>
+
+#include <utils/random.hpp>
+
+#include "bench_app.hpp"
+
+namespace {
+
+    using namespace arti;
+    using arti::bench::benchWidth;
+    using arti::bench::benchHeight;
+
+    // 8px tiles, so a 160x90 corner of the map covers the screen
+    constexpr float tileSide = 8.0f;
+
+    pixel tileColor(int32_t x, int32_t y) {
+        return pixel(to<uint8_t>(x * 7), to<uint8_t>(y * 5), to<uint8_t>((x + y) * 3));
+    }
+
+    // The way the map editor draws today, one rectangle per tile per frame. Argument is the map side in tiles
+    void BM_tilemapRectangles(benchmark::State& state) {
+        const auto side = to<int32_t>(state.range(0));
+
+        bench::runFrames(state, [](renderer& graphics) {
+            graphics.setLayerBatching(true);
+        }, [&](renderer& graphics) {
+            for (int32_t y = 0; y < side; ++y) {
+                for (int32_t x = 0; x < side; ++x) {
+                    graphics.renderRectangle({ to<float>(x) * tileSide, to<float>(y) * tileSide }, { tileSide, tileSide }, tileColor(x, y));
+                }
+            }
+        });
+
+        state.SetItemsProcessed(state.iterations() * side * side);
+    }
+
+    // Arguments are (map side in tiles, tiles changed per frame)
+    void BM_tilemapChunks(benchmark::State& state) {
+        const auto side = to<int32_t>(state.range(0));
+        const auto edits = state.range(1);
+        std::unique_ptr<tilemap> map;
+
+        bench::runFrames(state, [&](renderer&) {
+            map = std::make_unique<tilemap>(math::vec2di(side, side), math::vec2df(tileSide, tileSide));
+            for (int32_t y = 0; y < side; ++y) {
+                for (int32_t x = 0; x < side; ++x) {
+                    map->setTile({ x, y }, { 0, tileColor(x, y) });
+                }
+            }
+        }, [&](renderer& graphics) {
+            for (int64_t i = 0; i < edits; ++i) {
+                math::vec2di coords(i_random<int32_t>::GetUnder(side), i_random<int32_t>::GetUnder(side));
+                map->setTile(coords, { 0, tileColor(coords.y, coords.x) });
+            }
+            map->render(graphics);
+        });
+
+        state.SetItemsProcessed(state.iterations() * side * side);
+    }
+
+}
+
+BENCHMARK(BM_tilemapRectangles)->Arg(128)->Arg(1024)->Unit(benchmark::kMillisecond);
+BENCHMARK(BM_tilemapChunks)->ArgsProduct({ { 128, 1024 }, { 0, 16 } })->Unit(benchmark::kMillisecond);
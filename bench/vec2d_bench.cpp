@@ -0,0 +1,191 @@
+//
+// Created by Alcachofa
+//
+
+#include <vector>
+
+#include <benchmark/benchmark.h>
+
+#include <math/vec2d.hpp>
+#include <math/vec2d_batch.hpp>
+
+#include <utils/simd.hpp>
+#include <utils/random.hpp>
+
+namespace {
+
+    using arti::math::vec2df;
+    using arti::math::vec2dd;
+    using arti::math::vec2df_batch;
+    using simd_level = arti::simd::level;
+
+    template <typename Vec>
+    std::vector<Vec> randomVectors(std::size_t count) {
+        std::vector<Vec> vectors(count);
+        for (auto& v : vectors) {
+            v = Vec(arti::f_random<float>::GetRange(-1000.0f, 1000.0f), arti::f_random<float>::GetRange(-1000.0f, 1000.0f));
+        }
+        return vectors;
+    }
+
+    template <typename Vec>
+    void BM_vec2dAdd(benchmark::State& state) {
+        auto lhs = randomVectors<Vec>(state.range(0));
+        auto rhs = randomVectors<Vec>(state.range(0));
+        for (auto _ : state) {
+            for (std::size_t i = 0; i < lhs.size(); ++i) {
+                lhs[i] += rhs[i];
+            }
+            benchmark::ClobberMemory();
+        }
+        state.SetItemsProcessed(state.iterations() * state.range(0));
+    }
+
+    template <typename Vec>
+    void BM_vec2dScale(benchmark::State& state) {
+        auto vectors = randomVectors<Vec>(state.range(0));
+        for (auto _ : state) {
+            for (auto& v : vectors) {
+                v = v * 0.999f;
+            }
+            benchmark::ClobberMemory();
+        }
+        state.SetItemsProcessed(state.iterations() * state.range(0));
+    }
+
+    template <typename Vec>
+    void BM_vec2dDot(benchmark::State& state) {
+        auto lhs = randomVectors<Vec>(state.range(0));
+        auto rhs = randomVectors<Vec>(state.range(0));
+        for (auto _ : state) {
+            typename Vec::value_type sum = 0;
+            for (std::size_t i = 0; i < lhs.size(); ++i) {
+                sum += lhs[i].dot(rhs[i]);
+            }
+            benchmark::DoNotOptimize(sum);
+        }
+        state.SetItemsProcessed(state.iterations() * state.range(0));
+    }
+
+    template <typename Vec>
+    void BM_vec2dLength(benchmark::State& state) {
+        auto vectors = randomVectors<Vec>(state.range(0));
+        for (auto _ : state) {
+            double sum = 0;
+            for (const auto& v : vectors) {
+                sum += v.length();
+            }
+            benchmark::DoNotOptimize(sum);
+        }
+        state.SetItemsProcessed(state.iterations() * state.range(0));
+    }
+
+    template <typename Vec>
+    void BM_vec2dNormalize(benchmark::State& state) {
+        auto vectors = randomVectors<Vec>(state.range(0));
+        std::vector<Vec> out(vectors.size());
+        for (auto _ : state) {
+            for (std::size_t i = 0; i < vectors.size(); ++i) {
+                out[i] = vectors[i].normalize();
+            }
+            benchmark::ClobberMemory();
+        }
+        state.SetItemsProcessed(state.iterations() * state.range(0));
+    }
+
+    // The same operations on a vec2df_batch, arguments are (vectors, simd_level)
+    template <typename Operation>
+    void runBatchBenchmark(benchmark::State& state, Operation operation) {
+        const auto lhsVectors = randomVectors<vec2df>(state.range(0));
+        const auto rhsVectors = randomVectors<vec2df>(state.range(0));
+        vec2df_batch lhs(lhsVectors);
+        vec2df_batch rhs(rhsVectors);
+        std::vector<float> out(state.range(0));
+
+        const auto level = simd_level(state.range(1));
+        if (arti::simd::setLevel(level) != level) {
+            state.SkipWithError("SIMD level not supported by this CPU");
+            arti::simd::setLevel(arti::simd::bestLevel());
+            return;
+        }
+
+        for (auto _ : state) {
+            operation(lhs, rhs, out);
+            benchmark::ClobberMemory();
+        }
+
+        arti::simd::setLevel(arti::simd::bestLevel());
+        state.SetItemsProcessed(state.iterations() * state.range(0));
+    }
+
+    void BM_vec2dBatchAdd(benchmark::State& state) {
+        runBatchBenchmark(state, [](vec2df_batch& lhs, const vec2df_batch& rhs, std::vector<float>&) { lhs += rhs; });
+    }
+
+    void BM_vec2dBatchScale(benchmark::State& state) {
+        runBatchBenchmark(state, [](vec2df_batch& lhs, const vec2df_batch&, std::vector<float>&) { lhs *= 0.999f; });
+    }
+
+    void BM_vec2dBatchDot(benchmark::State& state) {
+        runBatchBenchmark(state, [](vec2df_batch& lhs, const vec2df_batch& rhs, std::vector<float>& out) { lhs.dot(rhs, out); });
+    }
+
+    void BM_vec2dBatchLength(benchmark::State& state) {
+        runBatchBenchmark(state, [](vec2df_batch& lhs, const vec2df_batch&, std::vector<float>& out) { lhs.length(out); });
+    }
+
+    // Lengths stay at 1 after the first pass, the work is the same every iteration
+    void BM_vec2dBatchNormalize(benchmark::State& state) {
+        runBatchBenchmark(state, [](vec2df_batch& lhs, const vec2df_batch&, std::vector<float>&) { lhs.normalize(); });
+    }
+
+    void BM_vec2dBatchRotate(benchmark::State& state) {
+        runBatchBenchmark(state, [](vec2df_batch& lhs, const vec2df_batch&, std::vector<float>&) { lhs.rotate(0.01f); });
+    }
+
+    // vec2d array to batch and back, what mixing both layouts costs
+    void BM_vec2dBatchConvert(benchmark::State& state) {
+        auto vectors = randomVectors<vec2df>(state.range(0));
+        vec2df_batch batch(vectors.size());
+
+        const auto level = simd_level(state.range(1));
+        if (arti::simd::setLevel(level) != level) {
+            state.SkipWithError("SIMD level not supported by this CPU");
+            arti::simd::setLevel(arti::simd::bestLevel());
+            return;
+        }
+
+        for (auto _ : state) {
+            batch.assign(vectors);
+            batch.copyTo(vectors);
+            benchmark::ClobberMemory();
+        }
+
+        arti::simd::setLevel(arti::simd::bestLevel());
+        state.SetItemsProcessed(state.iterations() * state.range(0));
+    }
+
+    void batchArgs(benchmark::internal::Benchmark* bench) {
+        bench->ArgNames({ "vectors", "level" });
+        for (auto level : { simd_level::Scalar, simd_level::SSE2, simd_level::AVX2 }) {
+            bench->Args({ 1 << 20, int64_t(level) });
+        }
+        bench->Unit(benchmark::kMicrosecond);
+    }
+
+}
+
+BENCHMARK_TEMPLATE(BM_vec2dAdd, vec2df)->Arg(4096)->Arg(1 << 20);
+BENCHMARK_TEMPLATE(BM_vec2dAdd, vec2dd)->Arg(4096)->Arg(1 << 20);
+BENCHMARK_TEMPLATE(BM_vec2dScale, vec2df)->Arg(4096)->Arg(1 << 20);
+BENCHMARK_TEMPLATE(BM_vec2dDot, vec2df)->Arg(4096)->Arg(1 << 20);
+BENCHMARK_TEMPLATE(BM_vec2dLength, vec2df)->Arg(4096)->Arg(1 << 20);
+BENCHMARK_TEMPLATE(BM_vec2dNormalize, vec2df)->Arg(4096)->Arg(1 << 20);
+BENCHMARK_TEMPLATE(BM_vec2dNormalize, vec2dd)->Arg(4096)->Arg(1 << 20);
+BENCHMARK(BM_vec2dBatchAdd)->Apply(batchArgs);
+BENCHMARK(BM_vec2dBatchScale)->Apply(batchArgs);
+BENCHMARK(BM_vec2dBatchDot)->Apply(batchArgs);
+BENCHMARK(BM_vec2dBatchLength)->Apply(batchArgs);
+BENCHMARK(BM_vec2dBatchNormalize)->Apply(batchArgs);
+BENCHMARK(BM_vec2dBatchRotate)->Apply(batchArgs);
+BENCHMARK(BM_vec2dBatchConvert)->Apply(batchArgs);
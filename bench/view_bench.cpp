@@ -0,0 +1,93 @@
+//
+// Created by Alcachofa
+//
+
+#include <vector>
+
+#include <benchmark/benchmark.h>
+
+#include <transformed_view.hpp>
+
+#include <utils/random.hpp>
+
+#include "bench_app.hpp"
+
+namespace {
+
+    using namespace arti;
+
+    std::vector<math::vec2df> randomPoints(std::size_t count) {
+        std::vector<math::vec2df> points(count);
+        for (auto& p : points) {
+            p = { f_random<float>::GetRange(-5000.0f, 5000.0f), f_random<float>::GetRange(-5000.0f, 5000.0f) };
+        }
+        return points;
+    }
+
+    // The per point path through the renderer, what mouse picking and overlays use today
+    void BM_rendererViewToScreen(benchmark::State& state) {
+        auto points = randomPoints(state.range(0));
+        std::vector<math::vec2df> out(points.size());
+
+        bench::runInFrame(state, [&](benchmark::State& st, renderer& graphics) {
+            graphics.scaleViewAt(1.5f, { 100.0f, 100.0f });
+            for (auto _ : st) {
+                for (std::size_t i = 0; i < points.size(); ++i) {
+                    out[i] = graphics.viewToScreen(points[i]);
+                }
+                benchmark::ClobberMemory();
+            }
+            st.SetItemsProcessed(st.iterations() * st.range(0));
+        });
+    }
+
+    void BM_viewWorldToScreen(benchmark::State& state) {
+        auto points = randomPoints(state.range(0));
+        std::vector<math::vec2df> out(points.size());
+
+        transformed_view view({ bench::benchWidth, bench::benchHeight });
+        view.zoomAt(1.5f, { 100.0f, 100.0f });
+
+        for (auto _ : state) {
+            view.worldToScreen(points, out);
+            benchmark::ClobberMemory();
+        }
+        state.SetItemsProcessed(state.iterations() * state.range(0));
+    }
+
+    void BM_viewScreenToWorld(benchmark::State& state) {
+        auto points = randomPoints(state.range(0));
+        std::vector<math::vec2df> out(points.size());
+
+        transformed_view view({ bench::benchWidth, bench::benchHeight });
+        view.zoomAt(1.5f, { 100.0f, 100.0f });
+
+        for (auto _ : state) {
+            view.screenToWorld(points, out);
+            benchmark::ClobberMemory();
+        }
+        state.SetItemsProcessed(state.iterations() * state.range(0));
+    }
+
+    void BM_viewCullBatch(benchmark::State& state) {
+        auto points = randomPoints(state.range(0));
+        std::vector<uint32_t> visible;
+        visible.reserve(points.size());
+
+        transformed_view view({ bench::benchWidth, bench::benchHeight });
+        view.setScale(0.25f);
+
+        for (auto _ : state) {
+            visible.clear();
+            view.cullBatch(points, 4.0f, visible);
+            benchmark::DoNotOptimize(visible.data());
+        }
+        state.SetItemsProcessed(state.iterations() * state.range(0));
+    }
+
+}
+
+BENCHMARK(BM_rendererViewToScreen)->Arg(4096)->Arg(1 << 20);
+BENCHMARK(BM_viewWorldToScreen)->Arg(4096)->Arg(1 << 20);
+BENCHMARK(BM_viewScreenToWorld)->Arg(4096)->Arg(1 << 20);
+BENCHMARK(BM_viewCullBatch)->Arg(4096)->Arg(1 << 20);
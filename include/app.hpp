@@ -6,28 +6,76 @@
 
 #include <string>
 #include <memory>
+#include <mutex>
+#include <thread>
+#include <condition_variable>
 
 #include <SFML/Graphics/RenderWindow.hpp>
+#include <SFML/Graphics/RenderTexture.hpp>
+#include <SFML/Graphics/Image.hpp>
 #include <SFML/Window/Event.hpp>
 
 #include <input.hpp>
 #include <renderer.hpp>
+#include <asset_manager.hpp>
 
 #include <math/vec2d.hpp>
 
 namespace arti {
 
+    struct frame_settings {
+        // Runs onFixedUpdate at tickRate Hz from an accumulator, independently of the display rate
+        bool fixedTimestep = false;
+        float tickRate = 60.0f;
+        // Fixed steps allowed per frame before the remaining backlog is dropped
+        int32_t maxCatchUpSteps = 5;
+
+        bool vsync = false;
+        // Frames per second limit, 0 disables it. Sleeps until spinThreshold seconds
+        // before the deadline and busy waits the rest to avoid oversleeping
+        float frameCap = 0.0f;
+        float spinThreshold = 0.002f;
+
+        // Runs frame N's onFixedUpdate/onUpdate on a worker thread while the main thread
+        // submits frame N-1 to the GPU. Read once when run() starts. In this mode:
+        //  - renderer draw calls (render*, clear, offsetView, scaleViewAt) are recorded,
+        //    not executed, and replayed one frame later on the main thread
+        //  - objects passed to renderer::render(const sf::Drawable&) must stay alive
+        //    and unchanged until the end of the next frame
+        //  - onUpdate/onFixedUpdate must not create, destroy or resize layers, or touch
+        //    SFML resources (textures, the window) directly; do it in onInit, onResize
+        //    or onPollEvent, which always run on the main thread, or queue it with
+        //    renderer::runBeforeSubmit (tilemap uploads its chunks that way)
+        //  - the same goes for renderer::setLayerBatching, whose flush draws straight
+        //    into the layer texture. renderer::setLayerOrder is fine, the order is only
+        //    read when the recorded frame is closed, while the worker is idle
+        //  - ImGui and input_manager can be used from onUpdate as usual, the main
+        //    thread doesn't touch them while the worker runs
+        bool pipelined = false;
+
+        // Delta time, in seconds, fed to onUpdate and the fixed step accumulator instead of
+        // the measured one, 0 uses the real clock. Headless apps default to 1 / tickRate
+        float frameDelta = 0.0f;
+        // run() returns after this many frames, 0 runs until exit is requested
+        uint64_t frameLimit = 0;
+    };
+
     class app {
 
     public:
         app();
         virtual ~app();
 
-        bool init(std::string_view name, math::vec2di windowSize, sf::Uint32 style = sf::Style::Default);
+        bool init(std::string_view name, math::vec2di windowSize, sf::Uint32 style = sf::Style::Default, const frame_settings& settings = {});
+
+        // Renders every frame into an offscreen texture instead of a window. Still needs
+        // a GL context (Xvfb or OSMesa on machines without a GPU), no events are polled
+        bool initHeadless(std::string_view name, math::vec2di size, const frame_settings& settings = {});
 
         int run();
 
         virtual bool onInit();
+        virtual bool onFixedUpdate(float);
         virtual bool onUpdate(float) = 0;
         virtual bool onExit();
 
@@ -39,30 +87,84 @@ namespace arti {
         math::vec2di getSize() const;
         std::string_view getName() const;
 
+        const frame_settings& getFrameSettings() const;
+        void setFrameSettings(const frame_settings& settings);
+
+        // How far, in [0, 1), the current frame is between the last and the next fixed step
+        float getInterpolationAlpha() const;
+
         void setName(std::string_view name);
         void setSize(math::vec2du windowSize);
+        // The icon is decoded in the background and set a few frames later
         void setIcon(std::string_view iconFile);
 
         sf::RenderWindow& getWindow();
 
+        bool isHeadless() const;
+
+        // The window, or the offscreen texture in headless mode
+        sf::RenderTarget& getRenderTarget();
+
+        // Frames completed since run() started
+        uint64_t getFrameCount() const;
+
+        // Contents of the last presented frame. In windowed mode it's only kept while
+        // frame capture is on, see setFrameCapture
+        sf::Image captureFrame();
+        bool saveFrame(std::string_view path);
+
+        // Windowed mode: copies every frame into a texture (on the GPU) right before it's
+        // presented, so captureFrame() has something to read. Headless frames always are
+        void setFrameCapture(bool enabled);
+        bool isFrameCapturing() const;
+
     protected:
         std::unique_ptr<renderer> graphics;
         std::unique_ptr<input_manager> input;
+        std::unique_ptr<asset_manager> assets;
 
     private:
+        bool pInit();
+
         void onSFMLEvent(const sf::Event& event);
 
         bool pUpdate(const sf::Time& elapsed);
+        bool pPollEvents(const sf::Time& elapsed);
+        bool pSimulate();
+        bool pFixedUpdate();
         bool pRender();
+        bool pPipelinedFrame(const sf::Time& elapsed);
+        void pStartUpdateWorker();
+        void pStopUpdateWorker();
+        void pUpdateWorkerLoop();
+        void pDisplay();
+        void pPaceFrame(const sf::Clock& frameTimer);
         void pExit();
 
         bool isRunning;
         bool isInitialized;
         bool exitRequested;
+        bool headless;
+        bool frameCapture;
+        uint64_t frameCount;
         float deltaTime;
+        float fixedAccumulator;
+        float interpolationAlpha;
         std::string appName;
 
+        frame_settings frameSettings;
+
+        std::thread updateWorker;
+        std::mutex updateMutex;
+        std::condition_variable updateSignal;
+        bool updateRequested;
+        bool updateFinished;
+        bool updateResult;
+        bool stopUpdateWorker;
+
         sf::RenderWindow window;
+        sf::RenderTexture offscreen;
+        sf::Texture presentedFrame;
     };
 
 }
\ No newline at end of file
@@ -0,0 +1,149 @@
+//
+// Created by Alcachofa
+//
+
+#pragma once
+
+#include <deque>
+#include <mutex>
+#include <atomic>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+#include <functional>
+#include <string_view>
+#include <condition_variable>
+
+#include <SFML/Graphics/Font.hpp>
+#include <SFML/Graphics/Image.hpp>
+
+#include <math/vec2d.hpp>
+
+#include <renderer.hpp>
+
+namespace arti {
+
+    enum class asset_status : uint8_t {
+        Pending,
+        Ready,
+        Failed
+    };
+
+    struct texture_asset {
+        std::atomic<asset_status> status{ asset_status::Pending };
+        std::string path;
+
+        // Valid once Ready
+        renderer::texture_id id = renderer::invalidTexture;
+        math::vec2di size;
+    };
+
+    struct font_asset {
+        std::atomic<asset_status> status{ asset_status::Pending };
+        std::string path;
+
+        // Valid once Ready
+        sf::Font font;
+        // sf::Font reads from this for as long as it lives
+        std::vector<char> data;
+    };
+
+    // Shared view of an asset that may still be loading, cheap to copy
+    template <typename Asset>
+    class asset_handle {
+
+    public:
+        asset_handle() = default;
+        explicit asset_handle(std::shared_ptr<Asset> asset) : asset(std::move(asset)) {}
+
+        bool isValid() const { return asset != nullptr; }
+
+        asset_status getStatus() const {
+            return asset ? asset->status.load(std::memory_order_acquire) : asset_status::Failed;
+        }
+
+        bool isReady() const { return getStatus() == asset_status::Ready; }
+        bool isPending() const { return getStatus() == asset_status::Pending; }
+        bool isFailed() const { return getStatus() == asset_status::Failed; }
+
+        const Asset& operator*() const { return *asset; }
+        const Asset* operator->() const { return asset.get(); }
+
+    private:
+        std::shared_ptr<Asset> asset;
+    };
+
+    using texture_handle = asset_handle<texture_asset>;
+    using font_handle = asset_handle<font_asset>;
+
+    // Reads and decodes files on a small pool of worker threads, then finishes them on the
+    // main thread (GPU uploads, atlas packing) inside a per-frame time budget, so big asset
+    // sets stream in without frame hitches. The app calls processUploads() every frame
+    class asset_manager {
+
+    public:
+        static constexpr float defaultUploadBudgetMs = 2.0f;
+        // Budgets are clamped to this, a minute is already far past a frame
+        static constexpr float maxUploadBudgetMs = 60.0f * 1000.0f;
+
+        // 0 threads uses std::thread::hardware_concurrency() - 1, at least one. The workers
+        // start with the first load
+        explicit asset_manager(renderer& graphics, uint32_t threads = 2);
+        ~asset_manager();
+
+        asset_manager(const asset_manager&) = delete;
+        asset_manager& operator=(const asset_manager&) = delete;
+
+        // All of these return right away and may be called from any thread
+
+        // Decoded on a worker, packed into the renderer texture atlas on the main thread
+        texture_handle loadTexture(std::string_view file);
+        // Read on a worker, sf::Font is created from memory on the main thread
+        font_handle loadFont(std::string_view file);
+        // Decoded on a worker, `onLoaded` gets the image on the main thread, or isn't called if it failed
+        void loadImage(std::string_view file, std::function<void(sf::Image&)> onLoaded);
+
+        // Main thread only. Finishes decoded assets until the budget runs out, always at least one
+        void processUploads();
+        // Main thread only. Blocks until everything requested so far is Ready or Failed
+        void finishAll();
+
+        // Clamped to [0, maxUploadBudgetMs], NaN counts as 0
+        void setUploadBudget(float milliseconds);
+        float getUploadBudget() const;
+
+        // Requested assets that aren't Ready or Failed yet
+        std::size_t getPendingCount() const;
+
+    private:
+        using job = std::function<void()>;
+        using upload = std::function<void()>;
+
+        // Without a deadline when `unbounded`, until the queue is empty
+        void processUploads(bool unbounded);
+        void enqueue(job work);
+        void pushUpload(upload finish);
+        void workerLoop();
+        void stopWorkers();
+
+        renderer& graphics;
+
+        uint32_t threadCount;
+        float uploadBudgetMs;
+
+        std::vector<std::thread> workers;
+        bool stopping;
+
+        std::mutex jobsMutex;
+        std::condition_variable jobsSignal;
+        std::deque<job> jobs;
+
+        std::mutex uploadsMutex;
+        std::condition_variable uploadsSignal;
+        std::deque<upload> uploads;
+
+        std::atomic<std::size_t> pending;
+    };
+
+}
@@ -42,9 +42,8 @@ namespace arti::math {
                 : x(x),
                   y(y) {}
 
-        vec2d(const vec2d& other)
-                : x(other.x),
-                  y(other.y) {}
+        // Defaulted so vec2d stays trivially copyable inside packed structs
+        vec2d(const vec2d& other) = default;
 
         template<typename U>
         vec2d(const vec2d<U>& other)
@@ -61,17 +60,8 @@ namespace arti::math {
             return sf::Vector2<U>(to<U>(this->x), to<U>(this->y));
         }
 
-        vec2d& operator=(const vec2d& other) {
-            this->x = other.x;
-            this->y = other.y;
-            return *this;
-        }
-
-        vec2d& operator=(vec2d&& other) {
-            this->x = std::move(other.x);
-            this->y = std::move(other.y);
-            return *this;
-        }
+        vec2d& operator=(const vec2d& other) = default;
+        vec2d& operator=(vec2d&& other) = default;
 
         void swap(vec2d& other) {
             std::swap(this->x, other.x);
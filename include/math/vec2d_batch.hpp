@@ -0,0 +1,310 @@
+//
+// Created by Alcachofa
+//
+
+#pragma once
+
+#include <cmath>
+#include <vector>
+#include <algorithm>
+#include <type_traits>
+
+#include <math/vec2d.hpp>
+
+#include <utils/span.hpp>
+#include <utils/aligned_allocator.hpp>
+
+// Kernels behind vec2d_batch<float>, one per operation over `count` components. They run
+// SSE2 or AVX2 as picked by simd::activeLevel() and give exactly the scalar result
+namespace arti::math::batch_ops {
+
+    // x += otherX, y += otherY
+    void add(float* x, float* y, const float* otherX, const float* otherY, std::size_t count);
+    void sub(float* x, float* y, const float* otherX, const float* otherY, std::size_t count);
+    // Component-wise
+    void mul(float* x, float* y, const float* otherX, const float* otherY, std::size_t count);
+
+    // x += offsetX, y += offsetY
+    void offset(float* x, float* y, float offsetX, float offsetY, std::size_t count);
+    void scale(float* x, float* y, float factor, std::size_t count);
+
+    // x * cos - y * sin, x * sin + y * cos
+    void rotate(float* x, float* y, float cos, float sin, std::size_t count);
+    // Zero vectors stay zero
+    void normalize(float* x, float* y, std::size_t count);
+
+    void dot(const float* x, const float* y, const float* otherX, const float* otherY, float* out, std::size_t count);
+    void length(const float* x, const float* y, float* out, std::size_t count);
+
+    // Between vec2d<float> arrays and separate x / y arrays
+    void deinterleave(const vec2d<float>* vectors, float* x, float* y, std::size_t count);
+    void interleave(const float* x, const float* y, vec2d<float>* vectors, std::size_t count);
+
+}
+
+namespace arti::math {
+
+    // vec2d stored as two arrays, x and y, 32 byte aligned so whole operations run as SIMD
+    // kernels (batch_ops) for float. Other types go through plain loops the compiler can
+    // vectorize. Operations between two batches stop at the shorter one
+    template <typename T>
+    class vec2d_batch {
+
+    public:
+        typedef T value_type;
+        typedef vec2d<T> vector_type;
+        typedef std::size_t size_type;
+
+        static_assert(std::is_arithmetic_v<value_type>);
+
+        static constexpr std::size_t alignment = 32;
+
+        vec2d_batch() = default;
+
+        // `count` zero vectors
+        explicit vec2d_batch(size_type count) : xs(count), ys(count) {}
+
+        explicit vec2d_batch(span<const vector_type> vectors) {
+            assign(vectors);
+        }
+
+        void assign(span<const vector_type> vectors) {
+            xs.resize(vectors.size());
+            ys.resize(vectors.size());
+
+            if constexpr (std::is_same_v<value_type, float>) {
+                batch_ops::deinterleave(vectors.data(), xs.data(), ys.data(), vectors.size());
+            }
+            else {
+                for (size_type i = 0; i < vectors.size(); ++i) {
+                    xs[i] = vectors[i].x;
+                    ys[i] = vectors[i].y;
+                }
+            }
+        }
+
+        // Writes back into `out`, as many as fit
+        void copyTo(span<vector_type> out) const {
+            const auto count = std::min(size(), out.size());
+
+            if constexpr (std::is_same_v<value_type, float>) {
+                batch_ops::interleave(xs.data(), ys.data(), out.data(), count);
+            }
+            else {
+                for (size_type i = 0; i < count; ++i) {
+                    out[i] = vector_type(xs[i], ys[i]);
+                }
+            }
+        }
+
+        std::vector<vector_type> toVectors() const {
+            std::vector<vector_type> vectors(size());
+            copyTo(vectors);
+            return vectors;
+        }
+
+        vector_type get(size_type i) const {
+            return vector_type(xs[i], ys[i]);
+        }
+
+        void set(size_type i, const vector_type& v) {
+            xs[i] = v.x;
+            ys[i] = v.y;
+        }
+
+        void push_back(const vector_type& v) {
+            xs.push_back(v.x);
+            ys.push_back(v.y);
+        }
+
+        void resize(size_type count) {
+            xs.resize(count);
+            ys.resize(count);
+        }
+
+        void reserve(size_type count) {
+            xs.reserve(count);
+            ys.reserve(count);
+        }
+
+        void clear() {
+            xs.clear();
+            ys.clear();
+        }
+
+        size_type size() const {
+            return xs.size();
+        }
+
+        bool empty() const {
+            return xs.empty();
+        }
+
+        span<value_type> getXs() {
+            return xs;
+        }
+
+        span<const value_type> getXs() const {
+            return xs;
+        }
+
+        span<value_type> getYs() {
+            return ys;
+        }
+
+        span<const value_type> getYs() const {
+            return ys;
+        }
+
+        vec2d_batch& operator+=(const vec2d_batch& rhs) {
+            const auto count = std::min(size(), rhs.size());
+
+            if constexpr (std::is_same_v<value_type, float>) {
+                batch_ops::add(xs.data(), ys.data(), rhs.xs.data(), rhs.ys.data(), count);
+            }
+            else {
+                for (size_type i = 0; i < count; ++i) {
+                    xs[i] += rhs.xs[i];
+                    ys[i] += rhs.ys[i];
+                }
+            }
+            return *this;
+        }
+
+        vec2d_batch& operator-=(const vec2d_batch& rhs) {
+            const auto count = std::min(size(), rhs.size());
+
+            if constexpr (std::is_same_v<value_type, float>) {
+                batch_ops::sub(xs.data(), ys.data(), rhs.xs.data(), rhs.ys.data(), count);
+            }
+            else {
+                for (size_type i = 0; i < count; ++i) {
+                    xs[i] -= rhs.xs[i];
+                    ys[i] -= rhs.ys[i];
+                }
+            }
+            return *this;
+        }
+
+        // Component-wise
+        vec2d_batch& operator*=(const vec2d_batch& rhs) {
+            const auto count = std::min(size(), rhs.size());
+
+            if constexpr (std::is_same_v<value_type, float>) {
+                batch_ops::mul(xs.data(), ys.data(), rhs.xs.data(), rhs.ys.data(), count);
+            }
+            else {
+                for (size_type i = 0; i < count; ++i) {
+                    xs[i] *= rhs.xs[i];
+                    ys[i] *= rhs.ys[i];
+                }
+            }
+            return *this;
+        }
+
+        vec2d_batch& operator+=(const vector_type& offset) {
+            if constexpr (std::is_same_v<value_type, float>) {
+                batch_ops::offset(xs.data(), ys.data(), offset.x, offset.y, size());
+            }
+            else {
+                for (size_type i = 0; i < size(); ++i) {
+                    xs[i] += offset.x;
+                    ys[i] += offset.y;
+                }
+            }
+            return *this;
+        }
+
+        vec2d_batch& operator-=(const vector_type& offset) {
+            return *this += -offset;
+        }
+
+        vec2d_batch& operator*=(value_type factor) {
+            if constexpr (std::is_same_v<value_type, float>) {
+                batch_ops::scale(xs.data(), ys.data(), factor, size());
+            }
+            else {
+                for (size_type i = 0; i < size(); ++i) {
+                    xs[i] *= factor;
+                    ys[i] *= factor;
+                }
+            }
+            return *this;
+        }
+
+        // Counter-clockwise by `radians`, sin and cos are worked out once for the batch
+        void rotate(value_type radians) {
+            static_assert(std::is_floating_point_v<value_type>, "rotate needs a floating point batch");
+
+            const value_type cos = std::cos(radians);
+            const value_type sin = std::sin(radians);
+
+            if constexpr (std::is_same_v<value_type, float>) {
+                batch_ops::rotate(xs.data(), ys.data(), cos, sin, size());
+            }
+            else {
+                for (size_type i = 0; i < size(); ++i) {
+                    const value_type x = xs[i];
+                    xs[i] = x * cos - ys[i] * sin;
+                    ys[i] = x * sin + ys[i] * cos;
+                }
+            }
+        }
+
+        // In value_type, unlike vec2d::normalize(). Zero vectors stay zero
+        void normalize() {
+            static_assert(std::is_floating_point_v<value_type>, "normalize needs a floating point batch");
+
+            if constexpr (std::is_same_v<value_type, float>) {
+                batch_ops::normalize(xs.data(), ys.data(), size());
+            }
+            else {
+                for (size_type i = 0; i < size(); ++i) {
+                    const value_type length = std::sqrt(xs[i] * xs[i] + ys[i] * ys[i]);
+                    const value_type inverse = length > 0 ? value_type(1) / length : value_type(0);
+                    xs[i] *= inverse;
+                    ys[i] *= inverse;
+                }
+            }
+        }
+
+        // out[i] = get(i).dot(rhs.get(i)), as many as fit
+        void dot(const vec2d_batch& rhs, span<value_type> out) const {
+            const auto count = std::min({ size(), rhs.size(), out.size() });
+
+            if constexpr (std::is_same_v<value_type, float>) {
+                batch_ops::dot(xs.data(), ys.data(), rhs.xs.data(), rhs.ys.data(), out.data(), count);
+            }
+            else {
+                for (size_type i = 0; i < count; ++i) {
+                    out[i] = xs[i] * rhs.xs[i] + ys[i] * rhs.ys[i];
+                }
+            }
+        }
+
+        // out[i] = length of get(i) in value_type, as many as fit
+        void length(span<value_type> out) const {
+            static_assert(std::is_floating_point_v<value_type>, "length needs a floating point batch");
+
+            const auto count = std::min(size(), out.size());
+
+            if constexpr (std::is_same_v<value_type, float>) {
+                batch_ops::length(xs.data(), ys.data(), out.data(), count);
+            }
+            else {
+                for (size_type i = 0; i < count; ++i) {
+                    out[i] = std::sqrt(xs[i] * xs[i] + ys[i] * ys[i]);
+                }
+            }
+        }
+
+    private:
+        std::vector<value_type, aligned_allocator<value_type, alignment>> xs;
+        std::vector<value_type, aligned_allocator<value_type, alignment>> ys;
+
+    };
+
+    typedef vec2d_batch<float> vec2df_batch;
+    typedef vec2d_batch<double> vec2dd_batch;
+
+}
@@ -0,0 +1,102 @@
+//
+// Created by Alcachofa
+//
+
+#pragma once
+
+#include <vector>
+#include <cstdint>
+
+#include <SFML/Graphics/Vertex.hpp>
+
+#include <math/vec2d.hpp>
+
+#include <utils/worker_pool.hpp>
+
+#include <pixel.hpp>
+#include <renderer.hpp>
+
+namespace arti {
+
+    // Particles stored as separate arrays per attribute, so update() runs SIMD kernels over
+    // plain floats (level picked by simd::setLevel). Dead particles are swapped with the
+    // last live one, so order isn't kept. render() writes every visible particle as a
+    // square into a single triangle list and draws it in one call
+    class particle_emitter {
+
+    public:
+        static constexpr std::size_t defaultCapacity = 1 << 16;
+        // Below this many particles per thread the extra threads aren't worth starting
+        static constexpr std::size_t minParticlesPerThread = 1 << 14;
+
+        explicit particle_emitter(std::size_t capacity = defaultCapacity);
+
+        // False once the emitter is full
+        bool spawn(const math::vec2df& position, const math::vec2df& velocity, float lifetime, const pixel& color);
+        // Random directions, speeds and lifetimes within the given ranges, returns how many fit
+        std::size_t spawnBurst(std::size_t count, const math::vec2df& position, float minSpeed, float maxSpeed, float minLifetime, float maxLifetime, const pixel& color);
+
+        // Applies gravity and drag, moves and ages every particle, then drops the dead ones
+        void update(float deltaTime);
+        // Draws on the emitter layer, or on the targeted one if no layer was set
+        void render(renderer& graphics);
+
+        void clear();
+        std::size_t size() const;
+
+        // Shrinking below the live count drops the newest particles
+        void setCapacity(std::size_t capacity);
+        std::size_t getCapacity() const;
+
+        void setGravity(const math::vec2df& gravity);
+        math::vec2df getGravity() const;
+
+        // Fraction of the velocity lost per second
+        void setDrag(float drag);
+        float getDrag() const;
+
+        // Side of the square every particle is drawn as
+        void setParticleSize(float size);
+        float getParticleSize() const;
+
+        // Alpha goes down to 0 over each particle's lifetime
+        void setFadeOut(bool enabled);
+        bool isFadingOut() const;
+
+        void setLayer(renderer::layer_id id);
+        renderer::layer_id getLayer() const;
+
+        // Threads splitting update() and the vertex writing in render(), 0 uses std::thread::hardware_concurrency().
+        // The extra ones stay alive between frames
+        void setThreadCount(uint32_t threads);
+        uint32_t getThreadCount() const;
+
+    private:
+        std::size_t workersFor(std::size_t particles) const;
+        // Writes the particles in [first, last) inside [min, max], returns how many vertices it wrote
+        std::size_t writeVertices(std::size_t first, std::size_t last, sf::Vertex* out, const math::vec2df& min, const math::vec2df& max) const;
+        void removeDead();
+
+        std::size_t capacity;
+        std::size_t count;
+
+        std::vector<float> positionX;
+        std::vector<float> positionY;
+        std::vector<float> velocityX;
+        std::vector<float> velocityY;
+        std::vector<float> age;
+        std::vector<float> lifetime;
+        std::vector<pixel> colors;
+
+        std::vector<sf::Vertex> vertices;
+
+        math::vec2df gravity;
+        float drag;
+        float particleSize;
+        bool fadeOut;
+        renderer::layer_id layer;
+        uint32_t threadCount;
+        worker_pool workers;
+    };
+
+}
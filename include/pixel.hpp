@@ -48,5 +48,7 @@ namespace arti {
 
     pixel pixelF(float r, float g, float b, float a = 1.0f);
     pixel pixelLerp(const pixel &p1, const pixel &p2, float t);
+    // Non premultiplied `over` drawn on top of `under`, channels rounded to nearest
+    pixel pixelBlend(const pixel &under, const pixel &over);
 
 }
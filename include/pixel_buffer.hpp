@@ -0,0 +1,119 @@
+//
+// Created by Alcachofa
+//
+
+#pragma once
+
+#include <vector>
+#include <cstdint>
+#include <algorithm>
+
+#include <SFML/Graphics/Rect.hpp>
+#include <SFML/Graphics/Texture.hpp>
+
+#include <math/vec2d.hpp>
+
+#include <utils/span.hpp>
+
+#include <pixel.hpp>
+
+namespace arti {
+
+    // CPU side RGBA8 image mirrored into an sf::Texture. Writes only mark what they
+    // touch, upload() then sends the dirty rows to the GPU instead of the whole image.
+    // Every write is clipped to the buffer
+    class pixel_buffer {
+
+    public:
+        // Dirty bands closer than this many rows are uploaded together
+        static constexpr int32_t bandMergeGap = 8;
+        // Past this many bands a frame uploads their bounding box once instead
+        static constexpr std::size_t maxUploadsPerFrame = 16;
+
+        pixel_buffer();
+
+        // Allocates the pixels and the texture, everything starts as `color`
+        bool create(const math::vec2di& size, const pixel& color = pixel(0, 0, 0, 0));
+
+        math::vec2di getSize() const;
+        int32_t getWidth() const;
+        int32_t getHeight() const;
+
+        // Raw access, call markDirty() for whatever gets written through these
+        pixel* data();
+        const pixel* data() const;
+        span<pixel> row(int32_t y);
+
+        inline pixel getPixel(int32_t x, int32_t y) const {
+            if (! contains(x, y)) {
+                return pixel(0, 0, 0, 0);
+            }
+            return pixels[to<std::size_t>(y) * size.x + x];
+        }
+
+        inline void draw(int32_t x, int32_t y, const pixel& color) {
+            if (! contains(x, y)) {
+                return;
+            }
+
+            pixels[to<std::size_t>(y) * size.x + x] = color;
+            markRow(y, x, x + 1);
+        }
+
+        void fillSpan(int32_t x, int32_t y, int32_t length, const pixel& color);
+        void fillRect(const sf::IntRect& area, const pixel& color);
+        void fill(const pixel& color);
+
+        // Copies (or alpha blends, see pixelBlend) `area` of `source` with its top-left corner at `position`
+        void blit(const pixel_buffer& source, const sf::IntRect& area, const math::vec2di& position, bool alphaBlend = false);
+        // Same from tightly packed rows of `width` pixels, e.g. sf::Image::getPixelsPtr()
+        void blit(span<const pixel> source, int32_t width, const math::vec2di& position, bool alphaBlend = false);
+
+        void markDirty(const sf::IntRect& area);
+        void markAllDirty();
+        bool isDirty() const;
+
+        // Sends the dirty area to the texture, returns how many texture updates it took
+        std::size_t upload();
+
+        const sf::Texture& getTexture() const;
+
+    private:
+        struct band {
+            int32_t top;
+            int32_t bottom;
+            int32_t left;
+            int32_t right;
+        };
+
+        inline bool contains(int32_t x, int32_t y) const {
+            return x >= 0 && y >= 0 && x < size.x && y < size.y;
+        }
+
+        // [left, right) of row y was written, both already clipped
+        inline void markRow(int32_t y, int32_t left, int32_t right) {
+            dirtyLeft[y] = std::min(dirtyLeft[y], left);
+            dirtyRight[y] = std::max(dirtyRight[y], right);
+            dirtyTop = std::min(dirtyTop, y);
+            dirtyBottom = std::max(dirtyBottom, y + 1);
+        }
+
+        void blitRows(const pixel* source, int32_t stride, const math::vec2di& extent, const math::vec2di& position, bool alphaBlend);
+        void uploadBand(const band& area);
+
+        math::vec2di size;
+        std::vector<pixel> pixels;
+
+        // Per row dirty columns [dirtyLeft, dirtyRight), and the dirty rows [dirtyTop, dirtyBottom)
+        std::vector<int32_t> dirtyLeft;
+        std::vector<int32_t> dirtyRight;
+        int32_t dirtyTop;
+        int32_t dirtyBottom;
+
+        std::vector<band> bands;
+        std::vector<pixel> uploadScratch;
+
+        sf::Texture texture;
+    };
+
+}
@@ -0,0 +1,42 @@
+//
+// Created by Alcachofa
+//
+
+#pragma once
+
+#include <cstdint>
+
+#include <pixel.hpp>
+
+#include <utils/simd.hpp>
+#include <utils/span.hpp>
+
+// Whole-buffer versions of the pixel operators. Every kernel gives exactly the same
+// result as calling the matching scalar operator on each pixel, whichever code path
+// runs. Binary operations stop at the shorter of the two spans
+namespace arti::pixel_ops {
+
+    // The code path is shared by every SIMD module, see utils/simd.hpp
+    using simd_level = simd::level;
+    using simd::bestLevel;
+    using simd::activeLevel;
+    using simd::setLevel;
+
+    // p * factor
+    void scale(span<pixel> pixels, float factor);
+    // p / divisor
+    void divide(span<pixel> pixels, float divisor);
+    // dst + src
+    void add(span<pixel> dst, span<const pixel> src);
+    // dst - src
+    void sub(span<pixel> dst, span<const pixel> src);
+    // pixelLerp(dst, target, t)
+    void lerp(span<pixel> dst, span<const pixel> target, float t);
+    // p.inv()
+    void inv(span<pixel> pixels);
+    // pixelBlend(dst, src)
+    void blend(span<pixel> dst, span<const pixel> src);
+    // pixelBlend(dst, color)
+    void blend(span<pixel> dst, const pixel& color);
+
+}
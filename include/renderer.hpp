@@ -5,13 +5,23 @@
 #pragma once
 
 #include <list>
+#include <limits>
+#include <memory>
+#include <vector>
 #include <optional>
+#include <functional>
+#include <string_view>
+#include <type_traits>
 
 #include <SFML/Graphics.hpp>
 
 #include <math/vec2d.hpp>
 
+#include <utils/span.hpp>
+
 #include <pixel.hpp>
+#include <pixel_buffer.hpp>
+#include <texture_atlas.hpp>
 
 namespace arti {
 
@@ -24,13 +34,63 @@ namespace arti {
         friend class transformed_view;
 
     public:
-        using layer_id = uint16_t;
-        using texture_id = uint16_t;
+        // Low 16 bits hold the layer slot plus one, high 16 bits the slot generation, so
+        // an id kept around after its layer was destroyed never aliases a new layer. Fresh
+        // slots start at generation 0, so the default layer is 1 and new layers count up
+        // from there until a slot is reused
+        using layer_id = uint32_t;
+        using texture_id = texture_atlas::texture_id;
+
+        static constexpr layer_id invalidLayer = std::numeric_limits<layer_id>::max();
+        static constexpr texture_id invalidTexture = texture_atlas::invalidTexture;
+
+        // Entry of the deferred command buffer, see setDeferred()
+        struct draw_command {
+            enum type_t : uint8_t {
+                Clear,
+                View,
+                Vertices,
+                Drawable
+            };
+
+            type_t type;
+            // Index into the frame's blend mode table
+            uint8_t blend;
+            // Bumped by every Clear/View on the layer, sorting never moves a draw across one
+            uint16_t segment;
+            layer_id layer;
+            const sf::Texture* texture;
+            // Index into the frame's transform table, 0 is the identity
+            uint32_t transform;
+
+            pixel color;
+
+            math::vec2df viewOffset;
+            float viewScale;
+
+            uint32_t first;
+            uint32_t count;
+
+            const sf::Drawable* drawable;
+        };
+
+        // Commands are recorded, sorted and copied by the thousand every frame
+        static_assert(std::is_trivially_copyable_v<draw_command>);
+
+        struct frame_stats {
+            uint32_t commands = 0;
+            uint32_t drawCalls = 0;
+            // Everything drawn through the render* calls, sf::Drawables passed to render()
+            // count as draw calls only
+            uint32_t vertices = 0;
+        };
 
     protected:
         struct layer_t {
             layer_id id;
             bool enabled;
+            int32_t zOrder;
+            uint32_t sequence;
             float scale;
             math::vec2df offset;
             sf::RenderTexture texture;
@@ -40,25 +100,120 @@ namespace arti {
 
             sf::View view;
 
+            // World-space area that ends up on screen, only recomputed after the
+            // layer or its view is moved, scaled or resized
+            math::vec2df visibleMin;
+            math::vec2df visibleMax;
+            bool visibleDirty = true;
+
+            bool batched;
+            std::vector<sf::Vertex> batch;
+            // Texture the pending batch samples, the batch is flushed when it changes
+            const sf::Texture* batchTexture = nullptr;
+
+            // Only set on pixel layers, drawn under the render texture
+            std::unique_ptr<pixel_buffer> pixels;
+
+            uint32_t drawCalls = 0;
+            uint32_t drawnVertices = 0;
+
+            void flush() {
+                if (! batch.empty()) {
+                    texture.draw(batch.data(), batch.size(), sf::Triangles, sf::RenderStates(batchTexture));
+                    ++drawCalls;
+                    drawnVertices += to<uint32_t>(batch.size());
+                    batch.clear();
+                }
+            }
+
             void updateView() {
+                applyView(viewOffset, viewScale);
+                visibleDirty = true;
+            }
+
+            void applyView(const math::vec2df& newOffset, float newScale) {
+                flush();
+
                 view.reset(sf::FloatRect(
-                   viewOffset,
-                   math::vec2df{texture.getSize()} / viewScale
+                   newOffset,
+                   math::vec2df{texture.getSize()} / newScale
                    )
                 );
 
                 texture.setView(view);
             }
 
-            inline void render(sf::Sprite& spr, sf::RenderWindow& wind) const {
+            void updateVisibleArea(const math::vec2df& windowSize) {
+                auto size = math::vec2df{texture.getSize()};
+
+                visibleMin = viewOffset;
+                visibleMax = viewOffset + size / viewScale;
+
+                auto windowLimit = viewOffset + ((windowSize - offset) / scale) / viewScale;
+                if (visibleMax.y > windowLimit.y) {
+                    visibleMax = windowLimit;
+                }
+
+                visibleDirty = false;
+            }
+
+            inline void render(sf::Sprite& spr, sf::RenderTarget& wind) const {
+                render(spr, wind, offset, scale);
+            }
+
+            inline void render(sf::Sprite& spr, sf::RenderTarget& wind, const math::vec2df& atOffset, float atScale) const {
+                if (pixels) {
+                    spr.setTexture(pixels->getTexture(), true);
+                    spr.setPosition(atOffset.x, atOffset.y);
+                    spr.setScale(atScale, atScale);
+
+                    wind.draw(spr);
+                }
+
                 spr.setTexture(texture.getTexture(), true);
-                spr.setPosition(offset.x, offset.y + to<float>(texture.getSize().y) * scale);
-                spr.setScale(scale, -scale);
+                spr.setPosition(atOffset.x, atOffset.y + to<float>(texture.getSize().y) * atScale);
+                spr.setScale(atScale, -atScale);
 
                 wind.draw(spr);
             }
         };
 
+        struct layer_slot {
+            uint16_t generation = 0;
+            std::unique_ptr<layer_t> layer;
+        };
+
+        // Composition state of a layer captured when the frame was closed
+        struct recorded_layer {
+            layer_id id;
+            bool enabled;
+            float scale;
+            math::vec2df offset;
+        };
+
+        // Storage is cleared but never shrunk, so it works as a per-frame arena and
+        // steady-state frames record without allocating
+        struct command_list {
+            std::vector<draw_command> commands;
+            std::vector<sf::Vertex> vertices;
+            std::vector<sf::Transform> transforms;
+            std::vector<sf::BlendMode> blendModes;
+            std::vector<uint16_t> segments;
+            std::vector<recorded_layer> layers;
+            // Main thread work queued by runBeforeSubmit()
+            std::vector<std::function<void()>> tasks;
+
+            void clear() {
+                commands.clear();
+                vertices.clear();
+                transforms.assign(1, sf::Transform::Identity);
+                blendModes.assign(1, sf::BlendAlpha);
+                segments.clear();
+                layers.clear();
+                tasks.clear();
+            }
+        };
+
     public:
         renderer(app* appInstance);
 
@@ -70,6 +225,16 @@ namespace arti {
 
         layer_id createLayer(const math::vec2di& size);
 
+        // Layer that also owns a CPU pixel_buffer of its size, drawn under whatever is
+        // rendered on it. Pixels are in layer coordinates, the view doesn't move them.
+        // Dirty rows are uploaded once per frame, on the main thread while nothing
+        // records, so in pipelined mode writing them from onUpdate is fine
+        layer_id createPixelLayer();
+        layer_id createPixelLayer(const math::vec2di& size);
+
+        // Pixels of the targeted layer, nullptr unless it's a pixel layer
+        pixel_buffer* getLayerPixels();
+
         void offsetLayer(const math::vec2df& offset);
         void scaleLayerAt(float scale, const math::vec2df& screenCenter);
 
@@ -82,10 +247,21 @@ namespace arti {
 
         void resizeLayer(const math::vec2di& newSize);
 
+        bool destroyLayer(const layer_id& id);
+        bool isLayerValid(const layer_id& id) const;
+
         bool enableLayer(const layer_id& id, bool enabled);
 
         bool isLayerEnabled(const layer_id& id);
 
+        // Layers are re-sorted lazily, when the frame is composed or the recorded frame closed
+        bool setLayerOrder(const layer_id& id, int32_t zOrder);
+        int32_t getLayerOrder(const layer_id& id) const;
+
+        // Flushes the pending batch into the layer texture, so not from a pipelined onUpdate either
+        void setLayerBatching(bool enabled, std::size_t reservedVertices = 6 * 1024);
+        bool isLayerBatching() const;
+
         bool setTargetedLayer(const layer_id& id);
         layer_id getTargetedLayer() const;
 
@@ -103,9 +279,40 @@ namespace arti {
         void renderLine(const math::vec2df& pointA, const math::vec2df& pointB, const pixel& color);
         void renderLine(const math::vec2df& pointA, const math::vec2df& pointB, float thickness, const pixel& color);
 
+        // Packs the image into the texture atlas, main thread only (onInit, onResize or
+        // onPollEvent in pipelined mode). Textures live as long as the renderer
+        texture_id loadTexture(std::string_view file);
+        texture_id loadTexture(const sf::Image& image);
+
+        math::vec2di getTextureSize(texture_id id) const;
+        const texture_atlas& getTextureAtlas() const;
+
+        // Draws a loaded texture with its top-left corner at coords, rotated (in degrees) around
+        // it like renderRectangle. Consecutive sprites from the same atlas page, and anything
+        // batched with them, go out in a single draw call, even on layers without batching
+        void renderSprite(texture_id id, const math::vec2df& coords, const math::vec2df& scale = { 1.0f, 1.0f }, float rotation = 0.0f, const pixel& tint = pixel(255, 255, 255));
+
         void render(const sf::Drawable& drawable);
+        void render(const sf::Drawable& drawable, const sf::RenderStates& states);
+
+        // Triangle list drawn in a single call on the targeted layer. Recording copies the
+        // vertices, so the caller may reuse them right away
+        void renderVertices(span<const sf::Vertex> triangles, const sf::Texture* texture = nullptr);
+
+        inline bool isVisible(const math::vec2df& world_pos, float radius = 0.0f) {
+            if (target->visibleDirty) {
+                target->updateVisibleArea(output->getSize());
+            }
+
+            return world_pos.x >= target->visibleMin.x - radius && world_pos.x <= target->visibleMax.x + radius &&
+                   world_pos.y >= target->visibleMin.y - radius && world_pos.y <= target->visibleMax.y + radius;
+        }
 
-        bool isVisible(const math::vec2df& world_pos, float radius = 0.0f);
+        sf::FloatRect getVisibleArea();
+
+        // Appends to `visible` the indices of the positions that pass isVisible, returns how many were added
+        std::size_t cullBatch(span<const math::vec2df> positions, span<const float> radii, std::vector<uint32_t>& visible);
+        std::size_t cullBatch(span<const math::vec2df> positions, float radius, std::vector<uint32_t>& visible);
 
         math::vec2df screenToLayer(const math::vec2df& coord);
         math::vec2df layerToScreen(const math::vec2df& coord);
@@ -113,21 +320,94 @@ namespace arti {
         math::vec2df screenToView(const math::vec2df& coord);
         math::vec2df viewToScreen(const math::vec2df& coord);
 
+        // Deferred mode records every draw into a command buffer that is replayed by
+        // render(), instead of drawing into the layer textures right away
+        void setDeferred(bool enabled);
+        bool isDeferred() const;
+
+        // Replays deferred commands stably sorted by (layer, blend mode, texture), never
+        // across a clear or view change, and merges compatible neighbours into one draw.
+        // Overlapping draws on a layer with different states may change stacking order
+        void setCommandSorting(bool enabled);
+        bool isCommandSorting() const;
+
+        // True while draws are being recorded, either deferred or pipelined (see app.hpp)
+        bool isRecording() const;
+
+        // Runs `task` on the main thread when the recorded frame is closed, before any of
+        // its commands are submitted and with the update worker idle, so it may touch the
+        // SFML resources the frame draws (e.g. vertex buffer uploads). Runs right away
+        // when nothing is being recorded
+        void runBeforeSubmit(std::function<void()> task);
+
+        // Commands of the last submitted frame, in submission order. Main thread only
+        span<const draw_command> getFrameCommands() const;
+        const frame_stats& getFrameStats() const;
+
     protected:
         bool init();
         bool render();
 
+        void setPipelined(bool enabled);
+        void updateRecording();
+        void closeRecordedFrame();
+        void submitRecordedFrame();
+        void renderOverlay();
+
+        std::vector<sf::Vertex>& geometryOutput(const sf::Texture* texture = nullptr);
+        void commitGeometry(std::size_t firstVertex, const sf::Texture* texture = nullptr, const sf::BlendMode& blend = sf::BlendAlpha);
+        draw_command& recordCommand(draw_command::type_t type);
+        uint8_t recordBlendMode(const sf::BlendMode& blend);
+        uint32_t recordTransform(const sf::Transform& transform);
+        void applyView();
+        void collectStats();
+        void composeLayers();
+        void uploadPixelLayers();
+
+        layer_t* findLayer(const layer_id& id) const;
+        void sortLayers();
+
+        void invalidateVisibleAreas();
+
+        // Ids with 0 in the low bits come out past the last slot
+        static uint16_t slotIndex(const layer_id& id) { return to<uint16_t>((id & 0xFFFFu) - 1u); }
+        static uint16_t slotGeneration(const layer_id& id) { return to<uint16_t>(id >> 16u); }
+
         app* appInstance;
 
-        layer_id layerCount;
+        uint32_t layerCount;
+        uint32_t layerSequence;
         layer_id defaultLayer;
         layer_id targetedLayer;
 
         texture_id textureCount;
+        texture_atlas atlas;
+
+        // Layers are addressed by slot index; layer_t is heap allocated because
+        // sf::RenderTexture can't be moved when the slot table grows
+        std::vector<layer_slot> layerSlots;
+        std::vector<uint16_t> freeSlots;
+
+        // Enabled and disabled layers sorted by (zOrder, creation), rebuilt lazily
+        std::vector<layer_t*> drawOrder;
+        bool drawOrderDirty;
+
+        layer_t* target;
+
+        // While recording, drawing goes to commandLists[recordIndex] and the other
+        // list holds the previous frame, waiting to be submitted
+        bool deferred;
+        bool pipelined;
+        bool recording;
+        bool sortCommands;
+        uint8_t recordIndex;
+        command_list commandLists[2];
+        std::vector<sf::Vertex> submitScratch;
 
-        std::map<layer_id, layer_t> layersList;
+        frame_stats stats;
 
-        sf::RenderWindow& window;
+        // The app window, or an offscreen texture in headless mode, set by init()
+        sf::RenderTarget* output;
     };
 
 }
\ No newline at end of file
@@ -0,0 +1,192 @@
+//
+// Created by Alcachofa
+//
+
+#pragma once
+
+#include <limits>
+#include <vector>
+#include <cstdint>
+
+#include <SFML/Graphics/Vertex.hpp>
+#include <SFML/Graphics/Texture.hpp>
+#include <SFML/Graphics/Transform.hpp>
+#include <SFML/Graphics/Transformable.hpp>
+
+#include <math/vec2d.hpp>
+
+#include <pixel.hpp>
+#include <renderer.hpp>
+
+namespace arti {
+
+    // Retained tree of nodes, each with a transform relative to its parent and an optional
+    // shape. World transforms and the world-space vertices of every shape are cached: moving
+    // a node only recomputes its subtree, and a frame where nothing changed just hands the
+    // cached vertices to the renderer, one renderVertices() call per texture run.
+    //
+    // Shapes are drawn in tree order, parents under their children. Adding, removing,
+    // re-parenting or hiding nodes, or changing the vertex count or texture of a shape,
+    // lays the whole tree out again (still without rebuilding unchanged shapes)
+    class scene_graph {
+
+    public:
+        // Low 24 bits index the node slot, high 8 bits hold the slot generation
+        using node_id = uint32_t;
+
+        static constexpr node_id invalidNode = std::numeric_limits<node_id>::max();
+
+        scene_graph();
+
+        // Always valid, can't be destroyed or have a shape
+        node_id getRoot() const;
+
+        // Appended as the last child of `parent`
+        node_id createNode(node_id parent);
+        node_id createNode();
+
+        // Destroys the node and its whole subtree
+        bool destroyNode(node_id id);
+        bool isNodeValid(node_id id) const;
+
+        // Moves the node, with its subtree, to the end of the children of `parent`
+        bool setParent(node_id id, node_id parent);
+        node_id getParent(node_id id) const;
+
+        // Local transform, like sf::Transformable: scaled and rotated (in degrees) around the origin
+        bool setPosition(node_id id, const math::vec2df& position);
+        bool setRotation(node_id id, float rotation);
+        bool setScale(node_id id, const math::vec2df& scale);
+        bool setOrigin(node_id id, const math::vec2df& origin);
+
+        math::vec2df getPosition(node_id id) const;
+        float getRotation(node_id id) const;
+        math::vec2df getScale(node_id id) const;
+
+        // Hidden nodes hide their subtree too
+        bool setVisible(node_id id, bool visible);
+        bool isVisible(node_id id) const;
+
+        // Shapes in node space: rectangles and sprites have their top-left corner at the node
+        // origin, circles are centered on it and lines start at it
+        bool setRectangle(node_id id, const math::vec2df& size, const pixel& fillColor, float borderThickness = 0.0f, const pixel& borderColor = pixel());
+        bool setCircle(node_id id, float radius, const pixel& fillColor, float borderThickness = 0.0f, const pixel& borderColor = pixel());
+        bool setLine(node_id id, const math::vec2df& end, float thickness, const pixel& color);
+        bool setSprite(node_id id, renderer::texture_id texture, const pixel& tint = pixel(255, 255, 255));
+        bool clearShape(node_id id);
+
+        // World position of a point given in node space, as of the last update()
+        math::vec2df nodeToWorld(node_id id, const math::vec2df& point) const;
+
+        // Destroys every node but the root
+        void clear();
+        std::size_t size() const;
+
+        // Recomputes whatever changed since the last call. render() calls it, so it's only
+        // needed to read world positions before the graph is drawn
+        void update(const renderer& graphics);
+
+        // Draws on the graph layer, or on the targeted one if no layer was set
+        void render(renderer& graphics);
+
+        void setLayer(renderer::layer_id id);
+        renderer::layer_id getLayer() const;
+
+        // Nodes recomputed by the last update(), 0 on frames where nothing changed
+        uint32_t getUpdatedNodes() const;
+        // renderVertices() calls per render()
+        std::size_t getRunCount() const;
+
+    private:
+        static constexpr uint32_t noSlot = std::numeric_limits<uint32_t>::max();
+        static constexpr uint32_t slotMask = 0xFFFFFFu;
+
+        struct shape {
+            enum kind_t : uint8_t {
+                None,
+                Rectangle,
+                Circle,
+                Line,
+                Sprite
+            };
+
+            kind_t kind = None;
+            // Rectangle size or line end
+            math::vec2df size;
+            float radius = 0.0f;
+            // Border of rectangles and circles, width of lines
+            float thickness = 0.0f;
+            pixel fillColor;
+            pixel borderColor;
+            renderer::texture_id texture = renderer::invalidTexture;
+        };
+
+        struct node {
+            uint8_t generation = 0;
+            bool alive = false;
+            bool visible = true;
+            // World transform of the node and its subtree is stale
+            bool dirty = false;
+            // The shape changed, its node space vertices need building again
+            bool geometryDirty = false;
+            // Part of the current layout, false for hidden subtrees
+            bool placed = false;
+
+            uint32_t parent = noSlot;
+            uint32_t firstChild = noSlot;
+            uint32_t lastChild = noSlot;
+            uint32_t previousSibling = noSlot;
+            uint32_t nextSibling = noSlot;
+
+            sf::Transformable local;
+            sf::Transform world;
+
+            shape payload;
+            const sf::Texture* texture = nullptr;
+            // Node space vertices of the shape
+            std::vector<sf::Vertex> geometry;
+            // First of the world space vertices of the shape in `vertices`
+            uint32_t first = 0;
+        };
+
+        // Consecutive nodes sampling the same texture, drawn in one call
+        struct run {
+            const sf::Texture* texture;
+            uint32_t first;
+            uint32_t count;
+        };
+
+        node* findNode(node_id id);
+        const node* findNode(node_id id) const;
+        node_id makeId(uint32_t slot) const;
+
+        void link(uint32_t slot, uint32_t parent);
+        void unlink(uint32_t slot);
+        void markDirty(uint32_t slot);
+        bool setShape(node_id id, const shape& payload);
+
+        void buildGeometry(const renderer& graphics, node& n);
+        void writeVertices(const node& n);
+        // Places every visible node again and rebuilds the runs
+        void layout(const renderer& graphics);
+        // Recomputes the subtree of a dirty node in place, false if it needs a layout
+        bool refresh(const renderer& graphics, uint32_t slot);
+
+        std::vector<node> nodes;
+        std::vector<uint32_t> freeSlots;
+        // Nodes changed since the last update, possibly repeated or already destroyed
+        std::vector<uint32_t> dirtyNodes;
+        std::vector<uint32_t> stack;
+
+        std::vector<sf::Vertex> vertices;
+        std::vector<run> runs;
+
+        bool layoutDirty;
+        std::size_t nodeCount;
+
+        renderer::layer_id layer;
+
+        uint32_t updatedNodes;
+    };
+
+}
@@ -0,0 +1,114 @@
+//
+// Created by Alcachofa
+//
+
+#pragma once
+
+#include <array>
+#include <vector>
+#include <cstdint>
+
+#include <math/vec2d.hpp>
+
+#include <utils/span.hpp>
+#include <utils/worker_pool.hpp>
+
+#include <pixel.hpp>
+#include <pixel_buffer.hpp>
+
+namespace arti {
+
+    // CPU version of the renderer shape set, drawing straight into pixels. Shapes follow
+    // the renderer conventions (circles at their centre with the border outside, rectangles
+    // rotated in degrees around their top-left corner) and cover the pixels whose centre
+    // falls inside them, translucent colours are blended with pixelBlend.
+    //
+    // Draws are recorded and rasterized by flush(). With more than one thread the target
+    // is cut in strips of stripHeight rows, each strip runs every shape in order, so the
+    // result doesn't depend on the thread count. The extra threads stay alive between
+    // flushes
+    class software_rasterizer {
+
+    public:
+        static constexpr int32_t stripHeight = 32;
+
+        // 0 uses std::thread::hardware_concurrency()
+        explicit software_rasterizer(uint32_t threads = 1);
+
+        // Flushes into the previous target first. A pixel_buffer target gets the
+        // drawn area marked dirty on every flush
+        void setTarget(pixel_buffer& buffer);
+        void setTarget(span<pixel> pixels, const math::vec2di& size);
+
+        void setThreadCount(uint32_t threads);
+        uint32_t getThreadCount() const;
+
+        void clear(const pixel& color = pixel(0, 0, 0, 0));
+
+        void renderCircle(const math::vec2df& coords, float radius, const pixel& fillColor);
+        void renderCircle(const math::vec2df& coords, float radius, float borderThickness, const pixel& fillColor, const pixel& borderColor);
+
+        void renderRectangle(const math::vec2df& coords, const math::vec2df& size, const pixel& fillColor, float rotation = 0.0f);
+        void renderRectangle(const math::vec2df& coords, const math::vec2df& size, float borderThickness, const pixel& fillColor, const pixel& borderColor, float rotation = 0.0f);
+
+        void renderSquare(const math::vec2df& coords, float sideSize, const pixel& fillColor, float rotation = 0.0f);
+        void renderSquare(const math::vec2df& coords, float sideSize, float borderThickness, const pixel& fillColor, const pixel& borderColor, float rotation = 0.0f);
+
+        void renderLine(const math::vec2df& pointA, const math::vec2df& pointB, const pixel& color);
+        void renderLine(const math::vec2df& pointA, const math::vec2df& pointB, float thickness, const pixel& color);
+
+        // Rasterizes everything recorded since the last flush
+        void flush();
+
+        std::size_t getPendingShapes() const;
+
+    private:
+        using quad = std::array<math::vec2df, 4>;
+
+        struct shape {
+            enum type_t : uint8_t {
+                Clear,
+                Circle,
+                Ring,
+                Polygon,
+                PolygonRing
+            };
+
+            type_t type;
+            pixel color;
+
+            // Rows [top, bottom) the shape can touch
+            int32_t top;
+            int32_t bottom;
+
+            math::vec2df center;
+            float innerRadius;
+            float outerRadius;
+
+            quad inner;
+            quad outer;
+        };
+
+        void record(const shape& s);
+        void pushQuad(const quad& corners, const pixel& color);
+        void pushQuadRing(const quad& inner, const quad& outer, const pixel& color);
+
+        void rasterize(int32_t top, int32_t bottom) const;
+        void rasterize(const shape& s, int32_t top, int32_t bottom) const;
+        void fillSpan(int32_t y, float left, float right, const pixel& color) const;
+
+        pixel* pixels;
+        math::vec2di size;
+        pixel_buffer* buffer;
+
+        uint32_t threadCount;
+        worker_pool workers;
+
+        std::vector<shape> shapes;
+
+        // Bounding rows and columns of what was drawn since the last flush
+        math::vec2df drawnMin;
+        math::vec2df drawnMax;
+    };
+
+}
@@ -0,0 +1,158 @@
+//
+// Created by Alcachofa
+//
+
+#pragma once
+
+#include <array>
+#include <vector>
+#include <cstdint>
+#include <unordered_map>
+
+#include <math/vec2d.hpp>
+
+namespace arti {
+
+    class renderer;
+
+    // Both indexes store circles (a point with a radius, 0 for plain points) under ids picked
+    // by the caller, usually the index of the object in the app's own arrays, so ids should
+    // stay small and dense. Queries append the ids they find to `found` and return how many
+    // were added. queryRange and queryVisible find a circle when its bounding box touches the
+    // area, the same test renderer::isVisible does, queryRadius when the two circles overlap
+
+    // Uniform grid of cellSize squared cells, only the occupied ones are kept. Best when
+    // objects are spread over an unbounded world and are about the cell size or smaller,
+    // moving inside a cell only updates the stored position
+    class spatial_hash {
+
+    public:
+        static constexpr float defaultCellSize = 64.0f;
+
+        explicit spatial_hash(float cellSize = defaultCellSize);
+
+        bool insert(uint32_t id, const math::vec2df& position, float radius = 0.0f);
+        bool move(uint32_t id, const math::vec2df& position);
+        bool remove(uint32_t id);
+
+        bool contains(uint32_t id) const;
+        math::vec2df getPosition(uint32_t id) const;
+
+        void clear();
+        std::size_t size() const;
+        float getCellSize() const;
+
+        std::size_t queryRange(const math::vec2df& min, const math::vec2df& max, std::vector<uint32_t>& found) const;
+        std::size_t queryRadius(const math::vec2df& center, float radius, std::vector<uint32_t>& found) const;
+        // Everything visible on the layer targeted by `graphics`
+        std::size_t queryVisible(renderer& graphics, std::vector<uint32_t>& found) const;
+
+    private:
+        struct entry {
+            math::vec2df position;
+            float radius;
+            uint64_t cell;
+            // Position inside the cell list
+            uint32_t slot;
+            bool alive;
+        };
+
+        math::vec2di cellCoords(const math::vec2df& position) const;
+        static uint64_t cellKey(const math::vec2di& coords);
+
+        void link(uint32_t id, uint64_t cell);
+        void unlink(uint32_t id);
+
+        // Runs `test` on everything stored in the cells covering [min, max] grown by maxRadius
+        template <typename Test>
+        std::size_t query(const math::vec2df& min, const math::vec2df& max, Test test, std::vector<uint32_t>& found) const;
+
+        // Lists of cells that emptied out, kept for the next new cell up to this many
+        static constexpr std::size_t maxSpareLists = 64;
+
+        float cellSize;
+        float inverseCellSize;
+        // Queries reach this far into the neighbouring cells, it only grows until clear()
+        float maxRadius;
+
+        std::vector<entry> entries;
+        std::size_t count;
+
+        std::unordered_map<uint64_t, std::vector<uint32_t>> cells;
+        std::vector<std::vector<uint32_t>> spareLists;
+    };
+
+    // Quadtree whose nodes hold anything centred in them and at most half their size across,
+    // so big and small objects live at different depths and nothing is stored twice. Nodes
+    // are created on demand, anything centred outside the world bounds stays in the root.
+    // Queries skip empty branches and take whole branches that fall inside the area untested
+    class loose_quadtree {
+
+    public:
+        static constexpr uint32_t defaultMaxDepth = 8;
+
+        // The world is the smallest square centred on the given bounds that contains them
+        loose_quadtree(const math::vec2df& worldMin, const math::vec2df& worldMax, uint32_t maxDepth = defaultMaxDepth);
+
+        bool insert(uint32_t id, const math::vec2df& position, float radius = 0.0f);
+        bool move(uint32_t id, const math::vec2df& position);
+        bool remove(uint32_t id);
+
+        bool contains(uint32_t id) const;
+        math::vec2df getPosition(uint32_t id) const;
+
+        void clear();
+        std::size_t size() const;
+        std::size_t getNodeCount() const;
+
+        std::size_t queryRange(const math::vec2df& min, const math::vec2df& max, std::vector<uint32_t>& found) const;
+        std::size_t queryRadius(const math::vec2df& center, float radius, std::vector<uint32_t>& found) const;
+        // Everything visible on the layer targeted by `graphics`
+        std::size_t queryVisible(renderer& graphics, std::vector<uint32_t>& found) const;
+
+    private:
+        static constexpr int32_t noNode = -1;
+
+        struct node {
+            math::vec2df center;
+            // Half the side of the cell, the loose bounds reach twice as far from the center
+            float halfSize;
+            uint32_t depth;
+            int32_t parent;
+            std::array<int32_t, 4> children;
+            // Objects in this node and below it
+            uint32_t subtreeCount;
+            std::vector<uint32_t> objects;
+        };
+
+        struct entry {
+            math::vec2df position;
+            float radius;
+            int32_t node;
+            uint32_t slot;
+            bool alive;
+        };
+
+        int32_t createNode(const math::vec2df& center, float halfSize, uint32_t depth, int32_t parent);
+        int32_t findNode(const math::vec2df& position, float radius);
+
+        void link(uint32_t id, int32_t nodeIndex);
+        void unlink(uint32_t id);
+
+        void collect(int32_t nodeIndex, std::vector<uint32_t>& found) const;
+
+        // Runs `test` on everything in the nodes whose loose bounds touch [min, max]. With
+        // `takeWhole` the nodes inside [min, max] are taken without testing
+        template <typename Test>
+        std::size_t query(const math::vec2df& min, const math::vec2df& max, bool takeWhole, Test test, std::vector<uint32_t>& found) const;
+
+        math::vec2df worldCenter;
+        float worldHalfSize;
+        uint32_t maxDepth;
+
+        std::vector<node> nodes;
+        std::vector<entry> entries;
+        std::size_t count;
+    };
+
+}
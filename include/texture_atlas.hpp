@@ -0,0 +1,69 @@
+//
+// Created by Alcachofa
+//
+
+#pragma once
+
+#include <memory>
+#include <vector>
+#include <limits>
+#include <cstdint>
+#include <string_view>
+
+#include <SFML/Graphics/Rect.hpp>
+#include <SFML/Graphics/Image.hpp>
+#include <SFML/Graphics/Texture.hpp>
+
+namespace arti {
+
+    // Packs images into a few large textures (pages) so everything drawn from the same
+    // page can go out in one draw call. Images can't be removed once added
+    class texture_atlas {
+
+    public:
+        using texture_id = uint16_t;
+
+        static constexpr texture_id invalidTexture = std::numeric_limits<texture_id>::max();
+        static constexpr uint32_t defaultPageSize = 2048;
+        // Edge pixels are repeated this far around every image so smoothing doesn't bleed
+        static constexpr int32_t padding = 1;
+
+        struct region {
+            uint16_t page;
+            // Texel rectangle inside the page, padding excluded
+            sf::IntRect rect;
+        };
+
+        // Pages are pageSize squared, clamped to what the GPU supports. Bigger images get a page of their own
+        explicit texture_atlas(uint32_t pageSize = defaultPageSize);
+        ~texture_atlas();
+
+        texture_atlas(const texture_atlas&) = delete;
+        texture_atlas& operator=(const texture_atlas&) = delete;
+
+        // Must run on the thread that owns the GL context
+        texture_id add(const sf::Image& image);
+        texture_id add(std::string_view file);
+
+        bool isValid(texture_id id) const;
+        const region& getRegion(texture_id id) const;
+        const sf::Texture& getPage(uint16_t page) const;
+
+        std::size_t getTextureCount() const;
+        std::size_t getPageCount() const;
+
+        void setSmooth(bool smooth);
+
+    private:
+        struct page;
+
+        page* createPage(const sf::Vector2u& minSize);
+
+        uint32_t pageSize;
+        bool smooth;
+
+        std::vector<std::unique_ptr<page>> pages;
+        std::vector<region> regions;
+    };
+
+}
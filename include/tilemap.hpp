@@ -0,0 +1,138 @@
+//
+// Created by Alcachofa
+//
+
+#pragma once
+
+#include <vector>
+#include <limits>
+#include <cstdint>
+
+#include <SFML/Graphics/Vertex.hpp>
+#include <SFML/Graphics/Texture.hpp>
+#include <SFML/Graphics/VertexBuffer.hpp>
+
+#include <math/vec2d.hpp>
+
+#include <pixel.hpp>
+#include <renderer.hpp>
+
+namespace arti {
+
+    // Grid of tiles kept on the GPU in chunks of chunkSize squared tiles, one static
+    // sf::VertexBuffer each. Every tile owns six vertices in its chunk (empty tiles are
+    // degenerate), so changing a tile re-uploads only the changed range of that chunk, and
+    // chunks that didn't change cost a single draw call. Only the chunks inside the view of
+    // the layer are drawn.
+    //
+    // Dirty chunks seen by render() are uploaded on the main thread through
+    // renderer::runBeforeSubmit, right away unless the renderer is recording. In deferred
+    // or pipelined mode the tilemap must outlive the frame it was rendered in
+    class tilemap {
+
+    public:
+        using tile_index = uint16_t;
+
+        static constexpr tile_index emptyTile = std::numeric_limits<tile_index>::max();
+        static constexpr int32_t defaultChunkSize = 32;
+
+        struct tile {
+            // Into the tileset, left to right then top to bottom. Without a tileset any
+            // index but emptyTile draws a flat square of `color`
+            tile_index index = emptyTile;
+            // Tint with a tileset
+            pixel color = pixel(255, 255, 255);
+        };
+
+        tilemap(const math::vec2di& mapSize, const math::vec2df& tileSize, int32_t chunkSize = defaultChunkSize);
+
+        // Tiles of tileTexels cut from a texture loaded into the renderer atlas
+        bool setTileset(const renderer& graphics, renderer::texture_id tileset, const math::vec2di& tileTexels);
+        void clearTileset();
+
+        // False outside the map, or for an index past the last tile of the tileset. Tiles
+        // left out of range by a later setTileset draw as empty
+        bool setTile(const math::vec2di& coords, const tile& value);
+        const tile& getTile(const math::vec2di& coords) const;
+        bool isInside(const math::vec2di& coords) const;
+
+        // False, and nothing changes, for an index past the last tile of the tileset
+        bool fill(const tile& value);
+
+        // World position of the top-left corner of the map, moving it doesn't re-upload anything
+        void setPosition(const math::vec2df& position);
+        math::vec2df getPosition() const;
+
+        // Tile under a world position, not necessarily inside the map
+        math::vec2di worldToTile(const math::vec2df& world) const;
+
+        math::vec2di getSize() const;
+        math::vec2df getTileSize() const;
+        int32_t getChunkSize() const;
+
+        // Draws on the tilemap layer, or on the targeted one if no layer was set
+        void render(renderer& graphics);
+
+        void setLayer(renderer::layer_id id);
+        renderer::layer_id getLayer() const;
+
+        // Chunks drawn by the last render(), and uploaded for it (once the frame is closed when recording)
+        uint32_t getDrawnChunks() const;
+        uint32_t getUploadedChunks() const;
+
+    private:
+        struct chunk {
+            sf::VertexBuffer buffer;
+            // Tiles that aren't empty, chunks without any are skipped
+            uint32_t filled;
+            // Dirty tile slots [dirtyFirst, dirtyLast), empty when equal
+            uint32_t dirtyFirst;
+            uint32_t dirtyLast;
+            // Waiting in pendingUploads
+            bool uploadQueued;
+        };
+
+        std::size_t tileIndex(const math::vec2di& coords) const;
+        // Without a tileset every index is
+        bool isValidIndex(tile_index index) const;
+
+        void markDirty(const math::vec2di& coords);
+        void markAllDirty();
+
+        // Appends the six vertices of every slot in [first, last) of the chunk, in map space
+        // (the map position goes in the render states)
+        void buildVertices(const math::vec2di& chunkCoords, uint32_t first, uint32_t last, std::vector<sf::Vertex>& out) const;
+        void queueUpload(renderer& graphics, const math::vec2di& chunkCoords);
+        // Main thread only, through renderer::runBeforeSubmit
+        void uploadPending();
+        void upload(const math::vec2di& chunkCoords, chunk& c);
+
+        math::vec2di mapSize;
+        math::vec2df tileSize;
+        int32_t chunkSize;
+        math::vec2di chunkCount;
+
+        math::vec2df position;
+
+        std::vector<tile> tiles;
+        std::vector<chunk> chunks;
+        std::vector<math::vec2di> pendingUploads;
+        std::vector<sf::Vertex> scratch;
+
+        const sf::Texture* tilesetTexture;
+        sf::IntRect tilesetRect;
+        math::vec2di tileTexels;
+        int32_t tilesetColumns;
+        // Tiles the tileset holds, whole rows only
+        int32_t tilesetTiles;
+
+        // No vertex buffer support, chunks are rebuilt into scratch every frame
+        bool useBuffers;
+
+        renderer::layer_id layer;
+
+        uint32_t drawnChunks;
+        uint32_t uploadedChunks;
+    };
+
+}
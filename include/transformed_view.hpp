@@ -0,0 +1,117 @@
+//
+// Created by Alcachofa
+//
+
+#pragma once
+
+#include <vector>
+#include <cstdint>
+
+#include <math/vec2d.hpp>
+
+#include <utils/span.hpp>
+
+namespace arti {
+
+    class renderer;
+
+    // Pan and zoom camera for a layer. The world to screen mapping and its inverse are kept
+    // as precomputed affine transforms (scale then translation), so converting a point is a
+    // multiply-add per axis and whole spans go through SIMD. The visible world area is kept
+    // too, for culling without going through the renderer.
+    //
+    // "Screen" means window pixels, like renderer::viewToScreen: apply() reads the placement
+    // of the targeted layer (its offset, scale and size) and pushes the camera into its view,
+    // only when the camera changed
+    class transformed_view {
+
+    public:
+        static constexpr float defaultZoomDuration = 0.25f;
+
+        struct affine {
+            math::vec2df scale;
+            math::vec2df translation;
+
+            inline math::vec2df apply(const math::vec2df& p) const {
+                return { p.x * scale.x + translation.x, p.y * scale.y + translation.y };
+            }
+        };
+
+        // Viewport in pixels until apply() reads the real one from a layer
+        explicit transformed_view(const math::vec2df& viewportSize = { 1.0f, 1.0f });
+
+        // World position shown at the top-left corner of the layer
+        void setOffset(const math::vec2df& offset);
+        math::vec2df getOffset() const;
+
+        // Layer pixels per world unit, clamped to the scale limits
+        void setScale(float scale);
+        float getScale() const;
+
+        void setScaleLimits(float minScale, float maxScale);
+
+        // Moves the world along with a drag of `screenDelta` pixels
+        void pan(const math::vec2df& screenDelta);
+        // Multiplies the scale keeping the world under `screenPoint` in place
+        void zoomAt(float factor, const math::vec2df& screenPoint);
+        // Same, animated over `duration` seconds by update(). Zooming again while animating
+        // compounds on the scale being animated to
+        void smoothZoomAt(float factor, const math::vec2df& screenPoint, float duration = defaultZoomDuration);
+
+        // Advances the zoom animation, true if the camera moved and needs apply() again
+        bool update(float deltaTime);
+        bool isZooming() const;
+
+        // Reads the placement of the targeted layer and sets its view to this camera
+        void apply(renderer& graphics);
+
+        inline math::vec2df worldToScreen(const math::vec2df& world) const { return forward.apply(world); }
+        inline math::vec2df screenToWorld(const math::vec2df& screen) const { return inverse.apply(screen); }
+
+        // `out` must be at least as long as `in`, they may be the same span
+        void worldToScreen(span<const math::vec2df> in, span<math::vec2df> out) const;
+        void screenToWorld(span<const math::vec2df> in, span<math::vec2df> out) const;
+
+        const affine& getWorldToScreen() const;
+        const affine& getScreenToWorld() const;
+
+        math::vec2df getVisibleMin() const;
+        math::vec2df getVisibleMax() const;
+
+        inline bool isVisible(const math::vec2df& world, float radius = 0.0f) const {
+            return world.x >= visibleMin.x - radius && world.x <= visibleMax.x + radius &&
+                   world.y >= visibleMin.y - radius && world.y <= visibleMax.y + radius;
+        }
+
+        // Appends the indices of the positions that pass isVisible, returns how many were added
+        std::size_t cullBatch(span<const math::vec2df> positions, float radius, std::vector<uint32_t>& visible) const;
+
+    private:
+        void setScaleKeeping(float scale, const math::vec2df& screenPoint);
+        void updateTransforms();
+
+        math::vec2df viewOffset;
+        float viewScale;
+        float minScale;
+        float maxScale;
+
+        // Placement of the layer on screen, from apply()
+        math::vec2df layerOffset;
+        float layerScale;
+        math::vec2df viewportSize;
+
+        bool zooming;
+        float zoomFrom;
+        float zoomTarget;
+        float zoomElapsed;
+        float zoomDuration;
+        math::vec2df zoomAnchor;
+
+        affine forward;
+        affine inverse;
+
+        math::vec2df visibleMin;
+        math::vec2df visibleMax;
+    };
+
+}
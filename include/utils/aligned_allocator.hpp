@@ -0,0 +1,51 @@
+//
+// Created by Alcachofa
+//
+
+#pragma once
+
+#include <new>
+#include <cstddef>
+
+namespace arti {
+
+    // std::allocator with a minimum alignment, for arrays SIMD kernels read
+    template <typename T, std::size_t Alignment>
+    class aligned_allocator {
+
+    public:
+        typedef T value_type;
+
+        static_assert(Alignment >= alignof(T) && (Alignment & (Alignment - 1)) == 0, "Alignment must be a power of two and at least alignof(T)");
+
+        template <typename U>
+        struct rebind {
+            typedef aligned_allocator<U, Alignment> other;
+        };
+
+        aligned_allocator() noexcept = default;
+
+        template <typename U>
+        aligned_allocator(const aligned_allocator<U, Alignment>&) noexcept {}
+
+        T* allocate(std::size_t count) {
+            return static_cast<T*>(::operator new(count * sizeof(T), std::align_val_t(Alignment)));
+        }
+
+        void deallocate(T* ptr, std::size_t) noexcept {
+            ::operator delete(ptr, std::align_val_t(Alignment));
+        }
+
+        template <typename U>
+        bool operator==(const aligned_allocator<U, Alignment>&) const noexcept {
+            return true;
+        }
+
+        template <typename U>
+        bool operator!=(const aligned_allocator<U, Alignment>&) const noexcept {
+            return false;
+        }
+
+    };
+
+}
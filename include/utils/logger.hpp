@@ -4,102 +4,408 @@
 
 #pragma once
 
+#include <tuple>
+#include <atomic>
 #include <string>
+#include <cstdint>
+#include <cstring>
+#include <utility>
 #include <iostream>
+#include <iterator>
+#include <algorithm>
+#include <string_view>
+#include <type_traits>
 
 #include <fmt/format.h>
 #include <fmt/color.h>
 #include <fmt/ostream.h>
 #include <fmt/chrono.h>
 
+#include <utils/utils.hpp>
+
+// Lowest level compiled in, the ARTI_LOG_* macros below it expand to nothing
+#define ARTI_LOG_LEVEL_DEBUG 0
+#define ARTI_LOG_LEVEL_INFO 1
+#define ARTI_LOG_LEVEL_WARNING 2
+#define ARTI_LOG_LEVEL_ERROR 3
+#define ARTI_LOG_LEVEL_CRITICAL 4
+#define ARTI_LOG_LEVEL_OFF 5
+
+#ifdef ARTI_DISABLE_LOGGER
+#undef ARTI_LOG_LEVEL
+#define ARTI_LOG_LEVEL ARTI_LOG_LEVEL_OFF
+#endif
+
+#ifndef ARTI_LOG_LEVEL
+#define ARTI_LOG_LEVEL ARTI_LOG_LEVEL_DEBUG
+#endif
+
 namespace arti {
 
+    // Messages are formatted once and written to the console and the optional log file.
+    // Synchronous by default; startAsync() moves the writing to a background thread,
+    // callers only fill a slot of a lock-free ring buffer.
+    //
+    // The ARTI_LOG_* macros check the format string at compile time and vanish, arguments
+    // included, below ARTI_LOG_LEVEL. In async mode, when every argument is a number or a
+    // string, they copy the arguments into the ring as they are and the writer thread
+    // formats them
     class logger {
 
     public:
+        enum class level : uint8_t {
+            Debug,
+            Info,
+            Warning,
+            Error,
+            Critical,
+            Off
+        };
+
+        // What logging does when the ring buffer is full
+        enum class overflow_policy : uint8_t {
+            // The message is lost and counted, see getDroppedCount()
+            Drop,
+            // The caller waits for the writer thread to make room
+            Block
+        };
+
+        static constexpr level compiledLevel = static_cast<level>(ARTI_LOG_LEVEL);
+
+        static constexpr std::size_t defaultQueueSize = 8192;
+        // Longer messages are truncated in async mode
+        static constexpr std::size_t maxMessageSize = 246;
+
         logger(const logger&) = delete;
         logger(logger&&) = delete;
 
         logger& operator=(const logger&) = delete;
         logger& operator=(logger&&) = delete;
 
+        // Queue size is rounded up to a power of two. Fails if already async
+        static bool startAsync(std::size_t queueSize = defaultQueueSize, overflow_policy policy = overflow_policy::Drop);
+        // Writes whatever is queued and goes back to synchronous. Nothing may log meanwhile
+        static void stopAsync();
+        static bool isAsync();
+
+        // Returns once every message logged before the call is written
+        static void flush();
+
+        // Also writes every message, without colors, to `path`. An empty path closes the file
+        static bool setLogFile(std::string_view path);
+        static void setConsoleOutput(bool enabled);
+
+        static uint64_t getDroppedCount();
+
+        // Runtime threshold on top of ARTI_LOG_LEVEL, checked before anything is formatted
+        static void setLevel(level minimum) {
+            minimumLevel.store(to<uint8_t>(minimum), std::memory_order_relaxed);
+        }
+
+        static level getLevel() {
+            return static_cast<level>(minimumLevel.load(std::memory_order_relaxed));
+        }
+
+        static bool isEnabled(level severity) {
+            return severity >= compiledLevel && to<uint8_t>(severity) >= minimumLevel.load(std::memory_order_relaxed);
+        }
+
+        template <level Severity, typename... Args>
+        static void log(fmt::format_string<Args...> format, Args&&... args) {
+            if constexpr (Severity >= compiledLevel && Severity != level::Off) {
+                if (isEnabled(Severity)) {
+                    vlog(to<uint8_t>(Severity), format, fmt::make_format_args(args...));
+                }
+            }
+        }
+
+        // Format strings from FMT_STRING, what the ARTI_LOG_* macros use
+        template <level Severity, typename S, typename... Args, std::enable_if_t<std::is_base_of_v<fmt::detail::compile_string, S>, int> = 0>
+        static void log(const S& format, Args&&... args) {
+            if constexpr (Severity >= compiledLevel && Severity != level::Off) {
+                if (! isEnabled(Severity)) {
+                    return;
+                }
+
+                if constexpr ((isDeferrable<std::decay_t<Args>> && ...)) {
+                    if (defer<S>(to<uint8_t>(Severity), std::index_sequence_for<Args...>(), args...)) {
+                        return;
+                    }
+                }
+
+                vlog(to<uint8_t>(Severity), fmt::format_string<Args...>(format), fmt::make_format_args(args...));
+            }
+        }
+
         template <typename... Args>
-        static void info(const std::string& logMsg, Args&&... args) {
-#ifndef ARTI_DISABLE_LOGGER
-            fmt::print(
-                    "{} > {}\n",
-                    fmt::format(fmt::fg(fmt::terminal_color::bright_blue), "I"),
-                    fmt::format(logMsg, std::forward<Args>(args)...)
-            );
-#endif
+        static void info(fmt::format_string<Args...> format, Args&&... args) {
+            log<level::Info>(format, std::forward<Args>(args)...);
         }
 
         template <typename... Args>
-        static void warning(const std::string& logMsg, Args&&... args) {
-#ifndef ARTI_DISABLE_LOGGER
-            fmt::print(
-                    "{} > {}\n",
-                    fmt::format(fmt::fg(fmt::terminal_color::yellow), "W"),
-                    fmt::format(logMsg, std::forward<Args>(args)...)
-            );
-#endif
+        static void warning(fmt::format_string<Args...> format, Args&&... args) {
+            log<level::Warning>(format, std::forward<Args>(args)...);
         }
 
         template <typename... Args>
-        static void critical(const std::string& logMsg, Args&&... args) {
-#ifndef ARTI_DISABLE_LOGGER
-            fmt::print(
-                    "{} > {}\n",
-                    fmt::format(fmt::bg(fmt::terminal_color::red) | fmt::fg(fmt::terminal_color::white), "C"),
-                    fmt::format(logMsg, std::forward<Args>(args)...)
-            );
-#endif
+        static void critical(fmt::format_string<Args...> format, Args&&... args) {
+            log<level::Critical>(format, std::forward<Args>(args)...);
         }
 
         template <typename... Args>
-        static void debug(const std::string& logMsg, Args&&... args) {
-#ifndef ARTI_DISABLE_LOGGER
-            fmt::print(
-                    "{} > {}\n",
-                    fmt::format(fmt::fg(fmt::color::gray), "D"),
-                    fmt::format(logMsg, std::forward<Args>(args)...)
-            );
-#endif
+        static void debug(fmt::format_string<Args...> format, Args&&... args) {
+            log<level::Debug>(format, std::forward<Args>(args)...);
         }
 
         template <typename... Args>
-        static void error(const std::string& logMsg, Args&&... args) {
-#ifndef ARTI_DISABLE_LOGGER
-            fmt::print(
-                    "{} > {}\n",
-                    fmt::format(fmt::fg(fmt::terminal_color::red), "E"),
-                    fmt::format(logMsg, std::forward<Args>(args)...)
-            );
-#endif
+        static void error(fmt::format_string<Args...> format, Args&&... args) {
+            log<level::Error>(format, std::forward<Args>(args)...);
         }
 
         template <typename... Args>
-        static void print(const std::string& logMsg, Args&&... args) {
+        static void print(fmt::format_string<Args...> format, Args&&... args) {
 #ifndef ARTI_DISABLE_LOGGER
-            using namespace std::string_literals;
-            fmt::print("  > "s + logMsg + "\n", std::forward<Args>(args)...);
+            vlog(printRecord, format, fmt::make_format_args(args...));
 #endif
         }
 
         template <typename ...Args>
-        static void print(const fmt::text_style& ts, const std::string& logMsg, Args&&... args) {
+        static void print(const fmt::text_style& ts, fmt::format_string<Args...> format, Args&&... args) {
 #ifndef ARTI_DISABLE_LOGGER
-            using namespace std::string_literals;
-            fmt::print("  > "s);
-            fmt::print(ts, logMsg + "\n", std::forward<Args>(args) ...);
+            // fmt has no styled format_to_n, so this one is copied into the ring
+            fmt::memory_buffer body;
+            fmt::vformat_to(std::back_inserter(body), ts, fmt::string_view(format), fmt::make_format_args(args...));
+            submit(printRecord, { body.data(), body.size() });
 #endif
         }
 
         static void endl() {
 #ifndef ARTI_DISABLE_LOGGER
-            fmt::print("\n");
+            submit(newlineRecord, {});
 #endif
         }
+
+    private:
+        // Record types past the levels
+        static constexpr uint8_t printRecord = 6;
+        static constexpr uint8_t newlineRecord = 7;
+        // Set on records holding raw arguments instead of text
+        static constexpr uint8_t deferredRecord = 0x80;
+
+        // Slot of the async ring, filled in place by the logging thread
+        struct record {
+            // Hands the slot between the logging threads and the writer
+            std::atomic<uint64_t> sequence;
+            uint8_t type;
+            uint8_t size;
+            char text[maxMessageSize];
+        };
+
+        // Formats the raw arguments of a deferred record, the writer thread calls it
+        using decoder = void (*)(const char* args, fmt::memory_buffer& out);
+
+        // Numbers are copied as they are, strings as a length byte and up to 255 chars.
+        // A C string formatted with {:p} is copied as the pointer, its text may be gone by
+        // the time the writer thread formats it
+        template <typename T>
+        static constexpr bool isDeferrable = std::is_arithmetic_v<T> || std::is_convertible_v<const T&, std::string_view>;
+
+        template <typename T, bool AsPointer>
+        using wire_t = std::conditional_t<std::is_arithmetic_v<T>, T, std::conditional_t<AsPointer, const void*, std::string_view>>;
+
+        // True if a replacement field of `format` prints argument `index` with the p type
+        static constexpr bool isPointerField(fmt::string_view format, std::size_t index) {
+            std::size_t nextIndex = 0;
+
+            for (std::size_t i = 0; i < format.size(); ++i) {
+                if (format[i] != '{') {
+                    continue;
+                }
+                if (i + 1 < format.size() && format[i + 1] == '{') {
+                    ++i;
+                    continue;
+                }
+
+                // Argument id, automatic when there is none
+                ++i;
+                std::size_t id = nextIndex;
+                if (i < format.size() && format[i] >= '0' && format[i] <= '9') {
+                    id = 0;
+                    for (; i < format.size() && format[i] >= '0' && format[i] <= '9'; ++i) {
+                        id = id * 10 + to<std::size_t>(format[i] - '0');
+                    }
+                }
+                else {
+                    ++nextIndex;
+                }
+
+                // Spec up to the closing brace, nested fields are dynamic width or precision
+                std::size_t last = i;
+                for (; i < format.size() && format[i] != '}'; ++i) {
+                    if (format[i] == '{') {
+                        if (i + 1 < format.size() && format[i + 1] == '}') {
+                            ++nextIndex;
+                        }
+                        for (; i < format.size() && format[i] != '}'; ++i) {}
+                    }
+                    last = i;
+                }
+
+                if (id == index && last < format.size() && format[last] == 'p') {
+                    return true;
+                }
+            }
+
+            return false;
+        }
+
+        template <typename S, typename T, std::size_t Index>
+        using arg_wire_t = wire_t<T, std::is_pointer_v<std::decay_t<T>> && isPointerField(S(), Index)>;
+
+        template <typename T>
+        static std::string_view asView(const T& value) {
+            if constexpr (std::is_pointer_v<T>) {
+                return value != nullptr ? std::string_view(value) : std::string_view();
+            }
+            else {
+                return std::string_view(value);
+            }
+        }
+
+        template <typename Wire, typename T>
+        static std::size_t wireSize(const T& value) {
+            if constexpr (! std::is_same_v<Wire, std::string_view>) {
+                return sizeof(Wire);
+            }
+            else {
+                return 1 + std::min<std::size_t>(asView(value).size(), 255);
+            }
+        }
+
+        template <typename Wire, typename T>
+        static void writeArg(char*& out, const T& value) {
+            if constexpr (! std::is_same_v<Wire, std::string_view>) {
+                const Wire wire = value;
+                std::memcpy(out, &wire, sizeof(Wire));
+                out += sizeof(Wire);
+            }
+            else {
+                auto view = asView(value);
+                auto size = std::min<std::size_t>(view.size(), 255);
+                *out++ = to<char>(size);
+                std::memcpy(out, view.data(), size);
+                out += size;
+            }
+        }
+
+        template <typename T>
+        static T readArg(const char*& in) {
+            if constexpr (! std::is_same_v<T, std::string_view>) {
+                T value;
+                std::memcpy(&value, in, sizeof(T));
+                in += sizeof(T);
+                return value;
+            }
+            else {
+                auto size = to<uint8_t>(*in++);
+                std::string_view value(in, size);
+                in += size;
+                return value;
+            }
+        }
+
+        template <typename S, typename... Wire>
+        static void decode([[maybe_unused]] const char* in, fmt::memory_buffer& out) {
+            // Braced, so the arguments are read left to right
+            std::tuple<Wire...> values{ readArg<Wire>(in)... };
+            std::apply([&out](const auto&... value) {
+                fmt::format_to(std::back_inserter(out), S(), value...);
+            }, values);
+        }
+
+        // False if the arguments don't fit a record or logging is synchronous, the caller
+        // formats the message then
+        template <typename S, std::size_t... Index, typename... Args>
+        static bool defer(uint8_t type, std::index_sequence<Index...>, const Args&... args) {
+            if ((sizeof(decoder) + ... + wireSize<arg_wire_t<S, Args, Index>>(args)) > maxMessageSize) {
+                return false;
+            }
+
+            auto* r = acquire(type | deferredRecord);
+
+            if (r == nullptr) {
+                // Dropped on a full ring
+                return isAsync();
+            }
+
+            const decoder format = &decode<S, arg_wire_t<S, Args, Index>...>;
+            char* out = r->text;
+
+            std::memcpy(out, &format, sizeof(decoder));
+            out += sizeof(decoder);
+            (writeArg<arg_wire_t<S, Args, Index>>(out, args), ...);
+
+            publish(r, to<std::size_t>(out - r->text));
+            return true;
+        }
+
+        // Formats the message, then queues it or writes it right away when synchronous
+        static void vlog(uint8_t type, fmt::string_view format, fmt::format_args args);
+
+        // Ring, writer thread and sinks, defined in logger.cpp
+        struct async_state;
+        static async_state& state();
+
+        // A free slot of the ring, nullptr when synchronous or when the message is dropped
+        static record* acquire(uint8_t type);
+        static void publish(record* r, std::size_t size);
+        // Queues an already formatted message, or writes it when synchronous
+        static void submit(uint8_t type, std::string_view body);
+
+        // Writes a whole line to every sink, right away
+        static void write(uint8_t type, std::string_view body);
+
+        static void formatLine(fmt::memory_buffer& out, uint8_t type, std::string_view body, bool colored);
+        static void writeLines(async_state& s, const fmt::memory_buffer& consoleLines, const fmt::memory_buffer& fileLines);
+
+        static inline std::atomic<uint8_t> minimumLevel{ 0 };
     };
 
-}
\ No newline at end of file
+}
+
+// Compile time checked format strings, compiled out below ARTI_LOG_LEVEL. Arguments are
+// only evaluated when the level is enabled
+#if ARTI_LOG_LEVEL <= ARTI_LOG_LEVEL_DEBUG
+#define ARTI_LOG_DEBUG(format, ...) \
+    (::arti::logger::isEnabled(::arti::logger::level::Debug) ? ::arti::logger::log<::arti::logger::level::Debug>(FMT_STRING(format), ##__VA_ARGS__) : void())
+#else
+#define ARTI_LOG_DEBUG(format, ...) ((void) 0)
+#endif
+
+#if ARTI_LOG_LEVEL <= ARTI_LOG_LEVEL_INFO
+#define ARTI_LOG_INFO(format, ...) \
+    (::arti::logger::isEnabled(::arti::logger::level::Info) ? ::arti::logger::log<::arti::logger::level::Info>(FMT_STRING(format), ##__VA_ARGS__) : void())
+#else
+#define ARTI_LOG_INFO(format, ...) ((void) 0)
+#endif
+
+#if ARTI_LOG_LEVEL <= ARTI_LOG_LEVEL_WARNING
+#define ARTI_LOG_WARNING(format, ...) \
+    (::arti::logger::isEnabled(::arti::logger::level::Warning) ? ::arti::logger::log<::arti::logger::level::Warning>(FMT_STRING(format), ##__VA_ARGS__) : void())
+#else
+#define ARTI_LOG_WARNING(format, ...) ((void) 0)
+#endif
+
+#if ARTI_LOG_LEVEL <= ARTI_LOG_LEVEL_ERROR
+#define ARTI_LOG_ERROR(format, ...) \
+    (::arti::logger::isEnabled(::arti::logger::level::Error) ? ::arti::logger::log<::arti::logger::level::Error>(FMT_STRING(format), ##__VA_ARGS__) : void())
+#else
+#define ARTI_LOG_ERROR(format, ...) ((void) 0)
+#endif
+
+#if ARTI_LOG_LEVEL <= ARTI_LOG_LEVEL_CRITICAL
+#define ARTI_LOG_CRITICAL(format, ...) \
+    (::arti::logger::isEnabled(::arti::logger::level::Critical) ? ::arti::logger::log<::arti::logger::level::Critical>(FMT_STRING(format), ##__VA_ARGS__) : void())
+#else
+#define ARTI_LOG_CRITICAL(format, ...) ((void) 0)
+#endif
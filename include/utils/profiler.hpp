@@ -0,0 +1,116 @@
+//
+// Created by Alcachofa
+//
+
+#pragma once
+
+// Everything in here compiles to nothing unless ARTI_ENABLE_PROFILER is defined
+#ifdef ARTI_ENABLE_PROFILER
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+
+namespace arti {
+
+    class profiler {
+
+    public:
+        static constexpr std::size_t maxZones = 32;
+        static constexpr std::size_t historySize = 240;
+
+        struct zone_record {
+            const char* name;
+            uint32_t depth;
+            int64_t start;
+            int64_t end;
+        };
+
+        struct frame_record {
+            float frameMs;
+            uint32_t zoneCount;
+            std::array<zone_record, maxZones> zones;
+        };
+
+        profiler(const profiler&) = delete;
+        profiler(profiler&&) = delete;
+
+        profiler& operator=(const profiler&) = delete;
+        profiler& operator=(profiler&&) = delete;
+
+        static profiler& get();
+
+        // Closes the running frame (if any) and starts a new one
+        void newFrame();
+
+        // Zones may be opened from any thread, nesting is tracked per thread
+        uint32_t beginZone(const char* name);
+        void endZone(uint32_t zone);
+
+        // Time since the start of the running frame
+        int64_t now() const;
+
+        float percentile(float p) const;
+
+        const frame_record& lastFrame() const;
+
+        void setOverlayVisible(bool visible);
+        bool isOverlayVisible() const;
+
+        void drawOverlay();
+
+    private:
+        profiler();
+
+        using clock = std::chrono::steady_clock;
+
+        clock::time_point frameStart;
+
+        frame_record current;
+        std::atomic<uint32_t> zoneCount;
+
+        std::array<frame_record, historySize> history;
+        std::size_t historyHead;
+        std::size_t historyCount;
+        // percentile() reorders a copy of the frame times, kept here so the overlay doesn't allocate
+        mutable std::array<float, historySize> percentileScratch;
+
+        // False until the first newFrame()
+        bool frameRunning;
+        bool overlayVisible;
+    };
+
+    class profile_zone {
+
+    public:
+        explicit profile_zone(const char* name)
+                : zone(profiler::get().beginZone(name)) {}
+
+        ~profile_zone() {
+            profiler::get().endZone(zone);
+        }
+
+        profile_zone(const profile_zone&) = delete;
+        profile_zone& operator=(const profile_zone&) = delete;
+
+    private:
+        uint32_t zone;
+    };
+
+}
+
+#define ARTI_PROFILE_CONCAT_IMPL(a, b) a##b
+#define ARTI_PROFILE_CONCAT(a, b) ARTI_PROFILE_CONCAT_IMPL(a, b)
+
+#define ARTI_PROFILE_SCOPE(name) ::arti::profile_zone ARTI_PROFILE_CONCAT(artiProfileZone, __LINE__)(name)
+#define ARTI_PROFILE_FRAME() ::arti::profiler::get().newFrame()
+#define ARTI_PROFILE_OVERLAY() ::arti::profiler::get().drawOverlay()
+
+#else
+
+#define ARTI_PROFILE_SCOPE(name)
+#define ARTI_PROFILE_FRAME()
+#define ARTI_PROFILE_OVERLAY()
+
+#endif
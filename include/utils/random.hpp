@@ -4,18 +4,340 @@
 
 #pragma once
 
+#include <mutex>
+#include <atomic>
+#include <limits>
 #include <random>
+#include <algorithm>
+#include <cstdint>
+#include <type_traits>
+
+#include <utils/span.hpp>
 
 namespace arti {
 
+    // Every engine below is a UniformRandomBitGenerator, so they also work with the
+    // <random> distributions and std::shuffle
+
+    // One word of state, every seed is fine. Used to expand a single seed into the
+    // state of the other engines
+    class splitmix64 {
+
+    public:
+        typedef uint64_t result_type;
+
+        static constexpr result_type min() { return 0; }
+        static constexpr result_type max() { return std::numeric_limits<result_type>::max(); }
+
+        explicit constexpr splitmix64(uint64_t seed = 0) : state(seed) {}
+
+        constexpr result_type operator()() {
+            uint64_t z = (state += 0x9e3779b97f4a7c15ull);
+            z = (z ^ (z >> 30u)) * 0xbf58476d1ce4e5b9ull;
+            z = (z ^ (z >> 27u)) * 0x94d049bb133111ebull;
+            return z ^ (z >> 31u);
+        }
+
+    private:
+        uint64_t state;
+
+    };
+
+    // xoshiro256** (Blackman & Vigna), 32 bytes of state and a 2^256 - 1 period. The
+    // default engine: jump() makes 2^128 non-overlapping streams out of one seed
+    class xoshiro256ss {
+
+    public:
+        typedef uint64_t result_type;
+
+        static constexpr uint64_t defaultSeed = 0x853c49e6748fea9bull;
+
+        static constexpr result_type min() { return 0; }
+        static constexpr result_type max() { return std::numeric_limits<result_type>::max(); }
+
+        explicit xoshiro256ss(uint64_t seed = defaultSeed) {
+            this->seed(seed);
+        }
+
+        void seed(uint64_t seed) {
+            splitmix64 expand(seed);
+            for (auto& word : s) {
+                word = expand();
+            }
+        }
+
+        result_type operator()() {
+            const uint64_t result = rotl(s[1] * 5, 7) * 9;
+            const uint64_t t = s[1] << 17u;
+
+            s[2] ^= s[0];
+            s[3] ^= s[1];
+            s[1] ^= s[2];
+            s[0] ^= s[3];
+            s[2] ^= t;
+            s[3] = rotl(s[3], 45);
+
+            return result;
+        }
+
+        // Same as 2^128 calls
+        void jump() {
+            static constexpr uint64_t polynomial[] = {
+                    0x180ec6d33cfd0abaull, 0xd5a61266f0c9392cull, 0xa9582618e03fc9aaull, 0x39abdc4529b1661cull
+            };
+            jumpWith(polynomial);
+        }
+
+        // Same as 2^192 calls, streams that are themselves jump()ed apart
+        void longJump() {
+            static constexpr uint64_t polynomial[] = {
+                    0x76e15d3efefdcbbfull, 0xc5004e441c522fb3ull, 0x77710069854ee241ull, 0x39109bb02acbe635ull
+            };
+            jumpWith(polynomial);
+        }
+
+        // Returns the current stream and moves this one 2^128 steps ahead, good for
+        // handing a generator to each worker
+        xoshiro256ss split() {
+            xoshiro256ss stream = *this;
+            jump();
+            return stream;
+        }
+
+        const uint64_t* getState() const {
+            return s;
+        }
+
+    private:
+        uint64_t s[4];
+
+        static constexpr uint64_t rotl(uint64_t x, int k) {
+            return (x << k) | (x >> (64 - k));
+        }
+
+        void jumpWith(const uint64_t (&polynomial)[4]) {
+            uint64_t t[4] = { 0, 0, 0, 0 };
+
+            for (auto word : polynomial) {
+                for (unsigned bit = 0; bit < 64; ++bit) {
+                    if ((word & (uint64_t(1) << bit)) != 0) {
+                        for (int i = 0; i < 4; ++i) {
+                            t[i] ^= s[i];
+                        }
+                    }
+                    operator()();
+                }
+            }
+
+            for (int i = 0; i < 4; ++i) {
+                s[i] = t[i];
+            }
+        }
+
+    };
+
+    // PCG32 (O'Neill), XSH-RR output on a 64-bit LCG. 32-bit results, 2^63 selectable
+    // streams and O(log n) advance()
+    class pcg32 {
+
+    public:
+        typedef uint32_t result_type;
+
+        static constexpr result_type min() { return 0; }
+        static constexpr result_type max() { return std::numeric_limits<result_type>::max(); }
+
+        explicit pcg32(uint64_t seed = 0x853c49e6748fea9bull, uint64_t stream = 0xda3e39cb94b95bdbull) {
+            this->seed(seed, stream);
+        }
+
+        void seed(uint64_t seed, uint64_t stream = 0xda3e39cb94b95bdbull) {
+            state = 0;
+            increment = (stream << 1u) | 1u;
+            operator()();
+            state += seed;
+            operator()();
+        }
+
+        result_type operator()() {
+            const uint64_t old = state;
+            state = old * multiplier + increment;
+
+            const auto xorShifted = static_cast<uint32_t>(((old >> 18u) ^ old) >> 27u);
+            const auto rotation = static_cast<uint32_t>(old >> 59u);
+            return (xorShifted >> rotation) | (xorShifted << ((~rotation + 1u) & 31u));
+        }
+
+        // Same as `delta` calls
+        void advance(uint64_t delta) {
+            uint64_t accMultiplier = 1;
+            uint64_t accIncrement = 0;
+            uint64_t curMultiplier = multiplier;
+            uint64_t curIncrement = increment;
+
+            while (delta > 0) {
+                if ((delta & 1u) != 0) {
+                    accMultiplier *= curMultiplier;
+                    accIncrement = accIncrement * curMultiplier + curIncrement;
+                }
+                curIncrement = (curMultiplier + 1) * curIncrement;
+                curMultiplier *= curMultiplier;
+                delta >>= 1u;
+            }
+
+            state = accMultiplier * state + accIncrement;
+        }
+
+        // A generator on a different stream, seeded from this one
+        pcg32 split() {
+            const uint64_t seed = (uint64_t(operator()()) << 32u) | operator()();
+            const uint64_t stream = (uint64_t(operator()()) << 32u) | operator()();
+            return pcg32(seed, stream);
+        }
+
+    private:
+        static constexpr uint64_t multiplier = 6364136223846793005ull;
+
+        uint64_t state;
+        uint64_t increment;
+
+    };
+
+    // wyrand (Wang Yi), one word of state and a 64x64 -> 128 multiply per call. The
+    // fastest of the three where that multiply is cheap, no jump function
+    class wyrand {
+
+    public:
+        typedef uint64_t result_type;
+
+        static constexpr result_type min() { return 0; }
+        static constexpr result_type max() { return std::numeric_limits<result_type>::max(); }
+
+        explicit constexpr wyrand(uint64_t seed = 0) : state(seed) {}
+
+        void seed(uint64_t seed) {
+            state = seed;
+        }
+
+        result_type operator()() {
+            state += 0xa0761d6478bd642full;
+            uint64_t high;
+            const uint64_t low = multiply(state, state ^ 0xe7037ed1a0b428dbull, high);
+            return low ^ high;
+        }
+
+        // A generator seeded from this one, streams aren't guaranteed disjoint
+        wyrand split() {
+            return wyrand(splitmix64(operator()())());
+        }
+
+        // Full 128-bit product, returns the low half
+        static uint64_t multiply(uint64_t a, uint64_t b, uint64_t& high) {
+#if defined(__SIZEOF_INT128__)
+            const auto product = static_cast<unsigned __int128>(a) * b;
+            high = static_cast<uint64_t>(product >> 64u);
+            return static_cast<uint64_t>(product);
+#else
+            const uint64_t aLow = a & 0xffffffffu, aHigh = a >> 32u;
+            const uint64_t bLow = b & 0xffffffffu, bHigh = b >> 32u;
+
+            const uint64_t lowLow = aLow * bLow;
+            const uint64_t highLow = aHigh * bLow;
+            const uint64_t lowHigh = aLow * bHigh;
+            const uint64_t cross = (lowLow >> 32u) + (highLow & 0xffffffffu) + lowHigh;
+
+            high = aHigh * bHigh + (highLow >> 32u) + (cross >> 32u);
+            return (cross << 32u) | (lowLow & 0xffffffffu);
+#endif
+        }
+
+    private:
+        uint64_t state;
+
+    };
+
+    typedef xoshiro256ss random_engine;
+
     class random_generator {
 
+    public:
+        // Seeds every thread's engine, the next call on each thread picks it up. Until
+        // it's called the seed comes from std::random_device
+        static void setSeed(uint64_t seed) {
+            std::lock_guard<std::mutex> lock(masterMutex);
+            master().seed(seed);
+            seedGeneration.fetch_add(1, std::memory_order_release);
+        }
+
+        // The calling thread's engine, behind the static Get() helpers. Threads get
+        // streams 2^192 steps apart from one master, so they never overlap
+        static random_engine& threadEngine() {
+            thread_local random_engine engine;
+            thread_local uint32_t generation = std::numeric_limits<uint32_t>::max();
+
+            const auto current = seedGeneration.load(std::memory_order_acquire);
+            if (generation != current) {
+                engine = nextThreadStream();
+                generation = current;
+            }
+
+            return engine;
+        }
+
+        // Changes every time setSeed() is called, for state derived from threadEngine()
+        static uint32_t getSeedGeneration() {
+            return seedGeneration.load(std::memory_order_acquire);
+        }
+
+        void seed(uint64_t seed) {
+            gen.seed(seed);
+        }
+
+        // Bits to [0, 1): the top 24 bits for float, 53 for double
+        template <typename RealType_>
+        static RealType_ toUnit(uint64_t bits) {
+            static_assert(std::is_floating_point_v<RealType_>, "toUnit needs a floating point type");
+
+            if constexpr (std::is_same_v<RealType_, float>) {
+                return static_cast<float>(bits >> 40u) * 0x1.0p-24f;
+            }
+            else {
+                return static_cast<RealType_>(static_cast<double>(bits >> 11u) * 0x1.0p-53);
+            }
+        }
+
     protected:
-        std::random_device rd;
-        std::mt19937 gen;
+        random_engine gen;
+
+        // Seeded from this thread's engine, no std::random_device per instance
+        random_generator() : gen(threadEngine()()) {
+
+        }
+
+        explicit random_generator(uint64_t seed) : gen(seed) {
+
+        }
 
-        random_generator() : gen(rd()) {
+        // [0, 1) floats from the calling thread's engine, SSE2/AVX2 where available.
+        // Uses its own 4-lane streams, split from threadEngine()
+        static void fillUnit(span<float> out);
 
+    private:
+        static inline std::mutex masterMutex;
+        static inline std::atomic<uint32_t> seedGeneration{ 0 };
+
+        static random_engine& master() {
+            static random_engine instance([] {
+                std::random_device rd;
+                return (uint64_t(rd()) << 32u) | rd();
+            }());
+            return instance;
+        }
+
+        static random_engine nextThreadStream() {
+            std::lock_guard<std::mutex> lock(masterMutex);
+            random_engine stream = master();
+            master().longJump();
+            return stream;
         }
 
     };
@@ -24,32 +346,37 @@ namespace arti {
     class f_random : public random_generator {
 
     private:
-        std::uniform_real_distribution<RealType_> distribution;
+        RealType_ min;
+        RealType_ range;
 
     public:
-        f_random() : random_generator(), distribution(0, 1.0) {
+        f_random() : random_generator(), min(0), range(1) {
 
         }
 
-        f_random(RealType_ max) : random_generator(), distribution(0, max) {
+        f_random(RealType_ max) : random_generator(), min(0), range(max) {
 
         }
 
-        f_random(RealType_ min, RealType_ max) : random_generator(), distribution(min, max) {
+        f_random(RealType_ min, RealType_ max) : random_generator(), min(min), range(max - min) {
 
         }
 
-        f_random(const f_random& other) : random_generator(), distribution(other.distribution) {
+        // Same range, explicitly seeded for reproducible sequences
+        f_random(RealType_ min, RealType_ max, uint64_t seed) : random_generator(seed), min(min), range(max - min) {
+
+        }
+
+        f_random(const f_random& other) : random_generator(), min(other.min), range(other.range) {
 
         }
 
         RealType_ get() {
-            return distribution(gen);
+            return min + toUnit<RealType_>(gen()) * range;
         }
 
         static RealType_ Get() {
-            static f_random sZeroToOne;
-            return sZeroToOne.get();
+            return toUnit<RealType_>(threadEngine()());
         }
 
         static RealType_ GetRange(RealType_ min, RealType_ max) {
@@ -60,6 +387,28 @@ namespace arti {
             return Get() * max;
         }
 
+        // Fills `out` with Get() values, vectorized for float
+        static void Fill(span<RealType_> out) {
+            if constexpr (std::is_same_v<RealType_, float>) {
+                fillUnit(out);
+            }
+            else {
+                auto& engine = threadEngine();
+                for (auto& value : out) {
+                    value = toUnit<RealType_>(engine());
+                }
+            }
+        }
+
+        static void FillRange(span<RealType_> out, RealType_ min, RealType_ max) {
+            Fill(out);
+
+            const RealType_ range = max - min;
+            for (auto& value : out) {
+                value = min + value * range;
+            }
+        }
+
     };
 
 
@@ -67,42 +416,147 @@ namespace arti {
     class i_random : public random_generator {
 
     private:
-        std::uniform_int_distribution<IntegerType_> distribution;
+        typedef std::make_unsigned_t<IntegerType_> unsigned_type;
+
+        // Bounded values come from 32-bit draws for types that fit, 64-bit ones otherwise
+        typedef std::conditional_t<(std::numeric_limits<unsigned_type>::digits <= 32), uint32_t, uint64_t> word_type;
+
+        IntegerType_ min;
+        // max - min + 1, 0 when that's the whole word
+        word_type range;
 
     public:
-        i_random() : random_generator(), distribution(0, std::numeric_limits<IntegerType_>::max()) {
+        i_random() : random_generator(), min(0), range(rangeOf(0, std::numeric_limits<IntegerType_>::max())) {
 
         }
 
-        i_random(IntegerType_ max) : random_generator(), distribution(0, max) {
+        i_random(IntegerType_ max) : random_generator(), min(0), range(rangeOf(0, max)) {
 
         }
 
-        i_random(IntegerType_ min, IntegerType_ max) : random_generator(), distribution(min, max) {
+        i_random(IntegerType_ min, IntegerType_ max) : random_generator(), min(min), range(rangeOf(min, max)) {
 
         }
 
-        i_random(const i_random& other) : random_generator(), distribution(other.distribution) {
+        // Same range, explicitly seeded for reproducible sequences
+        i_random(IntegerType_ min, IntegerType_ max, uint64_t seed) : random_generator(seed), min(min), range(rangeOf(min, max)) {
 
         }
 
+        i_random(const i_random& other) : random_generator(), min(other.min), range(other.range) {
+
+        }
+
+        // [min, max]
         IntegerType_ get() {
-            return distribution(gen);
+            if (range == 0) {
+                return offset(min, draw(gen));
+            }
+            return offset(min, bounded(gen, range));
         }
 
+        // [0, max of the type]
         static IntegerType_ Get() {
-            static i_random sZeroToMax;
-            return sZeroToMax.get();
+            return static_cast<IntegerType_>(threadEngine()() >> (64u - std::numeric_limits<IntegerType_>::digits));
         }
 
+        // [0, max)
         static IntegerType_ GetUnder(IntegerType_ max) {
-            return Get() % max;
+            return GetRange(0, max);
         }
 
+        // [min, max)
         static IntegerType_ GetRange(IntegerType_ min, IntegerType_ max) {
-            return min + Get() % (max - min);
+            return offset(min, bounded(threadEngine(), difference(min, max)));
+        }
+
+        // Fills `out` with GetUnder(max) values
+        static void GetUnder(span<IntegerType_> out, IntegerType_ max) {
+            GetRange(out, 0, max);
+        }
+
+        // Fills `out` with GetRange(min, max) values. The rejection threshold, the only
+        // division, is worked out once for the whole span
+        static void GetRange(span<IntegerType_> out, IntegerType_ min, IntegerType_ max) {
+            auto& engine = threadEngine();
+            const word_type range = difference(min, max);
+
+            // Empty range, like GetRange(min, min) every value is min
+            if (range == 0) {
+                std::fill(out.begin(), out.end(), min);
+                return;
+            }
+            const word_type threshold = static_cast<word_type>(word_type(0) - range) % range;
+
+            auto reduce = [&](word_type bits) {
+                word_type high;
+                word_type low = multiply(bits, range, high);
+                while (low < threshold) {
+                    low = multiply(draw(engine), range, high);
+                }
+                return offset(min, high);
+            };
+
+            std::size_t i = 0;
+            if constexpr (std::is_same_v<word_type, uint32_t>) {
+                // Both halves of every engine output
+                for (; i + 2 <= out.size(); i += 2) {
+                    const uint64_t bits = engine();
+                    out[i] = reduce(static_cast<uint32_t>(bits >> 32u));
+                    out[i + 1] = reduce(static_cast<uint32_t>(bits));
+                }
+            }
+
+            for (; i < out.size(); ++i) {
+                out[i] = reduce(draw(engine));
+            }
+        }
+
+    private:
+        static word_type draw(random_engine& engine) {
+            return static_cast<word_type>(engine() >> (64u - std::numeric_limits<word_type>::digits));
+        }
+
+        static word_type multiply(word_type a, word_type b, word_type& high) {
+            if constexpr (std::is_same_v<word_type, uint32_t>) {
+                const uint64_t product = uint64_t(a) * b;
+                high = static_cast<uint32_t>(product >> 32u);
+                return static_cast<uint32_t>(product);
+            }
+            else {
+                return wyrand::multiply(a, b, high);
+            }
+        }
+
+        // Lemire's multiply-shift, [0, range) for range > 0: the high word of bits * range.
+        // Only when the low word lands under 2^w mod range is the draw biased, so the
+        // division runs rarely and no uniform draw ever needs one
+        static word_type bounded(random_engine& engine, word_type range) {
+            word_type high;
+            word_type low = multiply(draw(engine), range, high);
+
+            if (low < range) {
+                const word_type threshold = static_cast<word_type>(word_type(0) - range) % range;
+                while (low < threshold) {
+                    low = multiply(draw(engine), range, high);
+                }
+            }
+
+            return high;
+        }
+
+        static word_type difference(IntegerType_ min, IntegerType_ max) {
+            return static_cast<word_type>(static_cast<unsigned_type>(static_cast<unsigned_type>(max) - static_cast<unsigned_type>(min)));
+        }
+
+        static word_type rangeOf(IntegerType_ min, IntegerType_ max) {
+            return static_cast<word_type>(difference(min, max) + 1);
+        }
+
+        static IntegerType_ offset(IntegerType_ min, word_type value) {
+            return static_cast<IntegerType_>(static_cast<unsigned_type>(static_cast<unsigned_type>(min) + value));
         }
 
     };
 
-}
\ No newline at end of file
+}
@@ -0,0 +1,66 @@
+//
+// Created by Alcachofa
+//
+
+#pragma once
+
+#include <cstdint>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+    #define ARTI_SIMD_SSE2
+    #include <emmintrin.h>
+#endif
+
+// AVX2 code is built into every x86 binary and only called after hasAVX2() says
+// the CPU runs it, ARTI_TARGET_AVX2 marks the functions allowed to use it
+#if defined(ARTI_SIMD_SSE2) && (defined(__GNUC__) || defined(__clang__))
+    #define ARTI_SIMD_AVX2
+    #define ARTI_TARGET_AVX2 __attribute__((target("avx2")))
+    #include <immintrin.h>
+#elif defined(ARTI_SIMD_SSE2) && defined(_MSC_VER)
+    #define ARTI_SIMD_AVX2
+    #define ARTI_TARGET_AVX2
+    #include <immintrin.h>
+    #include <intrin.h>
+#endif
+
+namespace arti::simd {
+
+    // Code path of every SIMD module (pixel_ops, vec2d_batch, random fills, particles)
+    enum class level : uint8_t {
+        Scalar,
+        SSE2,
+        AVX2
+    };
+
+    // Fastest path this CPU supports, picked by default
+    level bestLevel();
+    level activeLevel();
+
+    // Forces a code path, clamped to bestLevel(), returns the one actually used.
+    // Meant for benchmarks and comparisons, not thread safe against running kernels
+    level setLevel(level forced);
+
+    inline bool hasAVX2() {
+#if defined(ARTI_SIMD_AVX2) && defined(_MSC_VER)
+        static const bool supported = [] {
+            int info[4];
+            __cpuid(info, 1);
+            // The OS must save the YMM registers on context switches
+            bool osxsave = (info[2] & (1 << 27)) != 0 && (info[2] & (1 << 28)) != 0;
+            if (! osxsave || (_xgetbv(0) & 0x6) != 0x6) {
+                return false;
+            }
+            __cpuidex(info, 7, 0);
+            return (info[1] & (1 << 5)) != 0;
+        }();
+        return supported;
+#elif defined(ARTI_SIMD_AVX2)
+        static const bool supported = __builtin_cpu_supports("avx2");
+        return supported;
+#else
+        return false;
+#endif
+    }
+
+}
@@ -0,0 +1,67 @@
+//
+// Created by Alcachofa
+//
+
+#pragma once
+
+#include <cstddef>
+#include <iterator>
+#include <type_traits>
+
+namespace arti {
+
+    // Minimal non-owning view over contiguous memory, stand-in for C++20 std::span
+    template <typename T>
+    class span {
+
+    public:
+        typedef T element_type;
+        typedef std::remove_cv_t<T> value_type;
+        typedef T *pointer;
+        typedef T &reference;
+        typedef T *iterator;
+        typedef std::size_t size_type;
+
+        constexpr span() noexcept : ptr(nullptr), count(0) {}
+
+        constexpr span(pointer data, size_type size) noexcept
+                : ptr(data),
+                  count(size) {}
+
+        template <std::size_t N>
+        constexpr span(element_type (&arr)[N]) noexcept
+                : ptr(arr),
+                  count(N) {}
+
+        template <typename Container, typename = std::enable_if_t<
+                !std::is_same_v<std::remove_cv_t<Container>, span> &&
+                std::is_convertible_v<decltype(std::data(std::declval<Container&>())), pointer>>>
+        constexpr span(Container& container) noexcept
+                : ptr(std::data(container)),
+                  count(std::size(container)) {}
+
+        template <typename U, typename = std::enable_if_t<std::is_convertible_v<U(*)[], T(*)[]>>>
+        constexpr span(const span<U>& other) noexcept
+                : ptr(other.data()),
+                  count(other.size()) {}
+
+        constexpr pointer data() const noexcept { return ptr; }
+        constexpr size_type size() const noexcept { return count; }
+        constexpr bool empty() const noexcept { return count == 0; }
+
+        constexpr iterator begin() const noexcept { return ptr; }
+        constexpr iterator end() const noexcept { return ptr + count; }
+
+        constexpr reference operator[](size_type idx) const { return ptr[idx]; }
+
+        constexpr span first(size_type n) const { return span(ptr, n); }
+        constexpr span last(size_type n) const { return span(ptr + count - n, n); }
+        constexpr span subspan(size_type offset, size_type n) const { return span(ptr + offset, n); }
+        constexpr span subspan(size_type offset) const { return span(ptr + offset, count - offset); }
+
+    private:
+        pointer ptr;
+        size_type count;
+    };
+
+}
@@ -0,0 +1,162 @@
+//
+// Created by Alcachofa
+//
+
+#pragma once
+
+// Everything in here compiles to nothing unless ARTI_ENABLE_TRACE is defined
+#ifdef ARTI_ENABLE_TRACE
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include <cstdint>
+#include <string_view>
+
+#if defined(_MSC_VER) && (defined(_M_X64) || defined(_M_IX86))
+    #include <intrin.h>
+    #define ARTI_TRACE_TSC
+#elif defined(__x86_64__) || defined(__i386__)
+    #include <x86intrin.h>
+    #define ARTI_TRACE_TSC
+#endif
+
+namespace arti {
+
+    // Keeps the last events of every thread in per-thread rings and writes them as
+    // Chrome Trace Event JSON, which Perfetto and chrome://tracing can open
+    class trace_recorder {
+
+    public:
+        // Events kept per thread, older ones get overwritten
+        static constexpr std::size_t ringSize = 1u << 16u;
+
+        // Timestamps are raw ticks of the cheapest clock available (the TSC on x86),
+        // converted to time only when a dump is written
+        struct event {
+            // Must point to storage that outlives the recorder, string literals are fine
+            const char* name;
+            int64_t start;
+            int64_t duration;
+        };
+
+        trace_recorder(const trace_recorder&) = delete;
+        trace_recorder(trace_recorder&&) = delete;
+
+        trace_recorder& operator=(const trace_recorder&) = delete;
+        trace_recorder& operator=(trace_recorder&&) = delete;
+
+        ~trace_recorder();
+
+        static trace_recorder& get();
+
+        void setEnabled(bool enabled);
+        bool isEnabled() const;
+
+        // Shown in Perfetto instead of the numeric thread id
+        void setThreadName(const char* name);
+
+        inline int64_t now() const {
+#ifdef ARTI_TRACE_TSC
+            return static_cast<int64_t>(__rdtsc());
+#else
+            return clock::now().time_since_epoch().count();
+#endif
+        }
+
+        inline void record(const char* name, int64_t start, int64_t end) {
+            auto& buffer = threadBuffer();
+            auto head = buffer.head.load(std::memory_order_relaxed);
+            buffer.events[head & (ringSize - 1)] = { name, start, end - start };
+            buffer.head.store(head + 1, std::memory_order_release);
+        }
+
+        // Copies what is in the rings right now and writes it to `path` from a
+        // background thread, so the caller only pays for the copy
+        void dump(std::string_view path);
+
+        // Blocks until the last dump finished writing
+        void waitForDump();
+
+    private:
+        struct thread_buffer {
+            uint32_t tid;
+            // Set by the owner, read by dump()
+            std::atomic<const char*> name;
+            std::atomic<uint64_t> head;
+            std::unique_ptr<event[]> events;
+        };
+
+        struct thread_snapshot {
+            uint32_t tid;
+            const char* name;
+            std::vector<event> events;
+        };
+
+        trace_recorder();
+
+        inline thread_buffer& threadBuffer() {
+            thread_local thread_buffer* buffer = nullptr;
+            if (buffer == nullptr) {
+                buffer = &registerThread();
+            }
+            return *buffer;
+        }
+
+        thread_buffer& registerThread();
+
+        static void write(const std::string& path, const std::vector<thread_snapshot>& snapshot, int64_t epochTicks, double nsPerTick);
+
+        using clock = std::chrono::steady_clock;
+
+        clock::time_point epoch;
+        int64_t epochTicks;
+        std::atomic<bool> enabled;
+
+        std::mutex threadsMutex;
+        std::vector<std::unique_ptr<thread_buffer>> threads;
+
+        std::thread writer;
+    };
+
+    class trace_zone {
+
+    public:
+        explicit trace_zone(const char* name)
+                : name(name),
+                  start(trace_recorder::get().isEnabled() ? trace_recorder::get().now() : -1) {}
+
+        ~trace_zone() {
+            if (start >= 0) {
+                auto& recorder = trace_recorder::get();
+                recorder.record(name, start, recorder.now());
+            }
+        }
+
+        trace_zone(const trace_zone&) = delete;
+        trace_zone& operator=(const trace_zone&) = delete;
+
+    private:
+        const char* name;
+        int64_t start;
+    };
+
+}
+
+#define ARTI_TRACE_CONCAT_IMPL(a, b) a##b
+#define ARTI_TRACE_CONCAT(a, b) ARTI_TRACE_CONCAT_IMPL(a, b)
+
+#define ARTI_TRACE_SCOPE(name) ::arti::trace_zone ARTI_TRACE_CONCAT(artiTraceZone, __LINE__)(name)
+#define ARTI_TRACE_THREAD(name) ::arti::trace_recorder::get().setThreadName(name)
+
+#else
+
+#define ARTI_TRACE_SCOPE(name)
+#define ARTI_TRACE_THREAD(name)
+
+#endif
@@ -7,7 +7,7 @@
 namespace arti {
 
     template <typename T, typename U>
-    inline T to(const U& val) {
+    constexpr T to(const U& val) {
         return static_cast<T>(val);
     }
 
@@ -0,0 +1,61 @@
+//
+// Created by Alcachofa
+//
+
+#pragma once
+
+#include <mutex>
+#include <atomic>
+#include <thread>
+#include <vector>
+#include <cstdint>
+#include <functional>
+#include <condition_variable>
+
+namespace arti {
+
+    // Threads kept alive between parallel loops, so per-frame work (rasterizer strips,
+    // particle chunks) doesn't create and join threads every time. run() hands the task
+    // indices out to the workers and the calling thread and returns once all of them are
+    // done. One run() at a time, from the thread that owns the pool
+    class worker_pool {
+
+    public:
+        // Threads besides the caller, they start with the first run() that needs them
+        explicit worker_pool(uint32_t workers = 0);
+        ~worker_pool();
+
+        worker_pool(const worker_pool&) = delete;
+        worker_pool& operator=(const worker_pool&) = delete;
+
+        // Joins the running workers if the count changes
+        void setWorkerCount(uint32_t workers);
+        uint32_t getWorkerCount() const;
+
+        // Calls task(i) once for every i in [0, tasks), in no particular order
+        void run(std::size_t tasks, const std::function<void(std::size_t)>& task);
+
+    private:
+        // `seen` is the generation the worker was started at
+        void workerLoop(uint64_t seen);
+        void drain();
+        void stopWorkers();
+
+        uint32_t workerCount;
+        std::vector<std::thread> workers;
+
+        std::mutex mutex;
+        std::condition_variable startSignal;
+        std::condition_variable doneSignal;
+        bool stopping;
+        // Bumped by every run(), workers wait for it to change
+        uint64_t generation;
+        // Workers still inside the current run()
+        uint32_t busy;
+
+        const std::function<void(std::size_t)>* current;
+        std::size_t taskCount;
+        std::atomic<std::size_t> nextTask;
+    };
+
+}
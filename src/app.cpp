@@ -4,10 +4,18 @@
 
 #include <app.hpp>
 
+#include <cmath>
+#include <ctime>
+#include <algorithm>
+
+#include <SFML/System/Sleep.hpp>
+
 #include <imgui.hpp>
 
 #include <utils/utils.hpp>
 #include <utils/logger.hpp>
+#include <utils/profiler.hpp>
+#include <utils/trace.hpp>
 
 namespace arti {
 
@@ -15,20 +23,36 @@ namespace arti {
             : isRunning(false),
               isInitialized(false),
               exitRequested(false),
+              headless(false),
+              frameCapture(false),
+              frameCount(0),
               deltaTime(0.0f),
+              fixedAccumulator(0.0f),
+              interpolationAlpha(0.0f),
+              updateRequested(false),
+              updateFinished(false),
+              updateResult(true),
+              stopUpdateWorker(false),
               appName("Artichaut App"),
               graphics(nullptr) {
         input = std::make_unique<input_manager>(this);
         graphics = std::make_unique<renderer>(this);
+        assets = std::make_unique<asset_manager>(*graphics);
     }
 
     app::~app() {
         pExit();
     }
 
-    bool app::init(std::string_view name, math::vec2di windowSize, sf::Uint32 style) {
+    bool app::init(std::string_view name, math::vec2di windowSize, sf::Uint32 style, const frame_settings& settings) {
+        if (isInitialized && headless) {
+            logger::error("App was initialized headless, it can't open a window");
+            return false;
+        }
+
         this->appName = name;
         window.create(sf::VideoMode(windowSize.x, windowSize.y), appName, style);
+        setFrameSettings(settings);
 
         if (isInitialized) return true;
 
@@ -37,6 +61,37 @@ namespace arti {
             return false;
         }
 
+        return pInit();
+    }
+
+    bool app::initHeadless(std::string_view name, math::vec2di size, const frame_settings& settings) {
+        if (isInitialized && ! headless) {
+            logger::error("App was initialized with a window, it can't go headless");
+            return false;
+        }
+
+        this->appName = name;
+        headless = true;
+
+        if (! offscreen.create(to<uint32_t>(size.x), to<uint32_t>(size.y))) {
+            logger::error("Failed to create the {}x{} offscreen target", size.x, size.y);
+            return false;
+        }
+
+        setFrameSettings(settings);
+
+        if (isInitialized) return true;
+
+        // The window is never created, ImGui only uses it for focus and clipboard queries
+        if (! ImGui::SFML::Init(window, sf::Vector2f(to<float>(size.x), to<float>(size.y)), false)) {
+            logger::error("Failed to init ImGui");
+            return false;
+        }
+
+        return pInit();
+    }
+
+    bool app::pInit() {
         if (! graphics->init()) {
             logger::error("Couldn't initialize renderer");
             return false;
@@ -51,7 +106,7 @@ namespace arti {
         auto& io = ImGui::GetIO();
 
         if (io.Fonts->Fonts.empty()) {
-            logger::debug("Loading default font");
+            ARTI_LOG_DEBUG("Loading default font");
             io.Fonts->AddFontDefault();
             io.Fonts->Build();
             if (! ImGui::SFML::UpdateFontTexture()) {
@@ -71,6 +126,15 @@ namespace arti {
         }
 
         isRunning = true;
+        frameCount = 0;
+
+        ARTI_TRACE_THREAD("Main");
+
+        const bool pipelined = frameSettings.pipelined;
+        if (pipelined) {
+            graphics->setPipelined(true);
+            pStartUpdateWorker();
+        }
 
         sf::Clock timer;
 
@@ -78,21 +142,37 @@ namespace arti {
         int fps = 0;
 
         while (isRunning) {
+            ARTI_PROFILE_FRAME();
+
             auto elapsed = timer.restart();
+            if (frameSettings.frameDelta > 0.0f) {
+                elapsed = sf::seconds(frameSettings.frameDelta);
+            }
+            deltaTime = to<float>(elapsed.asMicroseconds()) / 1000000.0f;
+
+            bool frameOk = ! exitRequested && (pipelined ? pPipelinedFrame(elapsed) : pUpdate(elapsed) && pRender());
 
-            if (! exitRequested && pUpdate(elapsed)) {
-                pRender();
-                deltaTime = to<float>(elapsed.asMicroseconds()) / 1000000.0f;
+            if (frameOk) {
+                ++frameCount;
 
 #ifdef ARTI_MEASURE_FPS
                 ++fps;
                     fAccTime += deltaTime;
                     if (fAccTime >= 1.0f) {
-                        window.setTitle(sf::String(fmt::format("{} - FPS: {}", appName, fps)));
+                        if (! headless) {
+                            window.setTitle(sf::String(fmt::format("{} - FPS: {}", appName, fps)));
+                        }
                         fps = 0;
                         fAccTime -= 1.0f;
                     }
 #endif
+
+                if (frameSettings.frameLimit > 0 && frameCount >= frameSettings.frameLimit) {
+                    pExit();
+                    continue;
+                }
+
+                pPaceFrame(timer);
             }
             else {
                 pExit();
@@ -103,21 +183,22 @@ namespace arti {
     }
 
     bool app::onInit() { return true; }
+    bool app::onFixedUpdate(float) { return true; }
     bool app::onExit() { return true; }
 
     void app::onResize(math::vec2di newSize) { }
     void app::onPollEvent(const sf::Event &event) { }
 
     int32_t app::getWidth() const {
-        return to<int32_t>(window.getSize().x);
+        return getSize().x;
     }
 
     int32_t app::getHeight() const {
-        return to<int32_t>(window.getSize().y);
+        return getSize().y;
     }
 
     math::vec2di app::getSize() const {
-        auto size = window.getSize();
+        auto size = headless ? offscreen.getSize() : window.getSize();
         return {to<int32_t>(size.x), to<int32_t>(size.y)};
     }
 
@@ -125,19 +206,61 @@ namespace arti {
         return appName;
     }
 
+    const frame_settings& app::getFrameSettings() const {
+        return frameSettings;
+    }
+
+    void app::setFrameSettings(const frame_settings& settings) {
+        frameSettings = settings;
+        frameSettings.tickRate = std::max(frameSettings.tickRate, 1.0f);
+        frameSettings.maxCatchUpSteps = std::max(frameSettings.maxCatchUpSteps, 1);
+        frameSettings.frameCap = std::max(frameSettings.frameCap, 0.0f);
+        frameSettings.frameDelta = std::max(frameSettings.frameDelta, 0.0f);
+
+        fixedAccumulator = 0.0f;
+        interpolationAlpha = 0.0f;
+
+        if (headless) {
+            // No display to sync to and the clock must not depend on the machine
+            frameSettings.vsync = false;
+            if (frameSettings.frameDelta == 0.0f) {
+                frameSettings.frameDelta = 1.0f / frameSettings.tickRate;
+            }
+            return;
+        }
+
+        window.setVerticalSyncEnabled(frameSettings.vsync);
+    }
+
+    float app::getInterpolationAlpha() const {
+        return interpolationAlpha;
+    }
+
     void app::setName(std::string_view name) {
         this->appName = name;
         window.setTitle(appName);
     }
 
     void app::setSize(math::vec2du windowSize) {
-        window.setSize(windowSize);
+        if (! headless) {
+            window.setSize(windowSize);
+            return;
+        }
+
+        // Windows report this through a Resized event, do the same work here
+        if (! offscreen.create(windowSize.x, windowSize.y)) {
+            logger::error("Failed to resize the offscreen target to {}x{}", windowSize.x, windowSize.y);
+            return;
+        }
+
+        graphics->invalidateVisibleAreas();
+        onResize(getSize());
     }
 
     void app::setIcon(std::string_view iconFile) {
-        sf::Image icon;
-        icon.loadFromFile(std::string(iconFile));
-        window.setIcon(icon.getSize().x, icon.getSize().y, icon.getPixelsPtr());
+        assets->loadImage(iconFile, [this](sf::Image& icon) {
+            window.setIcon(icon.getSize().x, icon.getSize().y, icon.getPixelsPtr());
+        });
     }
 
 
@@ -188,43 +311,240 @@ namespace arti {
             case sf::Event::Resized:
                 sf::FloatRect visibleArea(0, 0, event.size.width, event.size.height);
                 window.setView(sf::View(visibleArea));
+                graphics->invalidateVisibleAreas();
                 onResize(window.getSize());
                 break;
         }
     }
 
     bool app::pUpdate(const sf::Time& elapsed) {
-        sf::Event event;
-        while (window.pollEvent(event)) {
-            onPollEvent(event);
-            onSFMLEvent(event);
+        ARTI_TRACE_SCOPE("app::pUpdate");
+        return pPollEvents(elapsed) && pSimulate();
+    }
+
+    bool app::pPollEvents(const sf::Time& elapsed) {
+        if (! headless) {
+            ARTI_PROFILE_SCOPE("Poll events");
+            sf::Event event;
+            while (window.pollEvent(event)) {
+                onPollEvent(event);
+                onSFMLEvent(event);
+            }
         }
-        input->update();
+
+        {
+            ARTI_PROFILE_SCOPE("input_manager::update");
+            input->update();
+        }
+
+        {
+            ARTI_PROFILE_SCOPE("asset_manager::processUploads");
+            assets->processUploads();
+        }
+
+#ifdef ARTI_ENABLE_TRACE
+        if (input->isKeyPressed(key_t::F12)) {
+            trace_recorder::get().dump(fmt::format("arti_trace_{}.json", std::time(nullptr)));
+        }
+#endif
 
         if (exitRequested) {
             return false;
         }
 
-        ImGui::SFML::Update(window, elapsed);
+        {
+            ARTI_PROFILE_SCOPE("ImGui::SFML::Update");
+            if (headless) {
+                auto size = offscreen.getSize();
+                ImGui::SFML::Update(sf::Vector2i(), sf::Vector2f(to<float>(size.x), to<float>(size.y)), elapsed);
+            }
+            else {
+                ImGui::SFML::Update(window, elapsed);
+            }
+        }
+
+        return true;
+    }
+
+    bool app::pSimulate() {
+        ARTI_TRACE_SCOPE("app::pSimulate");
 
-        if (! onUpdate(deltaTime)) {
+        if (frameSettings.fixedTimestep && ! pFixedUpdate()) {
             return false;
         }
 
+        {
+            ARTI_PROFILE_SCOPE("onUpdate");
+            if (! onUpdate(deltaTime)) {
+                return false;
+            }
+        }
+
+        ARTI_PROFILE_OVERLAY();
+
+        return true;
+    }
+
+    bool app::pFixedUpdate() {
+        ARTI_PROFILE_SCOPE("onFixedUpdate");
+
+        const float step = 1.0f / frameSettings.tickRate;
+
+        fixedAccumulator += deltaTime;
+
+        int32_t steps = 0;
+        while (fixedAccumulator >= step && steps < frameSettings.maxCatchUpSteps) {
+            if (! onFixedUpdate(step)) {
+                return false;
+            }
+
+            fixedAccumulator -= step;
+            ++steps;
+        }
+
+        // Too far behind (breakpoint, window drag...), drop the backlog instead of spiralling
+        if (fixedAccumulator >= step) {
+            fixedAccumulator = std::fmod(fixedAccumulator, step);
+        }
+
+        interpolationAlpha = fixedAccumulator / step;
         return true;
     }
 
     bool app::pRender() {
+        ARTI_TRACE_SCOPE("app::pRender");
+
         graphics->render();
-        window.display();
+
+        pDisplay();
+        return true;
+    }
+
+    bool app::pPipelinedFrame(const sf::Time& elapsed) {
+        ARTI_TRACE_SCOPE("app::pPipelinedFrame");
+
+        if (! pPollEvents(elapsed)) {
+            return false;
+        }
+
+        graphics->closeRecordedFrame();
+
+        {
+            std::lock_guard<std::mutex> lock(updateMutex);
+            updateRequested = true;
+            updateFinished = false;
+        }
+        updateSignal.notify_all();
+
+        graphics->submitRecordedFrame();
+
+        bool result;
+        {
+            std::unique_lock<std::mutex> lock(updateMutex);
+            updateSignal.wait(lock, [this] { return updateFinished; });
+            result = updateResult;
+        }
+
+        if (! result) {
+            return false;
+        }
+
+        graphics->renderOverlay();
+
+        pDisplay();
         return true;
     }
 
+    void app::pStartUpdateWorker() {
+        stopUpdateWorker = false;
+        updateRequested = false;
+        updateFinished = false;
+        updateWorker = std::thread(&app::pUpdateWorkerLoop, this);
+    }
+
+    void app::pStopUpdateWorker() {
+        if (! updateWorker.joinable()) return;
+
+        {
+            std::lock_guard<std::mutex> lock(updateMutex);
+            stopUpdateWorker = true;
+        }
+        updateSignal.notify_all();
+
+        updateWorker.join();
+        graphics->setPipelined(false);
+    }
+
+    void app::pUpdateWorkerLoop() {
+        ARTI_TRACE_THREAD("Update worker");
+
+        std::unique_lock<std::mutex> lock(updateMutex);
+
+        while (true) {
+            updateSignal.wait(lock, [this] { return updateRequested || stopUpdateWorker; });
+
+            if (stopUpdateWorker) {
+                return;
+            }
+
+            updateRequested = false;
+            lock.unlock();
+
+            bool result = pSimulate();
+
+            lock.lock();
+            updateResult = result;
+            updateFinished = true;
+            updateSignal.notify_all();
+        }
+    }
+
+    void app::pDisplay() {
+        ARTI_PROFILE_SCOPE("window.display");
+
+        if (headless) {
+            offscreen.display();
+        }
+        else {
+            // The back buffer is undefined once it's swapped, so copy it first
+            if (frameCapture) {
+                const auto size = window.getSize();
+                if (presentedFrame.getSize() != size && ! presentedFrame.create(size.x, size.y)) {
+                    logger::error("Failed to create the capture texture");
+                    frameCapture = false;
+                }
+                else {
+                    presentedFrame.update(window);
+                }
+            }
+
+            window.display();
+        }
+    }
+
+    void app::pPaceFrame(const sf::Clock& frameTimer) {
+        if (frameSettings.frameCap <= 0.0f) {
+            return;
+        }
+
+        const auto target = sf::seconds(1.0f / frameSettings.frameCap);
+        const auto spin = sf::seconds(frameSettings.spinThreshold);
+
+        auto remaining = target - frameTimer.getElapsedTime();
+        if (remaining > spin) {
+            sf::sleep(remaining - spin);
+        }
+
+        while (frameTimer.getElapsedTime() < target) { }
+    }
+
     void app::pExit() {
         if (! isRunning) return;
 
         isRunning = false;
 
+        pStopUpdateWorker();
+
         if (! onExit()) {
             logger::warning("User onExit returned false");
         }
@@ -236,4 +556,48 @@ namespace arti {
     sf::RenderWindow& app::getWindow() {
         return this->window;
     }
+
+    bool app::isHeadless() const {
+        return headless;
+    }
+
+    sf::RenderTarget& app::getRenderTarget() {
+        if (headless) {
+            return offscreen;
+        }
+        return window;
+    }
+
+    uint64_t app::getFrameCount() const {
+        return frameCount;
+    }
+
+    sf::Image app::captureFrame() {
+        if (headless) {
+            return offscreen.getTexture().copyToImage();
+        }
+
+        if (! frameCapture || presentedFrame.getSize().x == 0) {
+            logger::error("No frame captured, call setFrameCapture(true) before presenting it");
+            return {};
+        }
+
+        return presentedFrame.copyToImage();
+    }
+
+    void app::setFrameCapture(bool enabled) {
+        frameCapture = enabled;
+    }
+
+    bool app::isFrameCapturing() const {
+        return frameCapture;
+    }
+
+    bool app::saveFrame(std::string_view path) {
+        if (! captureFrame().saveToFile(std::string(path))) {
+            logger::error("Failed to save frame to '{}'", path);
+            return false;
+        }
+        return true;
+    }
 }
\ No newline at end of file
@@ -0,0 +1,226 @@
+//
+// Created by Alcachofa
+//
+
+#include <asset_manager.hpp>
+
+#include <chrono>
+#include <fstream>
+#include <iterator>
+#include <algorithm>
+
+#include <utils/logger.hpp>
+#include <utils/trace.hpp>
+
+namespace arti {
+
+    asset_manager::asset_manager(renderer& graphics, uint32_t threads)
+            : graphics(graphics),
+              threadCount(threads),
+              uploadBudgetMs(defaultUploadBudgetMs),
+              stopping(false),
+              pending(0) {
+        if (threadCount == 0) {
+            threadCount = std::max(std::thread::hardware_concurrency(), 2u) - 1;
+        }
+    }
+
+    asset_manager::~asset_manager() {
+        stopWorkers();
+    }
+
+    texture_handle asset_manager::loadTexture(std::string_view file) {
+        auto asset = std::make_shared<texture_asset>();
+        asset->path = file;
+
+        enqueue([this, asset] {
+            ARTI_TRACE_SCOPE("asset_manager::decodeImage");
+
+            auto image = std::make_shared<sf::Image>();
+            if (! image->loadFromFile(asset->path)) {
+                logger::error("Couldn't load texture '{}'", asset->path);
+                asset->status.store(asset_status::Failed, std::memory_order_release);
+                --pending;
+                uploadsSignal.notify_all();
+                return;
+            }
+
+            pushUpload([this, asset, image] {
+                asset->id = graphics.loadTexture(*image);
+                asset->size = graphics.getTextureSize(asset->id);
+                asset->status.store(asset->id != renderer::invalidTexture ? asset_status::Ready : asset_status::Failed, std::memory_order_release);
+            });
+        });
+
+        return texture_handle(std::move(asset));
+    }
+
+    font_handle asset_manager::loadFont(std::string_view file) {
+        auto asset = std::make_shared<font_asset>();
+        asset->path = file;
+
+        enqueue([this, asset] {
+            ARTI_TRACE_SCOPE("asset_manager::readFont");
+
+            std::ifstream stream(asset->path, std::ios::binary);
+            if (stream) {
+                asset->data.assign(std::istreambuf_iterator<char>(stream), std::istreambuf_iterator<char>());
+            }
+
+            if (! stream || asset->data.empty()) {
+                logger::error("Couldn't read font '{}'", asset->path);
+                asset->status.store(asset_status::Failed, std::memory_order_release);
+                --pending;
+                uploadsSignal.notify_all();
+                return;
+            }
+
+            pushUpload([asset] {
+                bool loaded = asset->font.loadFromMemory(asset->data.data(), asset->data.size());
+                if (! loaded) {
+                    logger::error("Couldn't parse font '{}'", asset->path);
+                }
+                asset->status.store(loaded ? asset_status::Ready : asset_status::Failed, std::memory_order_release);
+            });
+        });
+
+        return font_handle(std::move(asset));
+    }
+
+    void asset_manager::loadImage(std::string_view file, std::function<void(sf::Image&)> onLoaded) {
+        enqueue([this, path = std::string(file), onLoaded = std::move(onLoaded)] {
+            ARTI_TRACE_SCOPE("asset_manager::decodeImage");
+
+            auto image = std::make_shared<sf::Image>();
+            if (! image->loadFromFile(path)) {
+                logger::error("Couldn't load image '{}'", path);
+                --pending;
+                uploadsSignal.notify_all();
+                return;
+            }
+
+            pushUpload([image, onLoaded] {
+                onLoaded(*image);
+            });
+        });
+    }
+
+    void asset_manager::processUploads() {
+        processUploads(false);
+    }
+
+    void asset_manager::processUploads(bool unbounded) {
+        ARTI_TRACE_SCOPE("asset_manager::processUploads");
+
+        // The budget is clamped by setUploadBudget, so it always fits clock::duration
+        using clock = std::chrono::steady_clock;
+        const auto deadline = clock::now() + std::chrono::duration_cast<clock::duration>(std::chrono::duration<float, std::milli>(uploadBudgetMs));
+
+        while (true) {
+            upload finish;
+            {
+                std::lock_guard<std::mutex> lock(uploadsMutex);
+                if (uploads.empty()) {
+                    return;
+                }
+                finish = std::move(uploads.front());
+                uploads.pop_front();
+            }
+
+            finish();
+            --pending;
+
+            if (! unbounded && clock::now() >= deadline) {
+                return;
+            }
+        }
+    }
+
+    void asset_manager::finishAll() {
+        while (pending > 0) {
+            {
+                std::unique_lock<std::mutex> lock(uploadsMutex);
+                // Failures don't leave an upload behind, the timeout covers a missed wake up
+                uploadsSignal.wait_for(lock, std::chrono::milliseconds(10), [this] { return ! uploads.empty() || pending == 0; });
+            }
+
+            processUploads(true);
+        }
+    }
+
+    void asset_manager::setUploadBudget(float milliseconds) {
+        uploadBudgetMs = milliseconds > 0.0f ? std::min(milliseconds, maxUploadBudgetMs) : 0.0f;
+    }
+
+    float asset_manager::getUploadBudget() const {
+        return uploadBudgetMs;
+    }
+
+    std::size_t asset_manager::getPendingCount() const {
+        return pending;
+    }
+
+    void asset_manager::enqueue(job work) {
+        ++pending;
+
+        {
+            std::lock_guard<std::mutex> lock(jobsMutex);
+
+            if (workers.empty()) {
+                for (uint32_t i = 0; i < threadCount; ++i) {
+                    workers.emplace_back(&asset_manager::workerLoop, this);
+                }
+            }
+
+            jobs.push_back(std::move(work));
+        }
+
+        jobsSignal.notify_one();
+    }
+
+    void asset_manager::pushUpload(upload finish) {
+        {
+            std::lock_guard<std::mutex> lock(uploadsMutex);
+            uploads.push_back(std::move(finish));
+        }
+
+        uploadsSignal.notify_all();
+    }
+
+    void asset_manager::workerLoop() {
+        ARTI_TRACE_THREAD("Asset worker");
+
+        std::unique_lock<std::mutex> lock(jobsMutex);
+
+        while (true) {
+            jobsSignal.wait(lock, [this] { return stopping || ! jobs.empty(); });
+
+            if (stopping) {
+                return;
+            }
+
+            auto work = std::move(jobs.front());
+            jobs.pop_front();
+
+            lock.unlock();
+            work();
+            lock.lock();
+        }
+    }
+
+    void asset_manager::stopWorkers() {
+        {
+            std::lock_guard<std::mutex> lock(jobsMutex);
+            stopping = true;
+            jobs.clear();
+        }
+
+        jobsSignal.notify_all();
+
+        for (auto& worker : workers) {
+            worker.join();
+        }
+        workers.clear();
+    }
+
+}
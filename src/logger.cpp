@@ -0,0 +1,380 @@
+//
+// Created by Alcachofa
+//
+
+#include <utils/logger.hpp>
+
+#include <array>
+#include <mutex>
+#include <chrono>
+#include <cstdio>
+#include <exception>
+#include <memory>
+#include <thread>
+#include <algorithm>
+#include <condition_variable>
+
+#include <utils/utils.hpp>
+
+namespace arti {
+
+    struct logger::async_state {
+        std::atomic<bool> enabled{ false };
+        overflow_policy policy = overflow_policy::Drop;
+
+        std::unique_ptr<record[]> ring;
+        uint64_t mask = 0;
+
+        // Kept apart, producers hammer the first and the writer the second
+        alignas(64) std::atomic<uint64_t> enqueuePos{ 0 };
+        alignas(64) std::atomic<uint64_t> dequeuePos{ 0 };
+        std::atomic<uint64_t> dropped{ 0 };
+        // Logging threads between acquire() and publish(), stop() waits for them
+        std::atomic<uint32_t> producers{ 0 };
+
+        std::thread writer;
+        std::atomic<bool> stopping{ false };
+        std::mutex wakeMutex;
+        std::condition_variable wake;
+        std::condition_variable written;
+
+        std::mutex sinkMutex;
+        bool console = true;
+        std::FILE* file = nullptr;
+
+        ~async_state() {
+            stop();
+
+            std::fflush(stdout);
+            if (file != nullptr) {
+                std::fclose(file);
+            }
+        }
+
+        // Drains the ring and joins the writer, false if it wasn't running
+        bool stop() {
+            if (! enabled.exchange(false)) {
+                return false;
+            }
+
+            // A producer that saw `enabled` still holds a slot, the writer has to see it
+            // published before draining stops and the ring goes away
+            while (producers.load() != 0) {
+                std::this_thread::yield();
+            }
+
+            stopping.store(true, std::memory_order_release);
+            wake.notify_one();
+            writer.join();
+
+            ring.reset();
+            return true;
+        }
+    };
+
+    namespace {
+
+        // Records written per batch, each batch is a single write per sink
+        constexpr std::size_t writeBatch = 256;
+
+        // The writer only sleeps this long when nothing wakes it, logging never does
+        constexpr auto writerIdle = std::chrono::milliseconds(5);
+
+        const std::string& coloredTag(uint8_t type) {
+            // In logger::level order
+            static const std::array<std::string, 5> tags = {
+                    fmt::format(fmt::fg(fmt::color::gray), "D"),
+                    fmt::format(fmt::fg(fmt::terminal_color::bright_blue), "I"),
+                    fmt::format(fmt::fg(fmt::terminal_color::yellow), "W"),
+                    fmt::format(fmt::fg(fmt::terminal_color::red), "E"),
+                    fmt::format(fmt::bg(fmt::terminal_color::red) | fmt::fg(fmt::terminal_color::white), "C")
+            };
+            return tags[type];
+        }
+
+        constexpr char plainTags[] = { 'D', 'I', 'W', 'E', 'C' };
+
+    }
+
+    bool logger::startAsync(std::size_t queueSize, overflow_policy policy) {
+        auto& s = state();
+
+        if (s.enabled.load(std::memory_order_acquire)) {
+            return false;
+        }
+
+        std::size_t size = 2;
+        while (size < queueSize) {
+            size <<= 1u;
+        }
+
+        s.ring = std::make_unique<record[]>(size);
+        for (std::size_t i = 0; i < size; ++i) {
+            s.ring[i].sequence.store(i, std::memory_order_relaxed);
+        }
+
+        s.mask = size - 1;
+        s.policy = policy;
+        s.enqueuePos.store(0, std::memory_order_relaxed);
+        s.dequeuePos.store(0, std::memory_order_relaxed);
+        s.stopping.store(false, std::memory_order_relaxed);
+
+        s.writer = std::thread([&s] {
+            fmt::memory_buffer consoleLines;
+            fmt::memory_buffer fileLines;
+            fmt::memory_buffer deferredBody;
+
+            for (;;) {
+                auto pos = s.dequeuePos.load(std::memory_order_relaxed);
+                std::size_t count = 0;
+
+                consoleLines.clear();
+                fileLines.clear();
+
+                {
+                    std::lock_guard<std::mutex> lock(s.sinkMutex);
+
+                    while (count < writeBatch) {
+                        auto& r = s.ring[pos & s.mask];
+
+                        if (r.sequence.load(std::memory_order_acquire) != pos + 1) {
+                            break;
+                        }
+
+                        std::string_view body(r.text, r.size);
+                        auto type = r.type;
+
+                        if ((type & deferredRecord) != 0) {
+                            decoder format;
+                            std::memcpy(&format, r.text, sizeof(decoder));
+
+                            deferredBody.clear();
+                            try {
+                                format(r.text + sizeof(decoder), deferredBody);
+                            }
+                            catch (const std::exception& e) {
+                                // Only runtime checks fail here, like a negative dynamic width
+                                deferredBody.clear();
+                                fmt::format_to(std::back_inserter(deferredBody), "<format error: {}>", e.what());
+                            }
+
+                            body = std::string_view(deferredBody.data(), deferredBody.size());
+                            type &= ~deferredRecord;
+                        }
+
+                        if (s.console) formatLine(consoleLines, type, body, true);
+                        if (s.file != nullptr) formatLine(fileLines, type, body, false);
+
+                        // Free again for the producer that wraps around to it
+                        r.sequence.store(pos + s.mask + 1, std::memory_order_release);
+                        ++pos;
+                        ++count;
+                    }
+
+                    writeLines(s, consoleLines, fileLines);
+                }
+
+                if (count != 0) {
+                    s.dequeuePos.store(pos, std::memory_order_release);
+                    s.written.notify_all();
+                    continue;
+                }
+
+                // Only stops once the ring is empty
+                if (s.stopping.load(std::memory_order_acquire)) {
+                    break;
+                }
+
+                std::unique_lock<std::mutex> lock(s.wakeMutex);
+                s.wake.wait_for(lock, writerIdle);
+            }
+        });
+
+        s.enabled.store(true, std::memory_order_release);
+        return true;
+    }
+
+    void logger::stopAsync() {
+        if (state().stop()) {
+            flush();
+        }
+    }
+
+    bool logger::isAsync() {
+        return state().enabled.load(std::memory_order_acquire);
+    }
+
+    void logger::flush() {
+        auto& s = state();
+
+        if (s.enabled.load(std::memory_order_acquire)) {
+            const auto target = s.enqueuePos.load(std::memory_order_acquire);
+
+            std::unique_lock<std::mutex> lock(s.wakeMutex);
+            while (s.dequeuePos.load(std::memory_order_acquire) < target) {
+                s.wake.notify_one();
+                s.written.wait_for(lock, std::chrono::milliseconds(1));
+            }
+        }
+
+        std::lock_guard<std::mutex> lock(s.sinkMutex);
+        std::fflush(stdout);
+        if (s.file != nullptr) {
+            std::fflush(s.file);
+        }
+    }
+
+    bool logger::setLogFile(std::string_view path) {
+        auto& s = state();
+        std::FILE* file = nullptr;
+
+        if (! path.empty()) {
+            file = std::fopen(std::string(path).c_str(), "w");
+
+            if (file == nullptr) {
+                logger::error("Couldn't open log file {}", path);
+                return false;
+            }
+        }
+
+        std::lock_guard<std::mutex> lock(s.sinkMutex);
+        if (s.file != nullptr) {
+            std::fclose(s.file);
+        }
+        s.file = file;
+
+        return true;
+    }
+
+    void logger::setConsoleOutput(bool enabled) {
+        auto& s = state();
+        std::lock_guard<std::mutex> lock(s.sinkMutex);
+        s.console = enabled;
+    }
+
+    uint64_t logger::getDroppedCount() {
+        return state().dropped.load(std::memory_order_relaxed);
+    }
+
+    logger::async_state& logger::state() {
+        static async_state instance;
+        return instance;
+    }
+
+    logger::record* logger::acquire(uint8_t type) {
+        auto& s = state();
+
+        // Registered before checking `enabled`, paired with stop() (both sequentially consistent)
+        s.producers.fetch_add(1);
+        if (! s.enabled.load()) {
+            s.producers.fetch_sub(1, std::memory_order_release);
+            return nullptr;
+        }
+
+        // Bounded MPMC queue (Vyukov), used with a single consumer: a slot is free for the
+        // producer at `pos` when its sequence equals pos, and readable when it's pos + 1
+        auto pos = s.enqueuePos.load(std::memory_order_relaxed);
+
+        for (;;) {
+            auto& r = s.ring[pos & s.mask];
+            const auto sequence = r.sequence.load(std::memory_order_acquire);
+            const auto diff = static_cast<int64_t>(sequence - pos);
+
+            if (diff == 0) {
+                if (s.enqueuePos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+                    r.type = type;
+                    return &r;
+                }
+            }
+            else if (diff < 0) {
+                // Full
+                if (s.policy == overflow_policy::Drop) {
+                    s.dropped.fetch_add(1, std::memory_order_relaxed);
+                    s.producers.fetch_sub(1, std::memory_order_release);
+                    return nullptr;
+                }
+
+                s.wake.notify_one();
+                std::this_thread::yield();
+                pos = s.enqueuePos.load(std::memory_order_relaxed);
+            }
+            else {
+                pos = s.enqueuePos.load(std::memory_order_relaxed);
+            }
+        }
+    }
+
+    void logger::publish(record* r, std::size_t size) {
+        r->size = to<uint8_t>(std::min(size, maxMessageSize));
+        r->sequence.store(r->sequence.load(std::memory_order_relaxed) + 1, std::memory_order_release);
+        state().producers.fetch_sub(1, std::memory_order_release);
+    }
+
+    void logger::vlog(uint8_t type, fmt::string_view format, fmt::format_args args) {
+        // Formatted before a slot is claimed, a throwing format must not leave one unpublished
+        fmt::memory_buffer body;
+        fmt::vformat_to(std::back_inserter(body), format, args);
+        submit(type, { body.data(), body.size() });
+    }
+
+    void logger::submit(uint8_t type, std::string_view body) {
+        if (auto* r = acquire(type)) {
+            const auto size = std::min(body.size(), maxMessageSize);
+            std::copy_n(body.data(), size, r->text);
+            publish(r, size);
+            return;
+        }
+
+        if (! isAsync()) {
+            write(type, body);
+        }
+    }
+
+    void logger::write(uint8_t type, std::string_view body) {
+        auto& s = state();
+
+        fmt::memory_buffer consoleLine;
+        fmt::memory_buffer fileLine;
+
+        std::lock_guard<std::mutex> lock(s.sinkMutex);
+        if (s.console) formatLine(consoleLine, type, body, true);
+        if (s.file != nullptr) formatLine(fileLine, type, body, false);
+        writeLines(s, consoleLine, fileLine);
+    }
+
+    void logger::formatLine(fmt::memory_buffer& out, uint8_t type, std::string_view body, bool colored) {
+        switch (type) {
+            case newlineRecord:
+                out.push_back('\n');
+                return;
+
+            case printRecord:
+                out.append(std::string_view("  > "));
+                break;
+
+            default:
+                if (colored) {
+                    out.append(coloredTag(type));
+                }
+                else {
+                    out.push_back(plainTags[type]);
+                }
+                out.append(std::string_view(" > "));
+                break;
+        }
+
+        out.append(body);
+        out.push_back('\n');
+    }
+
+    void logger::writeLines(async_state& s, const fmt::memory_buffer& consoleLines, const fmt::memory_buffer& fileLines) {
+        if (s.console && consoleLines.size() != 0) {
+            std::fwrite(consoleLines.data(), 1, consoleLines.size(), stdout);
+        }
+
+        if (s.file != nullptr && fileLines.size() != 0) {
+            std::fwrite(fileLines.data(), 1, fileLines.size(), s.file);
+        }
+    }
+
+}
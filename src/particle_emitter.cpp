@@ -0,0 +1,365 @@
+//
+// Created by Alcachofa
+//
+
+#include <particle_emitter.hpp>
+
+#include <cmath>
+#include <thread>
+#include <algorithm>
+
+#include <constants/math.hpp>
+
+#include <utils/utils.hpp>
+#include <utils/simd.hpp>
+#include <utils/random.hpp>
+#include <utils/trace.hpp>
+
+namespace arti {
+
+    namespace {
+
+        struct step_params {
+            float deltaTime;
+            float gravityX;
+            float gravityY;
+            // Velocity kept after this step's drag
+            float damping;
+        };
+
+        // v += g * dt, v *= damping, p += v * dt, age += dt. The SIMD kernels do the same
+        // operations in the same order, so every level gives the same particles
+
+        void stepScalar(float* x, float* y, float* vx, float* vy, float* age, std::size_t count, const step_params& p) {
+            for (std::size_t i = 0; i < count; ++i) {
+                vx[i] = (vx[i] + p.gravityX * p.deltaTime) * p.damping;
+                vy[i] = (vy[i] + p.gravityY * p.deltaTime) * p.damping;
+                x[i] += vx[i] * p.deltaTime;
+                y[i] += vy[i] * p.deltaTime;
+                age[i] += p.deltaTime;
+            }
+        }
+
+#ifdef ARTI_SIMD_SSE2
+        void stepSSE2(float* x, float* y, float* vx, float* vy, float* age, std::size_t count, const step_params& p) {
+            const auto dt = _mm_set1_ps(p.deltaTime);
+            const auto gx = _mm_set1_ps(p.gravityX * p.deltaTime);
+            const auto gy = _mm_set1_ps(p.gravityY * p.deltaTime);
+            const auto damping = _mm_set1_ps(p.damping);
+
+            std::size_t i = 0;
+            for (; i + 4 <= count; i += 4) {
+                auto velX = _mm_mul_ps(_mm_add_ps(_mm_loadu_ps(vx + i), gx), damping);
+                auto velY = _mm_mul_ps(_mm_add_ps(_mm_loadu_ps(vy + i), gy), damping);
+                _mm_storeu_ps(vx + i, velX);
+                _mm_storeu_ps(vy + i, velY);
+                _mm_storeu_ps(x + i, _mm_add_ps(_mm_loadu_ps(x + i), _mm_mul_ps(velX, dt)));
+                _mm_storeu_ps(y + i, _mm_add_ps(_mm_loadu_ps(y + i), _mm_mul_ps(velY, dt)));
+                _mm_storeu_ps(age + i, _mm_add_ps(_mm_loadu_ps(age + i), dt));
+            }
+
+            stepScalar(x + i, y + i, vx + i, vy + i, age + i, count - i, p);
+        }
+#endif
+
+#ifdef ARTI_SIMD_AVX2
+        ARTI_TARGET_AVX2 void stepAVX2(float* x, float* y, float* vx, float* vy, float* age, std::size_t count, const step_params& p) {
+            const auto dt = _mm256_set1_ps(p.deltaTime);
+            const auto gx = _mm256_set1_ps(p.gravityX * p.deltaTime);
+            const auto gy = _mm256_set1_ps(p.gravityY * p.deltaTime);
+            const auto damping = _mm256_set1_ps(p.damping);
+
+            std::size_t i = 0;
+            for (; i + 8 <= count; i += 8) {
+                auto velX = _mm256_mul_ps(_mm256_add_ps(_mm256_loadu_ps(vx + i), gx), damping);
+                auto velY = _mm256_mul_ps(_mm256_add_ps(_mm256_loadu_ps(vy + i), gy), damping);
+                _mm256_storeu_ps(vx + i, velX);
+                _mm256_storeu_ps(vy + i, velY);
+                _mm256_storeu_ps(x + i, _mm256_add_ps(_mm256_loadu_ps(x + i), _mm256_mul_ps(velX, dt)));
+                _mm256_storeu_ps(y + i, _mm256_add_ps(_mm256_loadu_ps(y + i), _mm256_mul_ps(velY, dt)));
+                _mm256_storeu_ps(age + i, _mm256_add_ps(_mm256_loadu_ps(age + i), dt));
+            }
+
+            stepScalar(x + i, y + i, vx + i, vy + i, age + i, count - i, p);
+        }
+#endif
+
+        void step(float* x, float* y, float* vx, float* vy, float* age, std::size_t count, const step_params& p) {
+            switch (simd::activeLevel()) {
+#ifdef ARTI_SIMD_AVX2
+                case simd::level::AVX2:
+                    stepAVX2(x, y, vx, vy, age, count, p);
+                    return;
+#endif
+#ifdef ARTI_SIMD_SSE2
+                case simd::level::SSE2:
+                    stepSSE2(x, y, vx, vy, age, count, p);
+                    return;
+#endif
+                default:
+                    stepScalar(x, y, vx, vy, age, count, p);
+                    return;
+            }
+        }
+
+        // First particle of `chunk` when `count` particles are split in `chunks`
+        std::size_t chunkBegin(std::size_t chunk, std::size_t chunks, std::size_t count) {
+            return count * chunk / chunks;
+        }
+
+        // Runs work(chunk, first, last) over `chunks` slices of [0, count) on `workers`
+        // and the calling thread
+        template <typename Work>
+        void parallelFor(worker_pool& workers, std::size_t chunks, std::size_t count, const Work& work) {
+            workers.run(chunks, [&](std::size_t chunk) {
+                work(chunk, chunkBegin(chunk, chunks, count), chunkBegin(chunk + 1, chunks, count));
+            });
+        }
+
+    }
+
+    particle_emitter::particle_emitter(std::size_t capacity)
+            : capacity(0),
+              count(0),
+              gravity(0.0f, 0.0f),
+              drag(0.0f),
+              particleSize(2.0f),
+              fadeOut(true),
+              layer(renderer::invalidLayer),
+              threadCount(1) {
+        setCapacity(capacity);
+    }
+
+    bool particle_emitter::spawn(const math::vec2df& position, const math::vec2df& velocity, float lifetime, const pixel& color) {
+        if (count == capacity) {
+            return false;
+        }
+
+        positionX[count] = position.x;
+        positionY[count] = position.y;
+        velocityX[count] = velocity.x;
+        velocityY[count] = velocity.y;
+        age[count] = 0.0f;
+        this->lifetime[count] = lifetime;
+        colors[count] = color;
+        ++count;
+        return true;
+    }
+
+    std::size_t particle_emitter::spawnBurst(std::size_t count, const math::vec2df& position, float minSpeed, float maxSpeed, float minLifetime, float maxLifetime, const pixel& color) {
+        const auto spawned = std::min(count, capacity - this->count);
+
+        for (std::size_t i = 0; i < spawned; ++i) {
+            auto angle = f_random<float>::GetUnder(2.0f * to<float>(math::PI));
+            auto speed = f_random<float>::GetRange(minSpeed, maxSpeed);
+            spawn(position, { std::cos(angle) * speed, std::sin(angle) * speed }, f_random<float>::GetRange(minLifetime, maxLifetime), color);
+        }
+
+        return spawned;
+    }
+
+    void particle_emitter::update(float deltaTime) {
+        ARTI_TRACE_SCOPE("particle_emitter::update");
+
+        const step_params params = {
+                deltaTime,
+                gravity.x,
+                gravity.y,
+                std::max(0.0f, 1.0f - drag * deltaTime)
+        };
+
+        parallelFor(workers, workersFor(count), count, [&](std::size_t, std::size_t first, std::size_t last) {
+            step(positionX.data() + first, positionY.data() + first, velocityX.data() + first, velocityY.data() + first, age.data() + first, last - first, params);
+        });
+
+        removeDead();
+    }
+
+    void particle_emitter::render(renderer& graphics) {
+        ARTI_TRACE_SCOPE("particle_emitter::render");
+
+        if (count == 0) {
+            return;
+        }
+
+        const auto previous = graphics.getTargetedLayer();
+        const bool switched = layer != renderer::invalidLayer && layer != previous && graphics.setTargetedLayer(layer);
+
+        const auto half = particleSize * 0.5f;
+        const auto area = graphics.getVisibleArea();
+        const math::vec2df min(area.left - half, area.top - half);
+        const math::vec2df max(area.left + area.width + half, area.top + area.height + half);
+
+        if (vertices.size() < 6 * count) {
+            vertices.resize(6 * count);
+        }
+
+        // Every chunk writes where its first particle would go, then they're packed together
+        std::vector<std::size_t> written(workersFor(count));
+        parallelFor(workers, written.size(), count, [&](std::size_t chunk, std::size_t first, std::size_t last) {
+            written[chunk] = writeVertices(first, last, vertices.data() + 6 * first, min, max);
+        });
+
+        std::size_t total = written[0];
+        for (std::size_t chunk = 1; chunk < written.size(); ++chunk) {
+            const auto* source = vertices.data() + 6 * chunkBegin(chunk, written.size(), count);
+            if (source != vertices.data() + total) {
+                std::copy(source, source + written[chunk], vertices.data() + total);
+            }
+            total += written[chunk];
+        }
+
+        graphics.renderVertices(span<const sf::Vertex>(vertices.data(), total));
+
+        if (switched) {
+            graphics.setTargetedLayer(previous);
+        }
+    }
+
+    void particle_emitter::clear() {
+        count = 0;
+    }
+
+    std::size_t particle_emitter::size() const {
+        return count;
+    }
+
+    void particle_emitter::setCapacity(std::size_t capacity) {
+        this->capacity = capacity;
+        count = std::min(count, capacity);
+
+        positionX.resize(capacity);
+        positionY.resize(capacity);
+        velocityX.resize(capacity);
+        velocityY.resize(capacity);
+        age.resize(capacity);
+        lifetime.resize(capacity);
+        colors.resize(capacity);
+
+        if (vertices.size() > 6 * capacity) {
+            vertices.resize(6 * capacity);
+            vertices.shrink_to_fit();
+        }
+    }
+
+    std::size_t particle_emitter::getCapacity() const {
+        return capacity;
+    }
+
+    void particle_emitter::setGravity(const math::vec2df& gravity) {
+        this->gravity = gravity;
+    }
+
+    math::vec2df particle_emitter::getGravity() const {
+        return gravity;
+    }
+
+    void particle_emitter::setDrag(float drag) {
+        this->drag = std::max(drag, 0.0f);
+    }
+
+    float particle_emitter::getDrag() const {
+        return drag;
+    }
+
+    void particle_emitter::setParticleSize(float size) {
+        particleSize = std::max(size, 0.0f);
+    }
+
+    float particle_emitter::getParticleSize() const {
+        return particleSize;
+    }
+
+    void particle_emitter::setFadeOut(bool enabled) {
+        fadeOut = enabled;
+    }
+
+    bool particle_emitter::isFadingOut() const {
+        return fadeOut;
+    }
+
+    void particle_emitter::setLayer(renderer::layer_id id) {
+        layer = id;
+    }
+
+    renderer::layer_id particle_emitter::getLayer() const {
+        return layer;
+    }
+
+    void particle_emitter::setThreadCount(uint32_t threads) {
+        if (threads == 0) {
+            threads = std::max(std::thread::hardware_concurrency(), 1u);
+        }
+        threadCount = threads;
+        workers.setWorkerCount(threads - 1);
+    }
+
+    uint32_t particle_emitter::getThreadCount() const {
+        return threadCount;
+    }
+
+    std::size_t particle_emitter::workersFor(std::size_t particles) const {
+        return std::max<std::size_t>(std::min<std::size_t>(threadCount, particles / minParticlesPerThread), 1);
+    }
+
+    std::size_t particle_emitter::writeVertices(std::size_t first, std::size_t last, sf::Vertex* out, const math::vec2df& min, const math::vec2df& max) const {
+        const auto half = particleSize * 0.5f;
+        const auto* begin = out;
+
+        for (std::size_t i = first; i < last; ++i) {
+            const auto x = positionX[i];
+            const auto y = positionY[i];
+
+            if (x < min.x || x > max.x || y < min.y || y > max.y) {
+                continue;
+            }
+
+            const auto& p = colors[i];
+            sf::Color color(p.r, p.g, p.b, p.a);
+            if (fadeOut) {
+                color.a = to<uint8_t>(to<float>(p.a) * std::max(0.0f, 1.0f - age[i] / lifetime[i]));
+            }
+
+            const sf::Vector2f topLeft(x - half, y - half);
+            const sf::Vector2f topRight(x + half, y - half);
+            const sf::Vector2f bottomRight(x + half, y + half);
+            const sf::Vector2f bottomLeft(x - half, y + half);
+
+            out[0].position = topLeft;
+            out[1].position = topRight;
+            out[2].position = bottomRight;
+            out[3].position = topLeft;
+            out[4].position = bottomRight;
+            out[5].position = bottomLeft;
+
+            for (int v = 0; v < 6; ++v) {
+                out[v].color = color;
+            }
+
+            out += 6;
+        }
+
+        return to<std::size_t>(out - begin);
+    }
+
+    void particle_emitter::removeDead() {
+        std::size_t i = 0;
+
+        while (i < count) {
+            if (age[i] < lifetime[i]) {
+                ++i;
+                continue;
+            }
+
+            --count;
+            positionX[i] = positionX[count];
+            positionY[i] = positionY[count];
+            velocityX[i] = velocityX[count];
+            velocityY[i] = velocityY[count];
+            age[i] = age[count];
+            lifetime[i] = lifetime[count];
+            colors[i] = colors[count];
+        }
+    }
+
+}
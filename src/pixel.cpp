@@ -109,4 +109,21 @@ namespace arti {
     pixel pixelLerp(const pixel &p1, const pixel &p2, float t) {
         return (p2 * t) + p1 * (1.0f - t);
     }
+
+    pixel pixelBlend(const pixel &under, const pixel &over) {
+        // x / 255 rounded, exact for x <= 255 * 255, the SIMD span kernels use the same trick
+        auto div255 = [](uint32_t x) {
+            x += 128;
+            return uint8_t((x + (x >> 8)) >> 8);
+        };
+
+        uint32_t alpha = over.a;
+        uint32_t rest = 255 - alpha;
+        return {
+            div255(over.r * alpha + under.r * rest),
+            div255(over.g * alpha + under.g * rest),
+            div255(over.b * alpha + under.b * rest),
+            div255(255 * alpha + under.a * rest)
+        };
+    }
 }
\ No newline at end of file
@@ -0,0 +1,268 @@
+//
+// Created by Alcachofa
+//
+
+#include <pixel_buffer.hpp>
+
+#include <limits>
+
+#include <pixel_ops.hpp>
+
+#include <utils/logger.hpp>
+
+namespace arti {
+
+    namespace {
+
+        constexpr int32_t cleanLeft = std::numeric_limits<int32_t>::max();
+        constexpr int32_t cleanRight = std::numeric_limits<int32_t>::min();
+
+    }
+
+    pixel_buffer::pixel_buffer()
+            : size(0, 0),
+              dirtyTop(0),
+              dirtyBottom(0) {}
+
+    bool pixel_buffer::create(const math::vec2di& newSize, const pixel& color) {
+        if (newSize.x <= 0 || newSize.y <= 0) {
+            logger::error("Couldn't create pixel buffer of size {}", newSize.to_string());
+            return false;
+        }
+
+        if (! texture.create(to<uint32_t>(newSize.x), to<uint32_t>(newSize.y))) {
+            logger::error("Couldn't create the {} texture of a pixel buffer", newSize.to_string());
+            return false;
+        }
+
+        size = newSize;
+        pixels.assign(to<std::size_t>(size.x) * size.y, color);
+
+        dirtyLeft.assign(size.y, cleanLeft);
+        dirtyRight.assign(size.y, cleanRight);
+        dirtyTop = size.y;
+        dirtyBottom = 0;
+
+        markAllDirty();
+        return true;
+    }
+
+    math::vec2di pixel_buffer::getSize() const {
+        return size;
+    }
+
+    int32_t pixel_buffer::getWidth() const {
+        return size.x;
+    }
+
+    int32_t pixel_buffer::getHeight() const {
+        return size.y;
+    }
+
+    pixel* pixel_buffer::data() {
+        return pixels.data();
+    }
+
+    const pixel* pixel_buffer::data() const {
+        return pixels.data();
+    }
+
+    span<pixel> pixel_buffer::row(int32_t y) {
+        if (y < 0 || y >= size.y) {
+            return {};
+        }
+        return { pixels.data() + to<std::size_t>(y) * size.x, to<std::size_t>(size.x) };
+    }
+
+    void pixel_buffer::fillSpan(int32_t x, int32_t y, int32_t length, const pixel& color) {
+        if (y < 0 || y >= size.y) {
+            return;
+        }
+
+        auto left = std::max(x, 0);
+        auto right = std::min(x + length, size.x);
+        if (right <= left) {
+            return;
+        }
+
+        std::fill_n(pixels.data() + to<std::size_t>(y) * size.x + left, right - left, color);
+        markRow(y, left, right);
+    }
+
+    void pixel_buffer::fillRect(const sf::IntRect& area, const pixel& color) {
+        auto top = std::max(area.top, 0);
+        auto bottom = std::min(area.top + area.height, size.y);
+
+        for (auto y = top; y < bottom; ++y) {
+            fillSpan(area.left, y, area.width, color);
+        }
+    }
+
+    void pixel_buffer::fill(const pixel& color) {
+        std::fill(pixels.begin(), pixels.end(), color);
+        markAllDirty();
+    }
+
+    void pixel_buffer::blit(const pixel_buffer& source, const sf::IntRect& area, const math::vec2di& position, bool alphaBlend) {
+        // Clip against the source first and shift the destination by whatever was cut
+        auto left = std::max(area.left, 0);
+        auto top = std::max(area.top, 0);
+        auto right = std::min(area.left + area.width, source.size.x);
+        auto bottom = std::min(area.top + area.height, source.size.y);
+
+        if (right <= left || bottom <= top) {
+            return;
+        }
+
+        const pixel* first = source.pixels.data() + to<std::size_t>(top) * source.size.x + left;
+        auto stride = source.size.x;
+
+        // Overlapping rows would be read after being written, work from a copy
+        std::vector<pixel> copy;
+        if (&source == this) {
+            copy.reserve(to<std::size_t>(right - left) * (bottom - top));
+            for (auto y = 0; y < bottom - top; ++y) {
+                copy.insert(copy.end(), first + to<std::size_t>(y) * stride, first + to<std::size_t>(y) * stride + (right - left));
+            }
+            first = copy.data();
+            stride = right - left;
+        }
+
+        blitRows(first, stride, { right - left, bottom - top }, position + math::vec2di{ left - area.left, top - area.top }, alphaBlend);
+    }
+
+    void pixel_buffer::blit(span<const pixel> source, int32_t width, const math::vec2di& position, bool alphaBlend) {
+        if (width <= 0) {
+            return;
+        }
+
+        auto height = to<int32_t>(source.size() / to<std::size_t>(width));
+        blitRows(source.data(), width, { width, height }, position, alphaBlend);
+    }
+
+    void pixel_buffer::blitRows(const pixel* source, int32_t stride, const math::vec2di& extent, const math::vec2di& position, bool alphaBlend) {
+        auto left = std::max(position.x, 0);
+        auto top = std::max(position.y, 0);
+        auto right = std::min(position.x + extent.x, size.x);
+        auto bottom = std::min(position.y + extent.y, size.y);
+
+        if (right <= left || bottom <= top) {
+            return;
+        }
+
+        auto width = to<std::size_t>(right - left);
+        for (auto y = top; y < bottom; ++y) {
+            const pixel* from = source + to<std::size_t>(y - position.y) * stride + (left - position.x);
+            pixel* into = pixels.data() + to<std::size_t>(y) * size.x + left;
+
+            if (alphaBlend) {
+                pixel_ops::blend({ into, width }, { from, width });
+            }
+            else {
+                std::copy_n(from, width, into);
+            }
+
+            markRow(y, left, right);
+        }
+    }
+
+    void pixel_buffer::markDirty(const sf::IntRect& area) {
+        auto left = std::max(area.left, 0);
+        auto right = std::min(area.left + area.width, size.x);
+        auto top = std::max(area.top, 0);
+        auto bottom = std::min(area.top + area.height, size.y);
+
+        if (right <= left) {
+            return;
+        }
+
+        for (auto y = top; y < bottom; ++y) {
+            markRow(y, left, right);
+        }
+    }
+
+    void pixel_buffer::markAllDirty() {
+        markDirty({ 0, 0, size.x, size.y });
+    }
+
+    bool pixel_buffer::isDirty() const {
+        return dirtyTop < dirtyBottom;
+    }
+
+    std::size_t pixel_buffer::upload() {
+        if (! isDirty()) {
+            return 0;
+        }
+
+        bands.clear();
+
+        int32_t gap = 0;
+        for (auto y = dirtyTop; y < dirtyBottom; ++y) {
+            if (dirtyRight[y] == cleanRight) {
+                ++gap;
+                continue;
+            }
+
+            if (bands.empty() || gap > bandMergeGap) {
+                bands.push_back({ y, y + 1, dirtyLeft[y], dirtyRight[y] });
+            }
+            else {
+                auto& last = bands.back();
+                last.bottom = y + 1;
+                last.left = std::min(last.left, dirtyLeft[y]);
+                last.right = std::max(last.right, dirtyRight[y]);
+            }
+
+            gap = 0;
+            dirtyLeft[y] = cleanLeft;
+            dirtyRight[y] = cleanRight;
+        }
+
+        dirtyTop = size.y;
+        dirtyBottom = 0;
+
+        if (bands.size() > maxUploadsPerFrame) {
+            band bounds = bands.front();
+            for (const auto& b : bands) {
+                bounds.left = std::min(bounds.left, b.left);
+                bounds.right = std::max(bounds.right, b.right);
+            }
+            bounds.bottom = bands.back().bottom;
+
+            bands.assign(1, bounds);
+        }
+
+        for (const auto& b : bands) {
+            uploadBand(b);
+        }
+
+        return bands.size();
+    }
+
+    void pixel_buffer::uploadBand(const band& area) {
+        auto height = to<std::size_t>(area.bottom - area.top);
+
+        // Rows are contiguous when the band spans the whole width, and uploading a few
+        // extra columns is cheaper than repacking anything wider than half the buffer
+        if ((area.right - area.left) * 2 >= size.x) {
+            texture.update(reinterpret_cast<const sf::Uint8*>(pixels.data() + to<std::size_t>(area.top) * size.x),
+                           to<uint32_t>(size.x), to<uint32_t>(height), 0, to<uint32_t>(area.top));
+            return;
+        }
+
+        auto width = to<std::size_t>(area.right - area.left);
+        uploadScratch.resize(width * height);
+        for (std::size_t y = 0; y < height; ++y) {
+            auto from = pixels.data() + (area.top + y) * size.x + area.left;
+            std::copy_n(from, width, uploadScratch.data() + y * width);
+        }
+
+        texture.update(reinterpret_cast<const sf::Uint8*>(uploadScratch.data()),
+                       to<uint32_t>(width), to<uint32_t>(height), to<uint32_t>(area.left), to<uint32_t>(area.top));
+    }
+
+    const sf::Texture& pixel_buffer::getTexture() const {
+        return texture;
+    }
+
+}
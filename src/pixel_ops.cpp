@@ -0,0 +1,465 @@
+//
+// Created by Alcachofa
+//
+
+#include <pixel_ops.hpp>
+
+#include <algorithm>
+
+#include <utils/simd.hpp>
+
+namespace arti::pixel_ops {
+
+    namespace {
+
+        static_assert(sizeof(pixel) == 4, "pixel_ops reads pixels as packed RGBA8");
+
+        struct kernel_table {
+            void (*scale)(pixel*, std::size_t, float);
+            void (*divide)(pixel*, std::size_t, float);
+            void (*add)(pixel*, const pixel*, std::size_t);
+            void (*sub)(pixel*, const pixel*, std::size_t);
+            void (*lerp)(pixel*, const pixel*, std::size_t, float);
+            void (*inv)(pixel*, std::size_t);
+            void (*blend)(pixel*, const pixel*, std::size_t);
+            void (*blendColor)(pixel*, std::size_t, pixel);
+        };
+
+        // Scalar kernels, also used for the tails of the SIMD ones
+
+        void scaleScalar(pixel* pixels, std::size_t count, float factor) {
+            for (std::size_t i = 0; i < count; ++i) {
+                pixels[i] *= factor;
+            }
+        }
+
+        void divideScalar(pixel* pixels, std::size_t count, float divisor) {
+            for (std::size_t i = 0; i < count; ++i) {
+                pixels[i] /= divisor;
+            }
+        }
+
+        void addScalar(pixel* dst, const pixel* src, std::size_t count) {
+            for (std::size_t i = 0; i < count; ++i) {
+                dst[i] += src[i];
+            }
+        }
+
+        void subScalar(pixel* dst, const pixel* src, std::size_t count) {
+            for (std::size_t i = 0; i < count; ++i) {
+                dst[i] -= src[i];
+            }
+        }
+
+        void lerpScalar(pixel* dst, const pixel* target, std::size_t count, float t) {
+            for (std::size_t i = 0; i < count; ++i) {
+                dst[i] = pixelLerp(dst[i], target[i], t);
+            }
+        }
+
+        void invScalar(pixel* pixels, std::size_t count) {
+            for (std::size_t i = 0; i < count; ++i) {
+                pixels[i] = pixels[i].inv();
+            }
+        }
+
+        void blendScalar(pixel* dst, const pixel* src, std::size_t count) {
+            for (std::size_t i = 0; i < count; ++i) {
+                dst[i] = pixelBlend(dst[i], src[i]);
+            }
+        }
+
+        void blendColorScalar(pixel* dst, std::size_t count, pixel color) {
+            for (std::size_t i = 0; i < count; ++i) {
+                dst[i] = pixelBlend(dst[i], color);
+            }
+        }
+
+        constexpr kernel_table scalarKernels = {
+                scaleScalar,
+                divideScalar,
+                addScalar,
+                subScalar,
+                lerpScalar,
+                invScalar,
+                blendScalar,
+                blendColorScalar
+        };
+
+#ifdef ARTI_SIMD_SSE2
+        // Channels go through float like the scalar operators do: alpha is scaled by 1,
+        // NaN turns into 0 (as std::max(0.0f, NaN) does) and truncation matches uint8_t(float)
+        template <bool Divide>
+        inline __m128i scaleChannels(__m128i px, __m128 factor) {
+            const auto zero = _mm_setzero_si128();
+            const auto lower = _mm_setzero_ps();
+            const auto upper = _mm_set1_ps(255.0f);
+
+            auto apply = [&](__m128i channels) {
+                auto f = _mm_cvtepi32_ps(channels);
+                f = Divide ? _mm_div_ps(f, factor) : _mm_mul_ps(f, factor);
+                return _mm_cvttps_epi32(_mm_min_ps(_mm_max_ps(f, lower), upper));
+            };
+
+            auto lo = _mm_unpacklo_epi8(px, zero);
+            auto hi = _mm_unpackhi_epi8(px, zero);
+
+            auto rlo = _mm_packs_epi32(apply(_mm_unpacklo_epi16(lo, zero)), apply(_mm_unpackhi_epi16(lo, zero)));
+            auto rhi = _mm_packs_epi32(apply(_mm_unpacklo_epi16(hi, zero)), apply(_mm_unpackhi_epi16(hi, zero)));
+
+            return _mm_packus_epi16(rlo, rhi);
+        }
+
+        // Blends two pixels held as 16 bit channels, see pixelBlend
+        inline __m128i blendChannels(__m128i under, __m128i over) {
+            auto alpha = _mm_shufflehi_epi16(_mm_shufflelo_epi16(over, _MM_SHUFFLE(3, 3, 3, 3)), _MM_SHUFFLE(3, 3, 3, 3));
+            auto rest = _mm_sub_epi16(_mm_set1_epi16(255), alpha);
+            // The result alpha is over.a + under.a * rest / 255, the colour formula with over.a = 255
+            over = _mm_or_si128(over, _mm_set_epi16(255, 0, 0, 0, 255, 0, 0, 0));
+
+            auto x = _mm_add_epi16(_mm_mullo_epi16(over, alpha), _mm_mullo_epi16(under, rest));
+            x = _mm_add_epi16(x, _mm_set1_epi16(128));
+            return _mm_srli_epi16(_mm_add_epi16(x, _mm_srli_epi16(x, 8)), 8);
+        }
+
+        void scaleSSE2(pixel* pixels, std::size_t count, float factor) {
+            const auto f = _mm_set_ps(1.0f, factor, factor, factor);
+            auto raw = reinterpret_cast<__m128i*>(pixels);
+
+            std::size_t i = 0;
+            for (; i + 4 <= count; i += 4, ++raw) {
+                _mm_storeu_si128(raw, scaleChannels<false>(_mm_loadu_si128(raw), f));
+            }
+            scaleScalar(pixels + i, count - i, factor);
+        }
+
+        void divideSSE2(pixel* pixels, std::size_t count, float divisor) {
+            const auto f = _mm_set_ps(1.0f, divisor, divisor, divisor);
+            auto raw = reinterpret_cast<__m128i*>(pixels);
+
+            std::size_t i = 0;
+            for (; i + 4 <= count; i += 4, ++raw) {
+                _mm_storeu_si128(raw, scaleChannels<true>(_mm_loadu_si128(raw), f));
+            }
+            divideScalar(pixels + i, count - i, divisor);
+        }
+
+        void addSSE2(pixel* dst, const pixel* src, std::size_t count) {
+            const auto alpha = _mm_set1_epi32(int(0xFF000000u));
+            auto out = reinterpret_cast<__m128i*>(dst);
+            auto in = reinterpret_cast<const __m128i*>(src);
+
+            std::size_t i = 0;
+            for (; i + 4 <= count; i += 4, ++out, ++in) {
+                auto d = _mm_loadu_si128(out);
+                auto sum = _mm_adds_epu8(d, _mm_loadu_si128(in));
+                _mm_storeu_si128(out, _mm_or_si128(_mm_andnot_si128(alpha, sum), _mm_and_si128(alpha, d)));
+            }
+            addScalar(dst + i, src + i, count - i);
+        }
+
+        void subSSE2(pixel* dst, const pixel* src, std::size_t count) {
+            const auto alpha = _mm_set1_epi32(int(0xFF000000u));
+            auto out = reinterpret_cast<__m128i*>(dst);
+            auto in = reinterpret_cast<const __m128i*>(src);
+
+            std::size_t i = 0;
+            for (; i + 4 <= count; i += 4, ++out, ++in) {
+                auto d = _mm_loadu_si128(out);
+                auto diff = _mm_subs_epu8(d, _mm_loadu_si128(in));
+                _mm_storeu_si128(out, _mm_or_si128(_mm_andnot_si128(alpha, diff), _mm_and_si128(alpha, d)));
+            }
+            subScalar(dst + i, src + i, count - i);
+        }
+
+        void lerpSSE2(pixel* dst, const pixel* target, std::size_t count, float t) {
+            const auto alpha = _mm_set1_epi32(int(0xFF000000u));
+            const auto keep = 1.0f - t;
+            const auto fTarget = _mm_set_ps(1.0f, t, t, t);
+            const auto fKeep = _mm_set_ps(1.0f, keep, keep, keep);
+            auto out = reinterpret_cast<__m128i*>(dst);
+            auto in = reinterpret_cast<const __m128i*>(target);
+
+            std::size_t i = 0;
+            for (; i + 4 <= count; i += 4, ++out, ++in) {
+                auto to = _mm_loadu_si128(in);
+                auto sum = _mm_adds_epu8(scaleChannels<false>(to, fTarget), scaleChannels<false>(_mm_loadu_si128(out), fKeep));
+                _mm_storeu_si128(out, _mm_or_si128(_mm_andnot_si128(alpha, sum), _mm_and_si128(alpha, to)));
+            }
+            lerpScalar(dst + i, target + i, count - i, t);
+        }
+
+        void invSSE2(pixel* pixels, std::size_t count) {
+            const auto rgb = _mm_set1_epi32(0x00FFFFFF);
+            auto raw = reinterpret_cast<__m128i*>(pixels);
+
+            std::size_t i = 0;
+            for (; i + 4 <= count; i += 4, ++raw) {
+                _mm_storeu_si128(raw, _mm_xor_si128(_mm_loadu_si128(raw), rgb));
+            }
+            invScalar(pixels + i, count - i);
+        }
+
+        void blendSSE2(pixel* dst, const pixel* src, std::size_t count) {
+            const auto zero = _mm_setzero_si128();
+            auto out = reinterpret_cast<__m128i*>(dst);
+            auto in = reinterpret_cast<const __m128i*>(src);
+
+            std::size_t i = 0;
+            for (; i + 4 <= count; i += 4, ++out, ++in) {
+                auto d = _mm_loadu_si128(out);
+                auto s = _mm_loadu_si128(in);
+                auto lo = blendChannels(_mm_unpacklo_epi8(d, zero), _mm_unpacklo_epi8(s, zero));
+                auto hi = blendChannels(_mm_unpackhi_epi8(d, zero), _mm_unpackhi_epi8(s, zero));
+                _mm_storeu_si128(out, _mm_packus_epi16(lo, hi));
+            }
+            blendScalar(dst + i, src + i, count - i);
+        }
+
+        void blendColorSSE2(pixel* dst, std::size_t count, pixel color) {
+            const auto zero = _mm_setzero_si128();
+            // blendChannels with the colour side folded into constants
+            const auto over = _mm_unpacklo_epi8(_mm_set1_epi32(int(color.n | 0xFF000000u)), zero);
+            const auto alpha = _mm_set1_epi16(int16_t(color.a));
+            const auto rest = _mm_set1_epi16(int16_t(255 - color.a));
+            const auto overTerm = _mm_add_epi16(_mm_mullo_epi16(over, alpha), _mm_set1_epi16(128));
+
+            auto apply = [&](__m128i under) {
+                auto x = _mm_add_epi16(overTerm, _mm_mullo_epi16(under, rest));
+                return _mm_srli_epi16(_mm_add_epi16(x, _mm_srli_epi16(x, 8)), 8);
+            };
+
+            auto out = reinterpret_cast<__m128i*>(dst);
+
+            std::size_t i = 0;
+            for (; i + 4 <= count; i += 4, ++out) {
+                auto d = _mm_loadu_si128(out);
+                _mm_storeu_si128(out, _mm_packus_epi16(apply(_mm_unpacklo_epi8(d, zero)), apply(_mm_unpackhi_epi8(d, zero))));
+            }
+            blendColorScalar(dst + i, count - i, color);
+        }
+
+        constexpr kernel_table sse2Kernels = {
+                scaleSSE2,
+                divideSSE2,
+                addSSE2,
+                subSSE2,
+                lerpSSE2,
+                invSSE2,
+                blendSSE2,
+                blendColorSSE2
+        };
+#endif
+
+#ifdef ARTI_SIMD_AVX2
+        // Same as the SSE2 helpers on 8 pixels. Unpacks and packs work inside each
+        // 128 bit half, so pixels come back in their original order
+        template <bool Divide>
+        ARTI_TARGET_AVX2 inline __m256i scaleChannels8(__m256i px, __m256 factor) {
+            const auto zero = _mm256_setzero_si256();
+            const auto lower = _mm256_setzero_ps();
+            const auto upper = _mm256_set1_ps(255.0f);
+
+            __m256i parts[4] = {
+                    _mm256_unpacklo_epi16(_mm256_unpacklo_epi8(px, zero), zero),
+                    _mm256_unpackhi_epi16(_mm256_unpacklo_epi8(px, zero), zero),
+                    _mm256_unpacklo_epi16(_mm256_unpackhi_epi8(px, zero), zero),
+                    _mm256_unpackhi_epi16(_mm256_unpackhi_epi8(px, zero), zero)
+            };
+
+            for (auto& part : parts) {
+                auto f = _mm256_cvtepi32_ps(part);
+                f = Divide ? _mm256_div_ps(f, factor) : _mm256_mul_ps(f, factor);
+                part = _mm256_cvttps_epi32(_mm256_min_ps(_mm256_max_ps(f, lower), upper));
+            }
+
+            return _mm256_packus_epi16(_mm256_packs_epi32(parts[0], parts[1]), _mm256_packs_epi32(parts[2], parts[3]));
+        }
+
+        ARTI_TARGET_AVX2 inline __m256i blendChannels8(__m256i under, __m256i over) {
+            auto alpha = _mm256_shufflehi_epi16(_mm256_shufflelo_epi16(over, _MM_SHUFFLE(3, 3, 3, 3)), _MM_SHUFFLE(3, 3, 3, 3));
+            auto rest = _mm256_sub_epi16(_mm256_set1_epi16(255), alpha);
+            over = _mm256_or_si256(over, _mm256_set1_epi64x(int64_t(0x00FF000000000000ull)));
+
+            auto x = _mm256_add_epi16(_mm256_mullo_epi16(over, alpha), _mm256_mullo_epi16(under, rest));
+            x = _mm256_add_epi16(x, _mm256_set1_epi16(128));
+            return _mm256_srli_epi16(_mm256_add_epi16(x, _mm256_srli_epi16(x, 8)), 8);
+        }
+
+        ARTI_TARGET_AVX2 void scaleAVX2(pixel* pixels, std::size_t count, float factor) {
+            const auto f = _mm256_set_ps(1.0f, factor, factor, factor, 1.0f, factor, factor, factor);
+            auto raw = reinterpret_cast<__m256i*>(pixels);
+
+            std::size_t i = 0;
+            for (; i + 8 <= count; i += 8, ++raw) {
+                _mm256_storeu_si256(raw, scaleChannels8<false>(_mm256_loadu_si256(raw), f));
+            }
+            scaleScalar(pixels + i, count - i, factor);
+        }
+
+        ARTI_TARGET_AVX2 void divideAVX2(pixel* pixels, std::size_t count, float divisor) {
+            const auto f = _mm256_set_ps(1.0f, divisor, divisor, divisor, 1.0f, divisor, divisor, divisor);
+            auto raw = reinterpret_cast<__m256i*>(pixels);
+
+            std::size_t i = 0;
+            for (; i + 8 <= count; i += 8, ++raw) {
+                _mm256_storeu_si256(raw, scaleChannels8<true>(_mm256_loadu_si256(raw), f));
+            }
+            divideScalar(pixels + i, count - i, divisor);
+        }
+
+        ARTI_TARGET_AVX2 void addAVX2(pixel* dst, const pixel* src, std::size_t count) {
+            const auto alpha = _mm256_set1_epi32(int(0xFF000000u));
+            auto out = reinterpret_cast<__m256i*>(dst);
+            auto in = reinterpret_cast<const __m256i*>(src);
+
+            std::size_t i = 0;
+            for (; i + 8 <= count; i += 8, ++out, ++in) {
+                auto d = _mm256_loadu_si256(out);
+                auto sum = _mm256_adds_epu8(d, _mm256_loadu_si256(in));
+                _mm256_storeu_si256(out, _mm256_blendv_epi8(sum, d, alpha));
+            }
+            addScalar(dst + i, src + i, count - i);
+        }
+
+        ARTI_TARGET_AVX2 void subAVX2(pixel* dst, const pixel* src, std::size_t count) {
+            const auto alpha = _mm256_set1_epi32(int(0xFF000000u));
+            auto out = reinterpret_cast<__m256i*>(dst);
+            auto in = reinterpret_cast<const __m256i*>(src);
+
+            std::size_t i = 0;
+            for (; i + 8 <= count; i += 8, ++out, ++in) {
+                auto d = _mm256_loadu_si256(out);
+                auto diff = _mm256_subs_epu8(d, _mm256_loadu_si256(in));
+                _mm256_storeu_si256(out, _mm256_blendv_epi8(diff, d, alpha));
+            }
+            subScalar(dst + i, src + i, count - i);
+        }
+
+        ARTI_TARGET_AVX2 void lerpAVX2(pixel* dst, const pixel* target, std::size_t count, float t) {
+            const auto alpha = _mm256_set1_epi32(int(0xFF000000u));
+            const auto keep = 1.0f - t;
+            const auto fTarget = _mm256_set_ps(1.0f, t, t, t, 1.0f, t, t, t);
+            const auto fKeep = _mm256_set_ps(1.0f, keep, keep, keep, 1.0f, keep, keep, keep);
+            auto out = reinterpret_cast<__m256i*>(dst);
+            auto in = reinterpret_cast<const __m256i*>(target);
+
+            std::size_t i = 0;
+            for (; i + 8 <= count; i += 8, ++out, ++in) {
+                auto to = _mm256_loadu_si256(in);
+                auto sum = _mm256_adds_epu8(scaleChannels8<false>(to, fTarget), scaleChannels8<false>(_mm256_loadu_si256(out), fKeep));
+                _mm256_storeu_si256(out, _mm256_blendv_epi8(sum, to, alpha));
+            }
+            lerpScalar(dst + i, target + i, count - i, t);
+        }
+
+        ARTI_TARGET_AVX2 void invAVX2(pixel* pixels, std::size_t count) {
+            const auto rgb = _mm256_set1_epi32(0x00FFFFFF);
+            auto raw = reinterpret_cast<__m256i*>(pixels);
+
+            std::size_t i = 0;
+            for (; i + 8 <= count; i += 8, ++raw) {
+                _mm256_storeu_si256(raw, _mm256_xor_si256(_mm256_loadu_si256(raw), rgb));
+            }
+            invScalar(pixels + i, count - i);
+        }
+
+        ARTI_TARGET_AVX2 void blendAVX2(pixel* dst, const pixel* src, std::size_t count) {
+            const auto zero = _mm256_setzero_si256();
+            auto out = reinterpret_cast<__m256i*>(dst);
+            auto in = reinterpret_cast<const __m256i*>(src);
+
+            std::size_t i = 0;
+            for (; i + 8 <= count; i += 8, ++out, ++in) {
+                auto d = _mm256_loadu_si256(out);
+                auto s = _mm256_loadu_si256(in);
+                auto lo = blendChannels8(_mm256_unpacklo_epi8(d, zero), _mm256_unpacklo_epi8(s, zero));
+                auto hi = blendChannels8(_mm256_unpackhi_epi8(d, zero), _mm256_unpackhi_epi8(s, zero));
+                _mm256_storeu_si256(out, _mm256_packus_epi16(lo, hi));
+            }
+            blendScalar(dst + i, src + i, count - i);
+        }
+
+        ARTI_TARGET_AVX2 void blendColorAVX2(pixel* dst, std::size_t count, pixel color) {
+            const auto zero = _mm256_setzero_si256();
+            const auto over = _mm256_unpacklo_epi8(_mm256_set1_epi32(int(color.n | 0xFF000000u)), zero);
+            const auto alpha = _mm256_set1_epi16(int16_t(color.a));
+            const auto rest = _mm256_set1_epi16(int16_t(255 - color.a));
+            const auto overTerm = _mm256_add_epi16(_mm256_mullo_epi16(over, alpha), _mm256_set1_epi16(128));
+            auto out = reinterpret_cast<__m256i*>(dst);
+
+            std::size_t i = 0;
+            for (; i + 8 <= count; i += 8, ++out) {
+                auto d = _mm256_loadu_si256(out);
+                auto lo = _mm256_add_epi16(overTerm, _mm256_mullo_epi16(_mm256_unpacklo_epi8(d, zero), rest));
+                auto hi = _mm256_add_epi16(overTerm, _mm256_mullo_epi16(_mm256_unpackhi_epi8(d, zero), rest));
+                lo = _mm256_srli_epi16(_mm256_add_epi16(lo, _mm256_srli_epi16(lo, 8)), 8);
+                hi = _mm256_srli_epi16(_mm256_add_epi16(hi, _mm256_srli_epi16(hi, 8)), 8);
+                _mm256_storeu_si256(out, _mm256_packus_epi16(lo, hi));
+            }
+            blendColorScalar(dst + i, count - i, color);
+        }
+
+        constexpr kernel_table avx2Kernels = {
+                scaleAVX2,
+                divideAVX2,
+                addAVX2,
+                subAVX2,
+                lerpAVX2,
+                invAVX2,
+                blendAVX2,
+                blendColorAVX2
+        };
+#endif
+
+        // Follows simd::setLevel()
+        const kernel_table& activeKernels() {
+            switch (simd::activeLevel()) {
+#ifdef ARTI_SIMD_AVX2
+                case simd::level::AVX2:
+                    return avx2Kernels;
+#endif
+#ifdef ARTI_SIMD_SSE2
+                case simd::level::SSE2:
+                    return sse2Kernels;
+#endif
+                default:
+                    return scalarKernels;
+            }
+        }
+
+    }
+
+    void scale(span<pixel> pixels, float factor) {
+        activeKernels().scale(pixels.data(), pixels.size(), factor);
+    }
+
+    void divide(span<pixel> pixels, float divisor) {
+        activeKernels().divide(pixels.data(), pixels.size(), divisor);
+    }
+
+    void add(span<pixel> dst, span<const pixel> src) {
+        activeKernels().add(dst.data(), src.data(), std::min(dst.size(), src.size()));
+    }
+
+    void sub(span<pixel> dst, span<const pixel> src) {
+        activeKernels().sub(dst.data(), src.data(), std::min(dst.size(), src.size()));
+    }
+
+    void lerp(span<pixel> dst, span<const pixel> target, float t) {
+        activeKernels().lerp(dst.data(), target.data(), std::min(dst.size(), target.size()), t);
+    }
+
+    void inv(span<pixel> pixels) {
+        activeKernels().inv(pixels.data(), pixels.size());
+    }
+
+    void blend(span<pixel> dst, span<const pixel> src) {
+        activeKernels().blend(dst.data(), src.data(), std::min(dst.size(), src.size()));
+    }
+
+    void blend(span<pixel> dst, const pixel& color) {
+        activeKernels().blendColor(dst.data(), dst.size(), color);
+    }
+
+}
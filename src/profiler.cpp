@@ -0,0 +1,174 @@
+//
+// Created by Alcachofa
+//
+
+#include <utils/profiler.hpp>
+
+#ifdef ARTI_ENABLE_PROFILER
+
+#include <algorithm>
+
+#include <imgui.hpp>
+
+#include <utils/utils.hpp>
+
+namespace arti {
+
+    namespace {
+
+        thread_local uint32_t zoneDepth = 0;
+
+    }
+
+    profiler::profiler()
+            : frameStart(clock::now()),
+              current{},
+              zoneCount(0),
+              history{},
+              historyHead(0),
+              historyCount(0),
+              percentileScratch{},
+              frameRunning(false),
+              overlayVisible(false) {
+
+    }
+
+    profiler& profiler::get() {
+        static profiler instance;
+        return instance;
+    }
+
+    void profiler::newFrame() {
+        auto start = clock::now();
+
+        if (frameRunning) {
+            current.frameMs = std::chrono::duration<float, std::milli>(start - frameStart).count();
+            current.zoneCount = to<uint32_t>(std::min<std::size_t>(zoneCount.load(std::memory_order_relaxed), maxZones));
+
+            history[historyHead] = current;
+            historyHead = (historyHead + 1) % historySize;
+            historyCount = std::min(historyCount + 1, historySize);
+        }
+
+        zoneCount.store(0, std::memory_order_relaxed);
+        frameStart = start;
+        frameRunning = true;
+    }
+
+    uint32_t profiler::beginZone(const char* name) {
+        auto zone = zoneCount.fetch_add(1, std::memory_order_relaxed);
+        auto depth = zoneDepth++;
+
+        if (zone < maxZones) {
+            auto& record = current.zones[zone];
+            record.name = name;
+            record.depth = depth;
+            record.start = now();
+            record.end = record.start;
+        }
+
+        return zone;
+    }
+
+    void profiler::endZone(uint32_t zone) {
+        --zoneDepth;
+
+        if (zone < maxZones) {
+            current.zones[zone].end = now();
+        }
+    }
+
+    int64_t profiler::now() const {
+        return std::chrono::duration_cast<std::chrono::nanoseconds>(clock::now() - frameStart).count();
+    }
+
+    float profiler::percentile(float p) const {
+        if (historyCount == 0) {
+            return 0.0f;
+        }
+
+        auto times = percentileScratch.begin();
+        for (std::size_t i = 0; i < historyCount; ++i) {
+            times[i] = history[i].frameMs;
+        }
+
+        auto nth = to<std::size_t>(std::clamp(p, 0.0f, 1.0f) * to<float>(historyCount - 1));
+        std::nth_element(times, times + nth, times + historyCount);
+        return times[nth];
+    }
+
+    const profiler::frame_record& profiler::lastFrame() const {
+        return history[(historyHead + historySize - 1) % historySize];
+    }
+
+    void profiler::setOverlayVisible(bool visible) {
+        overlayVisible = visible;
+    }
+
+    bool profiler::isOverlayVisible() const {
+        return overlayVisible;
+    }
+
+    void profiler::drawOverlay() {
+        if (! overlayVisible) {
+            return;
+        }
+
+        ImGui::SetNextWindowSize(ImVec2(380, 0), ImGuiCond_FirstUseEver);
+
+        if (ImGui::Begin("Profiler", &overlayVisible)) {
+            std::array<float, historySize> times{};
+            float maxMs = 0.0f;
+
+            // Oldest to newest so the graph scrolls to the left
+            auto first = (historyHead + historySize - historyCount) % historySize;
+            for (std::size_t i = 0; i < historyCount; ++i) {
+                times[i] = history[(first + i) % historySize].frameMs;
+                maxMs = std::max(maxMs, times[i]);
+            }
+
+            ImGui::PlotLines("##frametime", times.data(), to<int>(historyCount), 0, nullptr, 0.0f, maxMs * 1.2f, ImVec2(-1.0f, 80.0f));
+            ImGui::Text("frame %.2f ms", lastFrame().frameMs);
+            ImGui::Text("p50 %.2f ms   p95 %.2f ms   p99 %.2f ms", percentile(0.50f), percentile(0.95f), percentile(0.99f));
+
+            if (ImGui::BeginTable("zones", 3, ImGuiTableFlags_RowBg | ImGuiTableFlags_BordersInnerV)) {
+                ImGui::TableSetupColumn("Zone");
+                ImGui::TableSetupColumn("Last (ms)");
+                ImGui::TableSetupColumn("Avg (ms)");
+                ImGui::TableHeadersRow();
+
+                const auto& frame = lastFrame();
+                for (uint32_t z = 0; z < frame.zoneCount; ++z) {
+                    const auto& zone = frame.zones[z];
+
+                    double total = 0.0;
+                    uint32_t samples = 0;
+                    for (std::size_t f = 0; f < historyCount; ++f) {
+                        const auto& past = history[f];
+                        for (uint32_t pz = 0; pz < past.zoneCount; ++pz) {
+                            if (past.zones[pz].name == zone.name && past.zones[pz].depth == zone.depth) {
+                                total += to<double>(past.zones[pz].end - past.zones[pz].start);
+                                ++samples;
+                            }
+                        }
+                    }
+
+                    ImGui::TableNextRow();
+                    ImGui::TableNextColumn();
+                    ImGui::Text("%*s%s", to<int>(zone.depth * 2), "", zone.name);
+                    ImGui::TableNextColumn();
+                    ImGui::Text("%.3f", to<double>(zone.end - zone.start) / 1e6);
+                    ImGui::TableNextColumn();
+                    ImGui::Text("%.3f", samples > 0 ? total / samples / 1e6 : 0.0);
+                }
+
+                ImGui::EndTable();
+            }
+        }
+
+        ImGui::End();
+    }
+
+}
+
+#endif
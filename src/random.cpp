@@ -0,0 +1,210 @@
+//
+// Created by Alcachofa
+//
+
+#include <utils/random.hpp>
+
+#include <algorithm>
+
+#include <utils/simd.hpp>
+
+namespace arti {
+
+    namespace {
+
+        constexpr std::size_t lanes = 4;
+
+        // Floats per step, each 64-bit output gives two
+        constexpr std::size_t floatsPerStep = lanes * 2;
+
+        // Four xoshiro256** streams stored word-major, s[w] holds word w of every lane
+        // so each word is one AVX2 register (or two SSE2 ones)
+        struct fill_state {
+            alignas(32) uint64_t s[4][lanes];
+            uint32_t generation = std::numeric_limits<uint32_t>::max();
+        };
+
+        // Lane outputs go to out[2 * lane] (low half) and out[2 * lane + 1] (high half),
+        // the SIMD kernels store them in the same order so every level fills the same values
+
+        constexpr uint64_t rotl(uint64_t x, int k) {
+            return (x << k) | (x >> (64 - k));
+        }
+
+        constexpr float halfToUnit(uint32_t half) {
+            return static_cast<float>(half >> 8u) * 0x1.0p-24f;
+        }
+
+        void stepScalar(fill_state& st, float* out) {
+            for (std::size_t lane = 0; lane < lanes; ++lane) {
+                auto& s0 = st.s[0][lane];
+                auto& s1 = st.s[1][lane];
+                auto& s2 = st.s[2][lane];
+                auto& s3 = st.s[3][lane];
+
+                const uint64_t result = rotl(s1 * 5, 7) * 9;
+                const uint64_t t = s1 << 17u;
+
+                s2 ^= s0;
+                s3 ^= s1;
+                s1 ^= s2;
+                s0 ^= s3;
+                s2 ^= t;
+                s3 = rotl(s3, 45);
+
+                out[2 * lane] = halfToUnit(static_cast<uint32_t>(result));
+                out[2 * lane + 1] = halfToUnit(static_cast<uint32_t>(result >> 32u));
+            }
+        }
+
+        void fillScalar(fill_state& st, float* out, std::size_t count) {
+            std::size_t i = 0;
+            for (; i + floatsPerStep <= count; i += floatsPerStep) {
+                stepScalar(st, out + i);
+            }
+
+            if (i < count) {
+                float last[floatsPerStep];
+                stepScalar(st, last);
+                std::copy(last, last + (count - i), out + i);
+            }
+        }
+
+#ifdef ARTI_SIMD_SSE2
+        template <int k>
+        __m128i rotl64SSE2(__m128i x) {
+            return _mm_or_si128(_mm_slli_epi64(x, k), _mm_srli_epi64(x, 64 - k));
+        }
+
+        // The 64-bit multiplies by 5 and 9 are shift + add, there's no 64-bit mullo below AVX-512
+        inline __m128i nextSSE2(__m128i& s0, __m128i& s1, __m128i& s2, __m128i& s3) {
+            const auto times5 = _mm_add_epi64(_mm_slli_epi64(s1, 2), s1);
+            const auto rotated = rotl64SSE2<7>(times5);
+            const auto result = _mm_add_epi64(_mm_slli_epi64(rotated, 3), rotated);
+            const auto t = _mm_slli_epi64(s1, 17);
+
+            s2 = _mm_xor_si128(s2, s0);
+            s3 = _mm_xor_si128(s3, s1);
+            s1 = _mm_xor_si128(s1, s2);
+            s0 = _mm_xor_si128(s0, s3);
+            s2 = _mm_xor_si128(s2, t);
+            s3 = rotl64SSE2<45>(s3);
+
+            return result;
+        }
+
+        inline __m128 toUnitSSE2(__m128i bits) {
+            return _mm_mul_ps(_mm_cvtepi32_ps(_mm_srli_epi32(bits, 8)), _mm_set1_ps(0x1.0p-24f));
+        }
+
+        void fillSSE2(fill_state& st, float* out, std::size_t count) {
+            // Lanes 0-1 in the first register of each pair, 2-3 in the second
+            auto a0 = _mm_load_si128(reinterpret_cast<const __m128i*>(st.s[0]));
+            auto a1 = _mm_load_si128(reinterpret_cast<const __m128i*>(st.s[1]));
+            auto a2 = _mm_load_si128(reinterpret_cast<const __m128i*>(st.s[2]));
+            auto a3 = _mm_load_si128(reinterpret_cast<const __m128i*>(st.s[3]));
+            auto b0 = _mm_load_si128(reinterpret_cast<const __m128i*>(st.s[0] + 2));
+            auto b1 = _mm_load_si128(reinterpret_cast<const __m128i*>(st.s[1] + 2));
+            auto b2 = _mm_load_si128(reinterpret_cast<const __m128i*>(st.s[2] + 2));
+            auto b3 = _mm_load_si128(reinterpret_cast<const __m128i*>(st.s[3] + 2));
+
+            std::size_t i = 0;
+            for (; i + floatsPerStep <= count; i += floatsPerStep) {
+                _mm_storeu_ps(out + i, toUnitSSE2(nextSSE2(a0, a1, a2, a3)));
+                _mm_storeu_ps(out + i + 4, toUnitSSE2(nextSSE2(b0, b1, b2, b3)));
+            }
+
+            _mm_store_si128(reinterpret_cast<__m128i*>(st.s[0]), a0);
+            _mm_store_si128(reinterpret_cast<__m128i*>(st.s[1]), a1);
+            _mm_store_si128(reinterpret_cast<__m128i*>(st.s[2]), a2);
+            _mm_store_si128(reinterpret_cast<__m128i*>(st.s[3]), a3);
+            _mm_store_si128(reinterpret_cast<__m128i*>(st.s[0] + 2), b0);
+            _mm_store_si128(reinterpret_cast<__m128i*>(st.s[1] + 2), b1);
+            _mm_store_si128(reinterpret_cast<__m128i*>(st.s[2] + 2), b2);
+            _mm_store_si128(reinterpret_cast<__m128i*>(st.s[3] + 2), b3);
+
+            fillScalar(st, out + i, count - i);
+        }
+#endif
+
+#ifdef ARTI_SIMD_AVX2
+        template <int k>
+        ARTI_TARGET_AVX2 __m256i rotl64AVX2(__m256i x) {
+            return _mm256_or_si256(_mm256_slli_epi64(x, k), _mm256_srli_epi64(x, 64 - k));
+        }
+
+        ARTI_TARGET_AVX2 void fillAVX2(fill_state& st, float* out, std::size_t count) {
+            auto s0 = _mm256_load_si256(reinterpret_cast<const __m256i*>(st.s[0]));
+            auto s1 = _mm256_load_si256(reinterpret_cast<const __m256i*>(st.s[1]));
+            auto s2 = _mm256_load_si256(reinterpret_cast<const __m256i*>(st.s[2]));
+            auto s3 = _mm256_load_si256(reinterpret_cast<const __m256i*>(st.s[3]));
+            const auto scale = _mm256_set1_ps(0x1.0p-24f);
+
+            std::size_t i = 0;
+            for (; i + floatsPerStep <= count; i += floatsPerStep) {
+                const auto times5 = _mm256_add_epi64(_mm256_slli_epi64(s1, 2), s1);
+                const auto rotated = rotl64AVX2<7>(times5);
+                const auto result = _mm256_add_epi64(_mm256_slli_epi64(rotated, 3), rotated);
+                const auto t = _mm256_slli_epi64(s1, 17);
+
+                s2 = _mm256_xor_si256(s2, s0);
+                s3 = _mm256_xor_si256(s3, s1);
+                s1 = _mm256_xor_si256(s1, s2);
+                s0 = _mm256_xor_si256(s0, s3);
+                s2 = _mm256_xor_si256(s2, t);
+                s3 = rotl64AVX2<45>(s3);
+
+                const auto unit = _mm256_mul_ps(_mm256_cvtepi32_ps(_mm256_srli_epi32(result, 8)), scale);
+                _mm256_storeu_ps(out + i, unit);
+            }
+
+            _mm256_store_si256(reinterpret_cast<__m256i*>(st.s[0]), s0);
+            _mm256_store_si256(reinterpret_cast<__m256i*>(st.s[1]), s1);
+            _mm256_store_si256(reinterpret_cast<__m256i*>(st.s[2]), s2);
+            _mm256_store_si256(reinterpret_cast<__m256i*>(st.s[3]), s3);
+
+            fillScalar(st, out + i, count - i);
+        }
+#endif
+
+        fill_state& threadFillState() {
+            thread_local fill_state st;
+
+            const auto current = random_generator::getSeedGeneration();
+            if (st.generation != current) {
+                auto& engine = random_generator::threadEngine();
+                for (std::size_t lane = 0; lane < lanes; ++lane) {
+                    const auto stream = engine.split();
+                    for (std::size_t word = 0; word < 4; ++word) {
+                        st.s[word][lane] = stream.getState()[word];
+                    }
+                }
+                st.generation = current;
+            }
+
+            return st;
+        }
+
+    }
+
+    void random_generator::fillUnit(span<float> out) {
+        auto& st = threadFillState();
+
+        switch (simd::activeLevel()) {
+#ifdef ARTI_SIMD_AVX2
+            case simd::level::AVX2:
+                fillAVX2(st, out.data(), out.size());
+                return;
+#endif
+#ifdef ARTI_SIMD_SSE2
+            case simd::level::SSE2:
+                fillSSE2(st, out.data(), out.size());
+                return;
+#endif
+            default:
+                fillScalar(st, out.data(), out.size());
+                return;
+        }
+    }
+
+}
@@ -4,110 +4,382 @@
 
 #include <renderer.hpp>
 
+#include <array>
+#include <cmath>
+#include <algorithm>
+
 #include <app.hpp>
 #include <imgui.hpp>
+#include <utils/simd.hpp>
 #include <utils/logger.hpp>
+#include <utils/profiler.hpp>
+#include <utils/trace.hpp>
+
+#include "shape_geometry.hpp"
 
 namespace arti {
 
+    namespace {
+
+        using shape_geometry::rectCorners;
+
+        // Same tessellation sf::CircleShape uses by default, so batched and immediate circles match
+        constexpr std::size_t circlePointCount = 30;
+
+        const std::array<math::vec2df, circlePointCount>& unitCircle() {
+            static const auto points = [] {
+                std::array<math::vec2df, circlePointCount> pts;
+                for (std::size_t i = 0; i < circlePointCount; ++i) {
+                    auto angle = to<float>(to<math::real>(i) * 2.0 * math::PI / circlePointCount - math::PI / 2.0);
+                    pts[i] = { std::cos(angle), std::sin(angle) };
+                }
+                return pts;
+            }();
+            return points;
+        }
+
+        inline void pushTriangle(std::vector<sf::Vertex>& out, const math::vec2df& a, const math::vec2df& b, const math::vec2df& c, const sf::Color& color) {
+            out.emplace_back(sf::Vector2f(a), color);
+            out.emplace_back(sf::Vector2f(b), color);
+            out.emplace_back(sf::Vector2f(c), color);
+        }
+
+        inline void pushQuad(std::vector<sf::Vertex>& out, const math::vec2df& a, const math::vec2df& b, const math::vec2df& c, const math::vec2df& d, const sf::Color& color) {
+            pushTriangle(out, a, b, c, color);
+            pushTriangle(out, a, c, d, color);
+        }
+
+        void pushCircle(std::vector<sf::Vertex>& out, const math::vec2df& center, float radius, const sf::Color& color) {
+            const auto& unit = unitCircle();
+            for (std::size_t i = 0; i < circlePointCount; ++i) {
+                const auto& p0 = unit[i];
+                const auto& p1 = unit[(i + 1) % circlePointCount];
+                pushTriangle(out, center, center + p0 * radius, center + p1 * radius, color);
+            }
+        }
+
+        void pushRing(std::vector<sf::Vertex>& out, const math::vec2df& center, float innerRadius, float outerRadius, const sf::Color& color) {
+            const auto& unit = unitCircle();
+            for (std::size_t i = 0; i < circlePointCount; ++i) {
+                const auto& p0 = unit[i];
+                const auto& p1 = unit[(i + 1) % circlePointCount];
+                pushQuad(out, center + p0 * innerRadius, center + p0 * outerRadius, center + p1 * outerRadius, center + p1 * innerRadius, color);
+            }
+        }
+
+        // Vertices SFML sends for a shape: a fan over its points plus the centre and the
+        // closing point, and with an outline a strip of two per point plus the closing pair
+        uint32_t shapeVertices(const sf::Shape& shape) {
+            const auto points = to<uint32_t>(shape.getPointCount());
+            return points + 2 + (shape.getOutlineThickness() != 0.0f ? 2 * (points + 1) : 0);
+        }
+
+        // Two triangles sampling `texels` of the bound texture, corners in the order rectCorners gives them
+        void pushTexturedQuad(std::vector<sf::Vertex>& out, const std::array<math::vec2df, 4>& corners, const sf::IntRect& texels, const sf::Color& color) {
+            auto left = to<float>(texels.left);
+            auto top = to<float>(texels.top);
+            auto right = left + to<float>(texels.width);
+            auto bottom = top + to<float>(texels.height);
+
+            const sf::Vector2f uvs[4] = { { left, top }, { right, top }, { right, bottom }, { left, bottom } };
+            const std::size_t order[6] = { 0, 1, 2, 0, 2, 3 };
+
+            for (auto i : order) {
+                out.emplace_back(sf::Vector2f(corners[i]), color, uvs[i]);
+            }
+        }
+
+        void pushRectangle(std::vector<sf::Vertex>& out, const math::vec2df& coords, const math::vec2df& size, float borderThickness, const sf::Color& fillColor, const sf::Color& borderColor, float rotation) {
+            auto inner = rectCorners(coords, { 0.0f, 0.0f }, size, rotation);
+            pushQuad(out, inner[0], inner[1], inner[2], inner[3], fillColor);
+
+            if (borderThickness != 0.0f) {
+                auto outer = rectCorners(coords, { -borderThickness, -borderThickness }, size + borderThickness, rotation);
+                for (std::size_t i = 0; i < 4; ++i) {
+                    auto next = (i + 1) % 4;
+                    pushQuad(out, inner[i], outer[i], outer[next], inner[next], borderColor);
+                }
+            }
+        }
+
+#ifdef ARTI_SIMD_SSE2
+        static_assert(sizeof(math::vec2df) == 2 * sizeof(float), "cullBatch reads positions as packed float pairs");
+
+        // x and y of positions[i, i + 4), read as packed float pairs
+        inline void loadPositions(const math::vec2df* positions, std::size_t i, __m128& xs, __m128& ys) {
+            const auto* raw = reinterpret_cast<const float*>(positions + i);
+            auto p01 = _mm_loadu_ps(raw);
+            auto p23 = _mm_loadu_ps(raw + 4);
+            xs = _mm_shuffle_ps(p01, p23, _MM_SHUFFLE(2, 0, 2, 0));
+            ys = _mm_shuffle_ps(p01, p23, _MM_SHUFFLE(3, 1, 3, 1));
+        }
+
+        // Appends `base + lane` for every lane set in `inside`
+        inline void pushVisible(__m128 inside, std::size_t base, std::vector<uint32_t>& visible) {
+            auto mask = _mm_movemask_ps(inside);
+            for (int lane = 0; mask != 0; ++lane, mask >>= 1) {
+                if (mask & 1) {
+                    visible.push_back(to<uint32_t>(base + lane));
+                }
+            }
+        }
+#endif
+
+    }
+
     renderer::renderer(app* appInstance)
             : layerCount(0),
-              defaultLayer(0),
-              targetedLayer(0),
+              layerSequence(0),
+              defaultLayer(invalidLayer),
+              targetedLayer(invalidLayer),
               textureCount(0),
+              drawOrderDirty(false),
+              target(nullptr),
+              deferred(false),
+              pipelined(false),
+              recording(false),
+              sortCommands(false),
+              recordIndex(0),
               appInstance(appInstance),
-              window(appInstance->getWindow()) {
-
+              output(nullptr) {
+        commandLists[0].clear();
+        commandLists[1].clear();
     }
 
     renderer::~renderer() = default;
 
     void renderer::clear(const pixel& color) {
-        layersList.at(targetedLayer).texture.clear(color);
+        if (recording) {
+            recordCommand(draw_command::Clear).color = color;
+            return;
+        }
+
+        target->batch.clear();
+        target->texture.clear(color);
     }
 
     renderer::layer_id renderer::createLayer() {
-        return this->createLayer(window.getSize());
+        return this->createLayer(output->getSize());
     }
 
     renderer::layer_id renderer::createLayer(const math::vec2di& size) {
-        auto& newLayer = layersList[layerCount + 1];
-        sf::RenderTexture& newTexture = newLayer.texture;
+        if (freeSlots.empty()) {
+            // One slot short of the 16 bit range, so no id can be invalidLayer
+            if (layerSlots.size() >= std::numeric_limits<uint16_t>::max() - 1u) {
+                logger::error("Couldn't create layer, all {} layer slots are in use", layerSlots.size());
+                return invalidLayer;
+            }
 
-        if (!newTexture.create(size.x, size.y)) {
-            layersList.erase(layerCount + 1);
-            logger::error("Couldn't create layer {} of size {}", layerCount + 1, size.to_string());
-            return std::numeric_limits<layer_id>::max();
+            freeSlots.push_back(to<uint16_t>(layerSlots.size()));
+            layerSlots.emplace_back();
         }
 
-        newTexture.clear(sf::Color::Transparent);
+        auto index = freeSlots.back();
+        auto& slot = layerSlots[index];
+        auto newLayer = std::make_unique<layer_t>();
+        newLayer->id = (to<layer_id>(slot.generation) << 16u) | (index + 1u);
 
-        newLayer.id = ++layerCount;
-        newLayer.enabled = true;
-        newLayer.scale = 1.0f;
-        newLayer.viewScale = 1.0f;
+        if (!newLayer->texture.create(size.x, size.y)) {
+            logger::error("Couldn't create layer {} of size {}", newLayer->id, size.to_string());
+            return invalidLayer;
+        }
+
+        freeSlots.pop_back();
+
+        newLayer->texture.clear(sf::Color::Transparent);
+
+        newLayer->enabled = true;
+        newLayer->batched = false;
+        newLayer->zOrder = 0;
+        newLayer->sequence = layerSequence++;
+        newLayer->scale = 1.0f;
+        newLayer->viewScale = 1.0f;
+
+        slot.layer = std::move(newLayer);
+
+        ++layerCount;
+        drawOrder.push_back(slot.layer.get());
+        drawOrderDirty = true;
+
+        return slot.layer->id;
+    }
+
+    renderer::layer_id renderer::createPixelLayer() {
+        return this->createPixelLayer(output->getSize());
+    }
 
-        return newLayer.id;
+    renderer::layer_id renderer::createPixelLayer(const math::vec2di& size) {
+        auto id = this->createLayer(size);
+
+        if (id == invalidLayer) {
+            return invalidLayer;
+        }
+
+        auto layer = findLayer(id);
+        layer->pixels = std::make_unique<pixel_buffer>();
+
+        if (! layer->pixels->create(size)) {
+            logger::error("Couldn't create the pixels of layer {}", id);
+            destroyLayer(id);
+            return invalidLayer;
+        }
+
+        return id;
+    }
+
+    pixel_buffer* renderer::getLayerPixels() {
+        return target->pixels.get();
     }
 
     void renderer::offsetLayer(const math::vec2df& offset) {
-        layersList.at(targetedLayer).offset += offset;
+        target->offset += offset;
+        target->visibleDirty = true;
     }
 
     void renderer::scaleLayerAt(float scale, const math::vec2df& screenCenter) {
         auto before = screenToLayer(screenCenter);
-        layersList.at(targetedLayer).scale = scale;
+        target->scale = scale;
         auto after = layerToScreen(before);
-        layersList.at(targetedLayer).offset -= (after - screenCenter);
+        target->offset -= (after - screenCenter);
+        target->visibleDirty = true;
     }
 
     void renderer::offsetView(const math::vec2df& offset) {
-        layersList.at(targetedLayer).viewOffset -= ((offset / layersList.at(targetedLayer).viewScale) / layersList.at(targetedLayer).scale);
-        layersList.at(targetedLayer).updateView();
+        target->viewOffset -= ((offset / target->viewScale) / target->scale);
+        applyView();
     }
 
     void renderer::scaleViewAt(float scale, const math::vec2df& screenCenter) {
         auto before = screenToView(screenCenter);
-        layersList.at(targetedLayer).viewScale = scale;
+        target->viewScale = scale;
         auto after = viewToScreen(before);
-        layersList.at(targetedLayer).viewOffset += (((after - screenCenter) / scale) / layersList.at(targetedLayer).scale);
-        layersList.at(targetedLayer).updateView();
+        target->viewOffset += (((after - screenCenter) / scale) / target->scale);
+        applyView();
     }
 
 
     float renderer::getLayerScale() const {
-        return layersList.at(targetedLayer).scale;
+        return target->scale;
     }
 
     math::vec2df renderer::getLayerOffset() const {
-        return layersList.at(targetedLayer).offset;
+        return target->offset;
     }
 
 
     math::vec2di renderer::getLayerSize() const {
-        return layersList.at(targetedLayer).texture.getSize();
+        return target->texture.getSize();
     }
 
     void renderer::resizeLayer(const math::vec2di& newSize) {
-        if (!layersList.at(targetedLayer).texture.create(newSize.x, newSize.y)) {
+        target->batch.clear();
+        if (!target->texture.create(newSize.x, newSize.y)) {
             logger::error("Couldn't resize texture {} to {}", targetedLayer, newSize.to_string());
-            layersList.erase(targetedLayer);
+            if (targetedLayer != defaultLayer) {
+                destroyLayer(targetedLayer);
+            }
+            return;
         }
-        layersList.at(targetedLayer).updateView();
+
+        if (target->pixels && ! target->pixels->create(newSize)) {
+            logger::error("Couldn't resize the pixels of layer {} to {}", targetedLayer, newSize.to_string());
+        }
+
+        target->updateView();
+    }
+
+    bool renderer::destroyLayer(const layer_id& id) {
+        auto layer = findLayer(id);
+
+        if (layer == nullptr) {
+            logger::error("Couldn't destroy layer {}, it doesn't exist", id);
+            return false;
+        }
+
+        if (id == defaultLayer) {
+            logger::error("The default layer can't be destroyed");
+            return false;
+        }
+
+        if (id == targetedLayer) {
+            targetDefaultLayer();
+        }
+
+        drawOrder.erase(std::find(drawOrder.begin(), drawOrder.end(), layer));
+
+        auto& slot = layerSlots[slotIndex(id)];
+        slot.layer.reset();
+        ++slot.generation;
+        freeSlots.push_back(slotIndex(id));
+
+        --layerCount;
+        return true;
+    }
+
+    bool renderer::isLayerValid(const layer_id& id) const {
+        return findLayer(id) != nullptr;
     }
 
     bool renderer::enableLayer(const layer_id& id, bool enabled) {
-        layersList.at(id).enabled = enabled;
+        auto layer = findLayer(id);
+
+        if (layer == nullptr) {
+            logger::error("Couldn't enable layer {}, it doesn't exist", id);
+            return false;
+        }
+
+        layer->enabled = enabled;
         return true;
     }
 
     bool renderer::isLayerEnabled(const layer_id& id) {
-        return layersList.at(id).enabled;
+        auto layer = findLayer(id);
+        return layer != nullptr && layer->enabled;
+    }
+
+    bool renderer::setLayerOrder(const layer_id& id, int32_t zOrder) {
+        auto layer = findLayer(id);
+
+        if (layer == nullptr) {
+            logger::error("Couldn't reorder layer {}, it doesn't exist", id);
+            return false;
+        }
+
+        if (layer->zOrder != zOrder) {
+            layer->zOrder = zOrder;
+            drawOrderDirty = true;
+        }
+
+        return true;
+    }
+
+    int32_t renderer::getLayerOrder(const layer_id& id) const {
+        auto layer = findLayer(id);
+        return layer != nullptr ? layer->zOrder : 0;
+    }
+
+    void renderer::setLayerBatching(bool enabled, std::size_t reservedVertices) {
+        target->flush();
+        target->batched = enabled;
+
+        if (enabled) {
+            target->batch.reserve(reservedVertices);
+        }
+        else {
+            target->batch.shrink_to_fit();
+        }
+    }
+
+    bool renderer::isLayerBatching() const {
+        return target->batched;
     }
 
     bool renderer::setTargetedLayer(const layer_id& id) {
-        if (layersList.find(id) != layersList.end()) {
+        auto layer = findLayer(id);
+
+        if (layer != nullptr) {
             targetedLayer = id;
+            target = layer;
             return true;
         }
         return false;
@@ -118,24 +390,45 @@ namespace arti {
     }
 
     bool renderer::targetDefaultLayer() {
-        targetedLayer = defaultLayer;
-        return true;
+        return setTargetedLayer(defaultLayer);
     }
 
     void renderer::renderCircle(const math::vec2df& coords, float radius, const pixel& fillColor) {
         if (isVisible(coords, radius)) {
+            auto& layer = *target;
+            if (recording || layer.batched) {
+                auto& out = geometryOutput();
+                auto first = out.size();
+                pushCircle(out, coords, radius, fillColor);
+                commitGeometry(first);
+                return;
+            }
+
             sf::CircleShape circ(radius);
             circ.setOrigin(radius, radius);
             circ.setFillColor(fillColor);
             circ.setOutlineThickness(0);
             circ.setPosition(coords);
 
-            layersList.at(targetedLayer).texture.draw(circ);
+            layer.flush();
+            layer.texture.draw(circ);
+            ++layer.drawCalls;
+            layer.drawnVertices += shapeVertices(circ);
         }
     }
 
     void renderer::renderCircle(const math::vec2df& coords, float radius, float borderThickness, const pixel& fillColor, const pixel& borderColor) {
         if (isVisible(coords, radius + borderThickness)) {
+            auto& layer = *target;
+            if (recording || layer.batched) {
+                auto& out = geometryOutput();
+                auto first = out.size();
+                pushCircle(out, coords, radius, fillColor);
+                pushRing(out, coords, radius, radius + borderThickness, borderColor);
+                commitGeometry(first);
+                return;
+            }
+
             sf::CircleShape circ(radius);
             circ.setOutlineThickness(borderThickness);
             circ.setOutlineColor(borderColor);
@@ -143,23 +436,47 @@ namespace arti {
             circ.setFillColor(fillColor);
             circ.setPosition(coords);
 
-            layersList.at(targetedLayer).texture.draw(circ);
+            layer.flush();
+            layer.texture.draw(circ);
+            ++layer.drawCalls;
+            layer.drawnVertices += shapeVertices(circ);
         }
     }
 
     void renderer::renderRectangle(const math::vec2df& coords, const math::vec2df& size, const pixel& fillColor, float rotation) {
         if (isVisible(coords, std::max(size.x, size.y))) {
+            auto& layer = *target;
+            if (recording || layer.batched) {
+                auto& out = geometryOutput();
+                auto first = out.size();
+                pushRectangle(out, coords, size, 0.0f, fillColor, fillColor, rotation);
+                commitGeometry(first);
+                return;
+            }
+
             sf::RectangleShape rect(size);
             rect.setFillColor(fillColor);
             rect.setRotation(rotation);
             rect.setPosition(coords);
 
-            layersList.at(targetedLayer).texture.draw(rect);
+            layer.flush();
+            layer.texture.draw(rect);
+            ++layer.drawCalls;
+            layer.drawnVertices += shapeVertices(rect);
         }
     }
 
     void renderer::renderRectangle(const math::vec2df& coords, const math::vec2df& size, float borderThickness, const pixel& fillColor, const pixel& borderColor, float rotation) {
         if (isVisible(coords, std::max(size.x, size.y) + borderThickness)) {
+            auto& layer = *target;
+            if (recording || layer.batched) {
+                auto& out = geometryOutput();
+                auto first = out.size();
+                pushRectangle(out, coords, size, borderThickness, fillColor, borderColor, rotation);
+                commitGeometry(first);
+                return;
+            }
+
             sf::RectangleShape rect(size);
             rect.setOutlineThickness(borderThickness);
             rect.setOutlineColor(borderColor);
@@ -167,24 +484,48 @@ namespace arti {
             rect.setRotation(rotation);
             rect.setPosition(coords);
 
-            layersList.at(targetedLayer).texture.draw(rect);
+            layer.flush();
+            layer.texture.draw(rect);
+            ++layer.drawCalls;
+            layer.drawnVertices += shapeVertices(rect);
         }
     }
 
 
     void renderer::renderSquare(const math::vec2df& coords, float sideSize, const pixel& fillColor, float rotation) {
         if (isVisible(coords, sideSize)) {
+            auto& layer = *target;
+            if (recording || layer.batched) {
+                auto& out = geometryOutput();
+                auto first = out.size();
+                pushRectangle(out, coords, { sideSize, sideSize }, 0.0f, fillColor, fillColor, rotation);
+                commitGeometry(first);
+                return;
+            }
+
             sf::RectangleShape rect({ sideSize, sideSize });
             rect.setFillColor(fillColor);
             rect.setRotation(rotation);
             rect.setPosition(coords);
 
-            layersList.at(targetedLayer).texture.draw(rect);
+            layer.flush();
+            layer.texture.draw(rect);
+            ++layer.drawCalls;
+            layer.drawnVertices += shapeVertices(rect);
         }
     }
 
     void renderer::renderSquare(const math::vec2df& coords, float sideSize, float borderThickness, const pixel& fillColor, const pixel& borderColor, float rotation) {
         if (isVisible(coords, sideSize + borderThickness)) {
+            auto& layer = *target;
+            if (recording || layer.batched) {
+                auto& out = geometryOutput();
+                auto first = out.size();
+                pushRectangle(out, coords, { sideSize, sideSize }, borderThickness, fillColor, borderColor, rotation);
+                commitGeometry(first);
+                return;
+            }
+
             sf::RectangleShape rect({ sideSize, sideSize });
             rect.setOutlineThickness(borderThickness);
             rect.setOutlineColor(borderColor);
@@ -192,18 +533,31 @@ namespace arti {
             rect.setRotation(rotation);
             rect.setPosition(coords);
 
-            layersList.at(targetedLayer).texture.draw(rect);
+            layer.flush();
+            layer.texture.draw(rect);
+            ++layer.drawCalls;
+            layer.drawnVertices += shapeVertices(rect);
         }
     }
 
     void renderer::renderLine(const math::vec2df& pointA, const math::vec2df& pointB, const pixel& color) {
 //        if (isVisible(pointA) || isVisible(pointB)) {
+            auto& layer = *target;
+            if (recording || layer.batched) {
+                // Batches only hold triangles, so a hairline becomes a 1px wide quad
+                renderLine(pointA, pointB, 1.0f, color);
+                return;
+            }
+
             sf::Vertex line[] = {
                     sf::Vertex(sf::Vector2f(pointA), color),
                     sf::Vertex(sf::Vector2f(pointB), color)
             };
 
-            layersList.at(targetedLayer).texture.draw(line, 2, sf::Lines);
+            layer.flush();
+            layer.texture.draw(line, 2, sf::Lines);
+            ++layer.drawCalls;
+            layer.drawnVertices += 2;
 //        }
     }
 
@@ -211,6 +565,15 @@ namespace arti {
 //        if (isVisible(pointA, thickness) || isVisible(pointB, thickness)) {
             auto perpendicular = (pointB - pointA).perpendicular().normalize() * thickness * 0.5;
 
+            auto& layer = *target;
+            if (recording || layer.batched) {
+                auto& out = geometryOutput();
+                auto first = out.size();
+                pushQuad(out, pointA + perpendicular, pointA - perpendicular, pointB - perpendicular, pointB + perpendicular, color);
+                commitGeometry(first);
+                return;
+            }
+
             sf::Vertex line[] = {
                     sf::Vertex(sf::Vector2f(pointA + perpendicular), color),
                     sf::Vertex(sf::Vector2f(pointA - perpendicular), color),
@@ -218,62 +581,616 @@ namespace arti {
                     sf::Vertex(sf::Vector2f(pointB + perpendicular), color),
             };
 
-            layersList.at(targetedLayer).texture.draw(line, 4, sf::Quads);
+            layer.flush();
+            layer.texture.draw(line, 4, sf::Quads);
+            ++layer.drawCalls;
+            layer.drawnVertices += 4;
 //        }
     }
 
     bool renderer::init() {
+        output = &appInstance->getRenderTarget();
+
         defaultLayer = this->createLayer();
 
+        if (defaultLayer == invalidLayer) {
+            return false;
+        }
+
         this->setTargetedLayer(defaultLayer);
 
         return true;
     }
 
+    renderer::layer_t* renderer::findLayer(const layer_id& id) const {
+        auto index = slotIndex(id);
+
+        if (index >= layerSlots.size()) {
+            return nullptr;
+        }
+
+        const auto& slot = layerSlots[index];
+
+        if (slot.generation != slotGeneration(id)) {
+            return nullptr;
+        }
+
+        return slot.layer.get();
+    }
+
+    void renderer::sortLayers() {
+        std::sort(drawOrder.begin(), drawOrder.end(), [](const layer_t* lhs, const layer_t* rhs) {
+            if (lhs->zOrder != rhs->zOrder) {
+                return lhs->zOrder < rhs->zOrder;
+            }
+            return lhs->sequence < rhs->sequence;
+        });
+
+        drawOrderDirty = false;
+    }
+
     bool renderer::render() {
-        window.clear();
+        ARTI_TRACE_SCOPE("renderer::render");
+
+        if (recording) {
+            closeRecordedFrame();
+            submitRecordedFrame();
+        }
+        else {
+            composeLayers();
+            collectStats();
+        }
+
+        renderOverlay();
+
+        return true;
+    }
+
+    void renderer::composeLayers() {
+        ARTI_PROFILE_SCOPE("Layer composition");
+
+        output->clear();
+
+        if (drawOrderDirty) {
+            sortLayers();
+        }
+
+        uploadPixelLayers();
 
         sf::Sprite sprite;
-        for (auto& [layerId, layer_data] : layersList) {
-            if (layer_data.enabled) {
-                layer_data.render(sprite, window);
+        for (auto layer : drawOrder) {
+            layer->flush();
+
+            if (layer->enabled) {
+                layer->render(sprite, *output);
+            }
+        }
+    }
+
+    void renderer::uploadPixelLayers() {
+        for (auto layer : drawOrder) {
+            if (layer->pixels && layer->enabled) {
+                layer->pixels->upload();
             }
         }
+    }
 
-        ImGui::SFML::Render(window);
+    void renderer::collectStats() {
+        stats = {};
 
-        return true;
+        for (auto layer : drawOrder) {
+            stats.drawCalls += layer->drawCalls;
+            stats.vertices += layer->drawnVertices;
+            layer->drawCalls = 0;
+            layer->drawnVertices = 0;
+        }
+    }
+
+    void renderer::renderOverlay() {
+        ARTI_PROFILE_SCOPE("ImGui::SFML::Render");
+        ImGui::SFML::Render(*output);
+    }
+
+    void renderer::setDeferred(bool enabled) {
+        deferred = enabled;
+        updateRecording();
+    }
+
+    bool renderer::isDeferred() const {
+        return deferred;
+    }
+
+    void renderer::setCommandSorting(bool enabled) {
+        sortCommands = enabled;
+    }
+
+    bool renderer::isCommandSorting() const {
+        return sortCommands;
+    }
+
+    bool renderer::isRecording() const {
+        return recording;
+    }
+
+    void renderer::runBeforeSubmit(std::function<void()> task) {
+        if (! recording) {
+            task();
+            return;
+        }
+
+        commandLists[recordIndex].tasks.push_back(std::move(task));
+    }
+
+    span<const renderer::draw_command> renderer::getFrameCommands() const {
+        return commandLists[1 - recordIndex].commands;
+    }
+
+    const renderer::frame_stats& renderer::getFrameStats() const {
+        return stats;
+    }
+
+    void renderer::setPipelined(bool enabled) {
+        pipelined = enabled;
+        updateRecording();
+    }
+
+    void renderer::updateRecording() {
+        bool enabled = deferred || pipelined;
+
+        if (recording == enabled) {
+            return;
+        }
+
+        // Anything recorded but not submitted yet is lost, so drain it first
+        if (recording) {
+            closeRecordedFrame();
+            submitRecordedFrame();
+        }
+
+        for (auto layer : drawOrder) {
+            layer->flush();
+        }
+
+        commandLists[0].clear();
+        commandLists[1].clear();
+        recordIndex = 0;
+        recording = enabled;
+    }
+
+    void renderer::closeRecordedFrame() {
+        auto& list = commandLists[recordIndex];
+
+        if (drawOrderDirty) {
+            sortLayers();
+        }
+
+        list.layers.clear();
+        for (auto layer : drawOrder) {
+            list.layers.push_back({ layer->id, layer->enabled, layer->scale, layer->offset });
+        }
+
+        // The update worker is idle here, so the pixels can't change under the upload
+        uploadPixelLayers();
+
+        for (auto& task : list.tasks) {
+            task();
+        }
+        list.tasks.clear();
+
+        recordIndex = to<uint8_t>(1 - recordIndex);
+        commandLists[recordIndex].clear();
+    }
+
+    void renderer::submitRecordedFrame() {
+        ARTI_PROFILE_SCOPE("Layer composition");
+        ARTI_TRACE_SCOPE("renderer::submitRecordedFrame");
+
+        auto& list = commandLists[1 - recordIndex];
+        auto& commands = list.commands;
+
+        if (sortCommands) {
+            std::stable_sort(commands.begin(), commands.end(), [](const draw_command& lhs, const draw_command& rhs) {
+                if (lhs.layer != rhs.layer) {
+                    return lhs.layer < rhs.layer;
+                }
+                if (lhs.segment != rhs.segment) {
+                    return lhs.segment < rhs.segment;
+                }
+
+                // The Clear/View opening a segment always goes first
+                bool lhsBarrier = lhs.type == draw_command::Clear || lhs.type == draw_command::View;
+                bool rhsBarrier = rhs.type == draw_command::Clear || rhs.type == draw_command::View;
+                if (lhsBarrier != rhsBarrier) {
+                    return lhsBarrier;
+                }
+
+                if (lhs.blend != rhs.blend) {
+                    return lhs.blend < rhs.blend;
+                }
+                return std::less<const sf::Texture*>()(lhs.texture, rhs.texture);
+            });
+        }
+
+        auto mergeable = [](const draw_command& lhs, const draw_command& rhs) {
+            return rhs.type == draw_command::Vertices &&
+                   lhs.layer == rhs.layer &&
+                   lhs.blend == rhs.blend &&
+                   lhs.texture == rhs.texture &&
+                   lhs.transform == rhs.transform;
+        };
+
+        auto statesOf = [&list](const draw_command& cmd) {
+            return sf::RenderStates(list.blendModes[cmd.blend], list.transforms[cmd.transform], cmd.texture, nullptr);
+        };
+
+        stats = {};
+        stats.commands = to<uint32_t>(commands.size());
+
+        std::size_t i = 0;
+        while (i < commands.size()) {
+            const auto& cmd = commands[i];
+            auto layer = findLayer(cmd.layer);
+
+            if (layer == nullptr) {
+                ++i;
+                continue;
+            }
+
+            switch (cmd.type) {
+                case draw_command::Clear:
+                    layer->texture.clear(cmd.color);
+                    ++i;
+                    break;
+
+                case draw_command::View:
+                    layer->applyView(cmd.viewOffset, cmd.viewScale);
+                    ++i;
+                    break;
+
+                case draw_command::Drawable:
+                    layer->texture.draw(*cmd.drawable, statesOf(cmd));
+                    ++stats.drawCalls;
+                    ++i;
+                    break;
+
+                case draw_command::Vertices: {
+                    auto end = i + 1;
+                    auto contiguous = true;
+                    auto count = cmd.count;
+
+                    while (end < commands.size() && mergeable(cmd, commands[end])) {
+                        contiguous = contiguous && commands[end].first == cmd.first + count;
+                        count += commands[end].count;
+                        ++end;
+                    }
+
+                    const sf::Vertex* vertices = list.vertices.data() + cmd.first;
+                    if (! contiguous) {
+                        submitScratch.clear();
+                        for (auto j = i; j < end; ++j) {
+                            auto begin = list.vertices.begin() + commands[j].first;
+                            submitScratch.insert(submitScratch.end(), begin, begin + commands[j].count);
+                        }
+                        vertices = submitScratch.data();
+                    }
+
+                    layer->texture.draw(vertices, count, sf::Triangles, statesOf(cmd));
+                    ++stats.drawCalls;
+                    stats.vertices += count;
+                    i = end;
+                    break;
+                }
+            }
+        }
+
+        output->clear();
+
+        sf::Sprite sprite;
+        for (const auto& state : list.layers) {
+            auto layer = findLayer(state.id);
+
+            if (layer != nullptr && state.enabled) {
+                layer->render(sprite, *output, state.offset, state.scale);
+            }
+        }
+    }
+
+    std::vector<sf::Vertex>& renderer::geometryOutput(const sf::Texture* texture) {
+        if (recording) {
+            return commandLists[recordIndex].vertices;
+        }
+
+        if (target->batchTexture != texture) {
+            target->flush();
+            target->batchTexture = texture;
+        }
+
+        return target->batch;
+    }
+
+    void renderer::commitGeometry(std::size_t firstVertex, const sf::Texture* texture, const sf::BlendMode& blend) {
+        if (! recording) {
+            return;
+        }
+
+        auto& list = commandLists[recordIndex];
+        auto count = to<uint32_t>(list.vertices.size() - firstVertex);
+        auto blendIndex = recordBlendMode(blend);
+
+        if (! list.commands.empty()) {
+            auto& last = list.commands.back();
+            if (last.type == draw_command::Vertices && last.layer == targetedLayer &&
+                last.texture == texture && last.blend == blendIndex && last.transform == 0) {
+                last.count += count;
+                return;
+            }
+        }
+
+        auto& cmd = recordCommand(draw_command::Vertices);
+        cmd.texture = texture;
+        cmd.blend = blendIndex;
+        cmd.first = to<uint32_t>(firstVertex);
+        cmd.count = count;
+    }
+
+    renderer::draw_command& renderer::recordCommand(draw_command::type_t type) {
+        auto& list = commandLists[recordIndex];
+        auto index = slotIndex(targetedLayer);
+
+        if (list.segments.size() <= index) {
+            list.segments.resize(index + 1, 0);
+        }
+
+        if (type == draw_command::Clear || type == draw_command::View) {
+            ++list.segments[index];
+        }
+
+        draw_command cmd{};
+        cmd.type = type;
+        cmd.layer = targetedLayer;
+        cmd.segment = list.segments[index];
+
+        list.commands.push_back(cmd);
+        return list.commands.back();
+    }
+
+    uint8_t renderer::recordBlendMode(const sf::BlendMode& blend) {
+        auto& modes = commandLists[recordIndex].blendModes;
+
+        for (std::size_t i = 0; i < modes.size(); ++i) {
+            if (modes[i] == blend) {
+                return to<uint8_t>(i);
+            }
+        }
+
+        if (modes.size() > std::numeric_limits<uint8_t>::max()) {
+            logger::warning("Too many blend modes in one frame, falling back to alpha blending");
+            return 0;
+        }
+
+        modes.push_back(blend);
+        return to<uint8_t>(modes.size() - 1);
+    }
+
+    uint32_t renderer::recordTransform(const sf::Transform& transform) {
+        auto& transforms = commandLists[recordIndex].transforms;
+
+        if (std::equal(transform.getMatrix(), transform.getMatrix() + 16, sf::Transform::Identity.getMatrix())) {
+            return 0;
+        }
+
+        transforms.push_back(transform);
+        return to<uint32_t>(transforms.size() - 1);
+    }
+
+    void renderer::applyView() {
+        if (! recording) {
+            target->updateView();
+            return;
+        }
+
+        auto& cmd = recordCommand(draw_command::View);
+        cmd.viewOffset = target->viewOffset;
+        cmd.viewScale = target->viewScale;
+
+        target->visibleDirty = true;
     }
 
     math::vec2df renderer::screenToLayer(const math::vec2df &coord) {
-        return ((coord - layersList[targetedLayer].offset) / layersList[targetedLayer].scale);
+        return ((coord - target->offset) / target->scale);
     }
 
     math::vec2df renderer::layerToScreen(const math::vec2df &coord) {
-        return layersList[targetedLayer].offset + (coord * layersList[targetedLayer].scale);
+        return target->offset + (coord * target->scale);
     }
 
     math::vec2df renderer::screenToView(const math::vec2df& coord) {
-        return layersList[targetedLayer].viewOffset + (screenToLayer(coord) / layersList[targetedLayer].viewScale);
+        return target->viewOffset + (screenToLayer(coord) / target->viewScale);
     }
 
     math::vec2df renderer::viewToScreen(const math::vec2df& coord) {
-        return layerToScreen((coord - layersList[targetedLayer].viewOffset) * layersList[targetedLayer].viewScale);
+        return layerToScreen((coord - target->viewOffset) * target->viewScale);
+    }
+
+    renderer::texture_id renderer::loadTexture(std::string_view file) {
+        auto id = atlas.add(file);
+        textureCount = to<texture_id>(atlas.getTextureCount());
+        return id;
+    }
+
+    renderer::texture_id renderer::loadTexture(const sf::Image& image) {
+        auto id = atlas.add(image);
+        textureCount = to<texture_id>(atlas.getTextureCount());
+        return id;
+    }
+
+    math::vec2di renderer::getTextureSize(texture_id id) const {
+        if (! atlas.isValid(id)) {
+            return { 0, 0 };
+        }
+
+        const auto& rect = atlas.getRegion(id).rect;
+        return { rect.width, rect.height };
+    }
+
+    const texture_atlas& renderer::getTextureAtlas() const {
+        return atlas;
+    }
+
+    void renderer::renderSprite(texture_id id, const math::vec2df& coords, const math::vec2df& scale, float rotation, const pixel& tint) {
+        if (! atlas.isValid(id)) {
+            return;
+        }
+
+        const auto& region = atlas.getRegion(id);
+        math::vec2df size{ to<float>(region.rect.width) * scale.x, to<float>(region.rect.height) * scale.y };
+
+        if (isVisible(coords, std::max(std::abs(size.x), std::abs(size.y)))) {
+            const auto* page = &atlas.getPage(region.page);
+
+            auto& out = geometryOutput(page);
+            auto first = out.size();
+            pushTexturedQuad(out, rectCorners(coords, { 0.0f, 0.0f }, size, rotation), region.rect, tint);
+            commitGeometry(first, page);
+        }
     }
 
     void renderer::render(const sf::Drawable &drawable) {
-        layersList.at(targetedLayer).texture.draw(drawable);
+        render(drawable, sf::RenderStates::Default);
+    }
+
+    void renderer::render(const sf::Drawable &drawable, const sf::RenderStates& states) {
+        if (recording) {
+            auto blend = recordBlendMode(states.blendMode);
+            auto transform = recordTransform(states.transform);
+
+            auto& cmd = recordCommand(draw_command::Drawable);
+            cmd.drawable = &drawable;
+            cmd.texture = states.texture;
+            cmd.blend = blend;
+            cmd.transform = transform;
+            return;
+        }
+
+        target->flush();
+        target->texture.draw(drawable, states);
+        ++target->drawCalls;
+    }
+
+    void renderer::renderVertices(span<const sf::Vertex> triangles, const sf::Texture* texture) {
+        if (triangles.empty()) {
+            return;
+        }
+
+        if (recording) {
+            auto& out = geometryOutput(texture);
+            auto first = out.size();
+            out.insert(out.end(), triangles.begin(), triangles.end());
+            commitGeometry(first, texture);
+            return;
+        }
+
+        auto& layer = *target;
+        layer.flush();
+        layer.texture.draw(triangles.data(), triangles.size(), sf::Triangles, sf::RenderStates(texture));
+        ++layer.drawCalls;
+        layer.drawnVertices += to<uint32_t>(triangles.size());
+    }
+
+    sf::FloatRect renderer::getVisibleArea() {
+        if (target->visibleDirty) {
+            target->updateVisibleArea(output->getSize());
+        }
+
+        return { target->visibleMin, target->visibleMax - target->visibleMin };
+    }
+
+    std::size_t renderer::cullBatch(span<const math::vec2df> positions, span<const float> radii, std::vector<uint32_t>& visible) {
+        if (target->visibleDirty) {
+            target->updateVisibleArea(output->getSize());
+        }
+
+        const auto count = std::min(positions.size(), radii.size());
+        const auto before = visible.size();
+        const auto min = target->visibleMin;
+        const auto max = target->visibleMax;
+
+        std::size_t i = 0;
+
+#ifdef ARTI_SIMD_SSE2
+        // Same comparisons as isVisible, x >= min - r and x <= max + r, so both agree on the edges
+        const auto minX = _mm_set1_ps(min.x);
+        const auto minY = _mm_set1_ps(min.y);
+        const auto maxX = _mm_set1_ps(max.x);
+        const auto maxY = _mm_set1_ps(max.y);
+
+        for (; i + 4 <= count; i += 4) {
+            __m128 xs, ys;
+            loadPositions(positions.data(), i, xs, ys);
+            auto rs = _mm_loadu_ps(radii.data() + i);
+
+            auto inside = _mm_and_ps(
+                    _mm_and_ps(_mm_cmpge_ps(xs, _mm_sub_ps(minX, rs)), _mm_cmple_ps(xs, _mm_add_ps(maxX, rs))),
+                    _mm_and_ps(_mm_cmpge_ps(ys, _mm_sub_ps(minY, rs)), _mm_cmple_ps(ys, _mm_add_ps(maxY, rs)))
+            );
+            pushVisible(inside, i, visible);
+        }
+#endif
+
+        for (; i < count; ++i) {
+            const auto& p = positions[i];
+            const auto r = radii[i];
+            if (p.x >= min.x - r && p.x <= max.x + r && p.y >= min.y - r && p.y <= max.y + r) {
+                visible.push_back(to<uint32_t>(i));
+            }
+        }
+
+        return visible.size() - before;
+    }
+
+    std::size_t renderer::cullBatch(span<const math::vec2df> positions, float radius, std::vector<uint32_t>& visible) {
+        if (target->visibleDirty) {
+            target->updateVisibleArea(output->getSize());
+        }
+
+        const auto before = visible.size();
+        const auto min = target->visibleMin - radius;
+        const auto max = target->visibleMax + radius;
+
+        std::size_t i = 0;
+
+#ifdef ARTI_SIMD_SSE2
+        const auto minX = _mm_set1_ps(min.x);
+        const auto minY = _mm_set1_ps(min.y);
+        const auto maxX = _mm_set1_ps(max.x);
+        const auto maxY = _mm_set1_ps(max.y);
+
+        for (; i + 4 <= positions.size(); i += 4) {
+            __m128 xs, ys;
+            loadPositions(positions.data(), i, xs, ys);
+
+            auto inside = _mm_and_ps(
+                    _mm_and_ps(_mm_cmpge_ps(xs, minX), _mm_cmple_ps(xs, maxX)),
+                    _mm_and_ps(_mm_cmpge_ps(ys, minY), _mm_cmple_ps(ys, maxY))
+            );
+            pushVisible(inside, i, visible);
+        }
+#endif
+
+        for (; i < positions.size(); ++i) {
+            const auto& p = positions[i];
+            if (p.x >= min.x && p.x <= max.x && p.y >= min.y && p.y <= max.y) {
+                visible.push_back(to<uint32_t>(i));
+            }
+        }
+
+        return visible.size() - before;
     }
 
-    bool renderer::isVisible(const math::vec2df &world_pos, float radius) {
-        auto sup_left = screenToView(layerToScreen({0, 0}));
-        auto inf_right = screenToView(layerToScreen(to<math::vec2df>(getLayerSize())));
-        auto window_limit = screenToView(window.getSize());
-        if (inf_right.y > window_limit.y) {
-            inf_right = window_limit;
+    void renderer::invalidateVisibleAreas() {
+        for (auto layer : drawOrder) {
+            layer->visibleDirty = true;
         }
-        auto box = (math::vec2df{radius, radius});
-        return world_pos >= (sup_left - box) && world_pos <= (inf_right + box);
     }
 
 }
\ No newline at end of file
@@ -0,0 +1,681 @@
+//
+// Created by Alcachofa
+//
+
+#include <scene_graph.hpp>
+
+#include <array>
+#include <cmath>
+
+#include <utils/utils.hpp>
+#include <utils/logger.hpp>
+#include <utils/trace.hpp>
+
+namespace arti {
+
+    namespace {
+
+        // Same tessellation as the renderer circles
+        constexpr std::size_t circlePointCount = 30;
+
+        const std::array<math::vec2df, circlePointCount>& unitCircle() {
+            static const auto points = [] {
+                std::array<math::vec2df, circlePointCount> pts;
+                for (std::size_t i = 0; i < circlePointCount; ++i) {
+                    auto angle = to<float>(to<math::real>(i) * 2.0 * math::PI / circlePointCount - math::PI / 2.0);
+                    pts[i] = { std::cos(angle), std::sin(angle) };
+                }
+                return pts;
+            }();
+            return points;
+        }
+
+        void pushQuad(std::vector<sf::Vertex>& out, const math::vec2df& a, const math::vec2df& b, const math::vec2df& c, const math::vec2df& d, const sf::Color& color) {
+            out.emplace_back(a, color);
+            out.emplace_back(b, color);
+            out.emplace_back(c, color);
+            out.emplace_back(a, color);
+            out.emplace_back(c, color);
+            out.emplace_back(d, color);
+        }
+
+        void pushRectangle(std::vector<sf::Vertex>& out, const math::vec2df& size, float borderThickness, const sf::Color& fillColor, const sf::Color& borderColor) {
+            const std::array<math::vec2df, 4> inner = {
+                    math::vec2df{ 0.0f, 0.0f },
+                    math::vec2df{ size.x, 0.0f },
+                    math::vec2df{ size.x, size.y },
+                    math::vec2df{ 0.0f, size.y }
+            };
+
+            pushQuad(out, inner[0], inner[1], inner[2], inner[3], fillColor);
+
+            if (borderThickness != 0.0f) {
+                const std::array<math::vec2df, 4> outer = {
+                        math::vec2df{ -borderThickness, -borderThickness },
+                        math::vec2df{ size.x + borderThickness, -borderThickness },
+                        math::vec2df{ size.x + borderThickness, size.y + borderThickness },
+                        math::vec2df{ -borderThickness, size.y + borderThickness }
+                };
+
+                for (std::size_t i = 0; i < 4; ++i) {
+                    auto next = (i + 1) % 4;
+                    pushQuad(out, inner[i], outer[i], outer[next], inner[next], borderColor);
+                }
+            }
+        }
+
+        void pushCircle(std::vector<sf::Vertex>& out, float radius, float borderThickness, const sf::Color& fillColor, const sf::Color& borderColor) {
+            const auto& unit = unitCircle();
+            const math::vec2df center(0.0f, 0.0f);
+
+            for (std::size_t i = 0; i < circlePointCount; ++i) {
+                const auto& p0 = unit[i];
+                const auto& p1 = unit[(i + 1) % circlePointCount];
+                out.emplace_back(center, fillColor);
+                out.emplace_back(p0 * radius, fillColor);
+                out.emplace_back(p1 * radius, fillColor);
+            }
+
+            if (borderThickness != 0.0f) {
+                const auto outer = radius + borderThickness;
+                for (std::size_t i = 0; i < circlePointCount; ++i) {
+                    const auto& p0 = unit[i];
+                    const auto& p1 = unit[(i + 1) % circlePointCount];
+                    pushQuad(out, p0 * radius, p0 * outer, p1 * outer, p1 * radius, borderColor);
+                }
+            }
+        }
+
+    }
+
+    scene_graph::scene_graph()
+            : layoutDirty(true),
+              nodeCount(0),
+              layer(renderer::invalidLayer),
+              updatedNodes(0) {
+        auto& root = nodes.emplace_back();
+        root.alive = true;
+    }
+
+    scene_graph::node_id scene_graph::getRoot() const {
+        return makeId(0);
+    }
+
+    scene_graph::node_id scene_graph::createNode(node_id parent) {
+        if (findNode(parent) == nullptr) {
+            logger::error("Couldn't create a scene node under {}, it doesn't exist", parent);
+            return invalidNode;
+        }
+
+        uint32_t slot;
+        if (! freeSlots.empty()) {
+            slot = freeSlots.back();
+            freeSlots.pop_back();
+        }
+        else if (nodes.size() <= slotMask) {
+            slot = to<uint32_t>(nodes.size());
+            nodes.emplace_back();
+        }
+        else {
+            logger::error("Couldn't create a scene node, the graph is full");
+            return invalidNode;
+        }
+
+        auto& n = nodes[slot];
+        auto generation = n.generation;
+        n = node();
+        n.generation = generation;
+        n.alive = true;
+        n.geometryDirty = true;
+
+        link(slot, parent & slotMask);
+        markDirty(slot);
+        layoutDirty = true;
+        ++nodeCount;
+
+        return makeId(slot);
+    }
+
+    scene_graph::node_id scene_graph::createNode() {
+        return createNode(getRoot());
+    }
+
+    bool scene_graph::destroyNode(node_id id) {
+        if (findNode(id) == nullptr) {
+            logger::error("Couldn't destroy scene node {}, it doesn't exist", id);
+            return false;
+        }
+
+        const auto slot = id & slotMask;
+
+        if (slot == 0) {
+            logger::error("Couldn't destroy the scene root");
+            return false;
+        }
+
+        unlink(slot);
+
+        stack.clear();
+        stack.push_back(slot);
+
+        while (! stack.empty()) {
+            auto current = stack.back();
+            stack.pop_back();
+
+            auto& n = nodes[current];
+            for (auto child = n.firstChild; child != noSlot; child = nodes[child].nextSibling) {
+                stack.push_back(child);
+            }
+
+            n.alive = false;
+            n.placed = false;
+            ++n.generation;
+            n.geometry.clear();
+
+            freeSlots.push_back(current);
+            --nodeCount;
+        }
+
+        layoutDirty = true;
+        return true;
+    }
+
+    bool scene_graph::isNodeValid(node_id id) const {
+        return findNode(id) != nullptr;
+    }
+
+    bool scene_graph::setParent(node_id id, node_id parent) {
+        if (findNode(id) == nullptr || findNode(parent) == nullptr) {
+            logger::error("Couldn't move scene node {} under {}, one of them doesn't exist", id, parent);
+            return false;
+        }
+
+        const auto slot = id & slotMask;
+
+        if (slot == 0) {
+            logger::error("Couldn't move the scene root");
+            return false;
+        }
+
+        for (auto ancestor = parent & slotMask; ancestor != noSlot; ancestor = nodes[ancestor].parent) {
+            if (ancestor == slot) {
+                logger::error("Couldn't move scene node {} under {}, it's one of its descendants", id, parent);
+                return false;
+            }
+        }
+
+        unlink(slot);
+        link(slot, parent & slotMask);
+        markDirty(slot);
+        layoutDirty = true;
+        return true;
+    }
+
+    scene_graph::node_id scene_graph::getParent(node_id id) const {
+        const auto* n = findNode(id);
+        return n != nullptr && n->parent != noSlot ? makeId(n->parent) : invalidNode;
+    }
+
+    bool scene_graph::setPosition(node_id id, const math::vec2df& position) {
+        auto* n = findNode(id);
+
+        if (n == nullptr) {
+            logger::error("Couldn't move scene node {}, it doesn't exist", id);
+            return false;
+        }
+
+        n->local.setPosition(position);
+        markDirty(id & slotMask);
+        return true;
+    }
+
+    bool scene_graph::setRotation(node_id id, float rotation) {
+        auto* n = findNode(id);
+
+        if (n == nullptr) {
+            logger::error("Couldn't rotate scene node {}, it doesn't exist", id);
+            return false;
+        }
+
+        n->local.setRotation(rotation);
+        markDirty(id & slotMask);
+        return true;
+    }
+
+    bool scene_graph::setScale(node_id id, const math::vec2df& scale) {
+        auto* n = findNode(id);
+
+        if (n == nullptr) {
+            logger::error("Couldn't scale scene node {}, it doesn't exist", id);
+            return false;
+        }
+
+        n->local.setScale(scale);
+        markDirty(id & slotMask);
+        return true;
+    }
+
+    bool scene_graph::setOrigin(node_id id, const math::vec2df& origin) {
+        auto* n = findNode(id);
+
+        if (n == nullptr) {
+            logger::error("Couldn't set the origin of scene node {}, it doesn't exist", id);
+            return false;
+        }
+
+        n->local.setOrigin(origin);
+        markDirty(id & slotMask);
+        return true;
+    }
+
+    math::vec2df scene_graph::getPosition(node_id id) const {
+        const auto* n = findNode(id);
+        return n != nullptr ? math::vec2df(n->local.getPosition()) : math::vec2df(0.0f, 0.0f);
+    }
+
+    float scene_graph::getRotation(node_id id) const {
+        const auto* n = findNode(id);
+        return n != nullptr ? n->local.getRotation() : 0.0f;
+    }
+
+    math::vec2df scene_graph::getScale(node_id id) const {
+        const auto* n = findNode(id);
+        return n != nullptr ? math::vec2df(n->local.getScale()) : math::vec2df(1.0f, 1.0f);
+    }
+
+    bool scene_graph::setVisible(node_id id, bool visible) {
+        auto* n = findNode(id);
+
+        if (n == nullptr) {
+            logger::error("Couldn't change the visibility of scene node {}, it doesn't exist", id);
+            return false;
+        }
+
+        if (n->visible != visible) {
+            n->visible = visible;
+            layoutDirty = true;
+        }
+
+        return true;
+    }
+
+    bool scene_graph::isVisible(node_id id) const {
+        const auto* n = findNode(id);
+        return n != nullptr && n->visible;
+    }
+
+    bool scene_graph::setRectangle(node_id id, const math::vec2df& size, const pixel& fillColor, float borderThickness, const pixel& borderColor) {
+        shape payload;
+        payload.kind = shape::Rectangle;
+        payload.size = size;
+        payload.thickness = borderThickness;
+        payload.fillColor = fillColor;
+        payload.borderColor = borderColor;
+        return setShape(id, payload);
+    }
+
+    bool scene_graph::setCircle(node_id id, float radius, const pixel& fillColor, float borderThickness, const pixel& borderColor) {
+        shape payload;
+        payload.kind = shape::Circle;
+        payload.radius = radius;
+        payload.thickness = borderThickness;
+        payload.fillColor = fillColor;
+        payload.borderColor = borderColor;
+        return setShape(id, payload);
+    }
+
+    bool scene_graph::setLine(node_id id, const math::vec2df& end, float thickness, const pixel& color) {
+        shape payload;
+        payload.kind = shape::Line;
+        payload.size = end;
+        payload.thickness = thickness;
+        payload.fillColor = color;
+        return setShape(id, payload);
+    }
+
+    bool scene_graph::setSprite(node_id id, renderer::texture_id texture, const pixel& tint) {
+        shape payload;
+        payload.kind = shape::Sprite;
+        payload.texture = texture;
+        payload.fillColor = tint;
+        return setShape(id, payload);
+    }
+
+    bool scene_graph::clearShape(node_id id) {
+        return setShape(id, shape());
+    }
+
+    math::vec2df scene_graph::nodeToWorld(node_id id, const math::vec2df& point) const {
+        const auto* n = findNode(id);
+        return n != nullptr ? math::vec2df(n->world.transformPoint(point)) : point;
+    }
+
+    void scene_graph::clear() {
+        while (nodes[0].firstChild != noSlot) {
+            destroyNode(makeId(nodes[0].firstChild));
+        }
+    }
+
+    std::size_t scene_graph::size() const {
+        return nodeCount;
+    }
+
+    void scene_graph::update(const renderer& graphics) {
+        updatedNodes = 0;
+
+        if (! layoutDirty) {
+            for (auto slot : dirtyNodes) {
+                if (! refresh(graphics, slot)) {
+                    layoutDirty = true;
+                    break;
+                }
+            }
+        }
+
+        if (layoutDirty) {
+            layout(graphics);
+        }
+
+        dirtyNodes.clear();
+    }
+
+    void scene_graph::render(renderer& graphics) {
+        ARTI_TRACE_SCOPE("scene_graph::render");
+
+        update(graphics);
+
+        if (runs.empty()) {
+            return;
+        }
+
+        const auto previous = graphics.getTargetedLayer();
+        const bool switched = layer != renderer::invalidLayer && layer != previous && graphics.setTargetedLayer(layer);
+
+        for (const auto& r : runs) {
+            graphics.renderVertices(span<const sf::Vertex>(vertices.data() + r.first, r.count), r.texture);
+        }
+
+        if (switched) {
+            graphics.setTargetedLayer(previous);
+        }
+    }
+
+    void scene_graph::setLayer(renderer::layer_id id) {
+        layer = id;
+    }
+
+    renderer::layer_id scene_graph::getLayer() const {
+        return layer;
+    }
+
+    uint32_t scene_graph::getUpdatedNodes() const {
+        return updatedNodes;
+    }
+
+    std::size_t scene_graph::getRunCount() const {
+        return runs.size();
+    }
+
+    scene_graph::node* scene_graph::findNode(node_id id) {
+        return const_cast<node*>(static_cast<const scene_graph*>(this)->findNode(id));
+    }
+
+    const scene_graph::node* scene_graph::findNode(node_id id) const {
+        const auto slot = id & slotMask;
+
+        if (id == invalidNode || slot >= nodes.size()) {
+            return nullptr;
+        }
+
+        const auto& n = nodes[slot];
+        return n.alive && n.generation == to<uint8_t>(id >> 24u) ? &n : nullptr;
+    }
+
+    scene_graph::node_id scene_graph::makeId(uint32_t slot) const {
+        return (to<node_id>(nodes[slot].generation) << 24u) | slot;
+    }
+
+    void scene_graph::link(uint32_t slot, uint32_t parent) {
+        auto& n = nodes[slot];
+        auto& p = nodes[parent];
+
+        n.parent = parent;
+        n.previousSibling = p.lastChild;
+        n.nextSibling = noSlot;
+
+        if (p.lastChild != noSlot) {
+            nodes[p.lastChild].nextSibling = slot;
+        }
+        else {
+            p.firstChild = slot;
+        }
+
+        p.lastChild = slot;
+    }
+
+    void scene_graph::unlink(uint32_t slot) {
+        auto& n = nodes[slot];
+        auto& p = nodes[n.parent];
+
+        if (n.previousSibling != noSlot) {
+            nodes[n.previousSibling].nextSibling = n.nextSibling;
+        }
+        else {
+            p.firstChild = n.nextSibling;
+        }
+
+        if (n.nextSibling != noSlot) {
+            nodes[n.nextSibling].previousSibling = n.previousSibling;
+        }
+        else {
+            p.lastChild = n.previousSibling;
+        }
+
+        n.parent = n.previousSibling = n.nextSibling = noSlot;
+    }
+
+    void scene_graph::markDirty(uint32_t slot) {
+        auto& n = nodes[slot];
+
+        if (! n.dirty) {
+            n.dirty = true;
+            dirtyNodes.push_back(slot);
+        }
+    }
+
+    bool scene_graph::setShape(node_id id, const shape& payload) {
+        auto* n = findNode(id);
+
+        if (n == nullptr) {
+            logger::error("Couldn't set the shape of scene node {}, it doesn't exist", id);
+            return false;
+        }
+
+        if ((id & slotMask) == 0) {
+            logger::error("Couldn't set the shape of the scene root");
+            return false;
+        }
+
+        n->payload = payload;
+        n->geometryDirty = true;
+        markDirty(id & slotMask);
+        return true;
+    }
+
+    void scene_graph::buildGeometry(const renderer& graphics, node& n) {
+        const auto& s = n.payload;
+
+        n.geometry.clear();
+        n.texture = nullptr;
+        n.geometryDirty = false;
+
+        switch (s.kind) {
+            case shape::None:
+                break;
+
+            case shape::Rectangle:
+                pushRectangle(n.geometry, s.size, s.thickness, s.fillColor, s.borderColor);
+                break;
+
+            case shape::Circle:
+                pushCircle(n.geometry, s.radius, s.thickness, s.fillColor, s.borderColor);
+                break;
+
+            case shape::Line: {
+                if (s.size.x == 0.0f && s.size.y == 0.0f) {
+                    break;
+                }
+
+                const auto perpendicular = s.size.perpendicular().normalize() * s.thickness * 0.5;
+                const math::vec2df start(0.0f, 0.0f);
+                pushQuad(n.geometry, start + perpendicular, start - perpendicular, s.size - perpendicular, s.size + perpendicular, s.fillColor);
+                break;
+            }
+
+            case shape::Sprite: {
+                const auto& atlas = graphics.getTextureAtlas();
+
+                if (! atlas.isValid(s.texture)) {
+                    logger::error("Couldn't draw texture {} on a scene node, it isn't loaded", s.texture);
+                    break;
+                }
+
+                const auto& region = atlas.getRegion(s.texture);
+                const auto left = to<float>(region.rect.left);
+                const auto top = to<float>(region.rect.top);
+                const auto width = to<float>(region.rect.width);
+                const auto height = to<float>(region.rect.height);
+
+                const sf::Vector2f corners[4] = { { 0.0f, 0.0f }, { width, 0.0f }, { width, height }, { 0.0f, height } };
+                const std::size_t order[6] = { 0, 1, 2, 0, 2, 3 };
+
+                for (auto i : order) {
+                    n.geometry.emplace_back(corners[i], s.fillColor, sf::Vector2f(left + corners[i].x, top + corners[i].y));
+                }
+
+                n.texture = &atlas.getPage(region.page);
+                break;
+            }
+        }
+    }
+
+    void scene_graph::writeVertices(const node& n) {
+        auto* out = vertices.data() + n.first;
+
+        for (std::size_t i = 0; i < n.geometry.size(); ++i) {
+            const auto& v = n.geometry[i];
+            out[i] = sf::Vertex(n.world.transformPoint(v.position), v.color, v.texCoords);
+        }
+    }
+
+    void scene_graph::layout(const renderer& graphics) {
+        vertices.clear();
+        runs.clear();
+
+        for (auto& n : nodes) {
+            n.placed = false;
+            n.dirty = false;
+        }
+
+        stack.clear();
+        if (nodes[0].visible) {
+            stack.push_back(0);
+        }
+
+        while (! stack.empty()) {
+            auto slot = stack.back();
+            stack.pop_back();
+
+            auto& n = nodes[slot];
+            n.placed = true;
+            n.world = n.parent != noSlot ? nodes[n.parent].world * n.local.getTransform() : n.local.getTransform();
+
+            if (n.geometryDirty) {
+                buildGeometry(graphics, n);
+            }
+
+            n.first = to<uint32_t>(vertices.size());
+
+            if (! n.geometry.empty()) {
+                const auto count = to<uint32_t>(n.geometry.size());
+                vertices.resize(vertices.size() + count);
+                writeVertices(n);
+
+                if (! runs.empty() && runs.back().texture == n.texture) {
+                    runs.back().count += count;
+                }
+                else {
+                    runs.push_back({ n.texture, n.first, count });
+                }
+            }
+
+            ++updatedNodes;
+
+            // Pushed last to first, so they come out in order
+            for (auto child = n.lastChild; child != noSlot; child = nodes[child].previousSibling) {
+                if (nodes[child].visible) {
+                    stack.push_back(child);
+                }
+            }
+        }
+
+        layoutDirty = false;
+    }
+
+    bool scene_graph::refresh(const renderer& graphics, uint32_t slot) {
+        auto& start = nodes[slot];
+
+        if (! start.alive || ! start.dirty) {
+            return true;
+        }
+
+        // Hidden, the layout that shows it again computes it
+        if (! start.placed) {
+            start.dirty = false;
+            return true;
+        }
+
+        // A dirty ancestor recomputes this subtree when its turn comes
+        for (auto ancestor = start.parent; ancestor != noSlot; ancestor = nodes[ancestor].parent) {
+            if (nodes[ancestor].dirty) {
+                return true;
+            }
+        }
+
+        stack.clear();
+        stack.push_back(slot);
+
+        while (! stack.empty()) {
+            auto current = stack.back();
+            stack.pop_back();
+
+            auto& n = nodes[current];
+            n.dirty = false;
+            n.world = n.parent != noSlot ? nodes[n.parent].world * n.local.getTransform() : n.local.getTransform();
+
+            if (n.geometryDirty) {
+                const auto count = n.geometry.size();
+                const auto* texture = n.texture;
+
+                buildGeometry(graphics, n);
+
+                // The shape no longer fits its place or its run
+                if (n.geometry.size() != count || n.texture != texture) {
+                    return false;
+                }
+            }
+
+            writeVertices(n);
+            ++updatedNodes;
+
+            for (auto child = n.firstChild; child != noSlot; child = nodes[child].nextSibling) {
+                if (nodes[child].placed) {
+                    stack.push_back(child);
+                }
+            }
+        }
+
+        return true;
+    }
+
+}
@@ -0,0 +1,45 @@
+//
+// Created by Alcachofa
+//
+
+#pragma once
+
+#include <array>
+#include <cmath>
+
+#include <math/vec2d.hpp>
+
+#include <constants/math.hpp>
+
+#include <utils/utils.hpp>
+
+// Shape helpers shared by the renderer and the software rasterizer, so both place
+// shapes the same way. Internal, not installed with the public headers
+namespace arti::shape_geometry {
+
+    // Corners of a rectangle rotated (in degrees) around its top-left corner, like sf::RectangleShape
+    inline std::array<math::vec2df, 4> rectCorners(const math::vec2df& coords, const math::vec2df& min, const math::vec2df& max, float rotation) {
+        std::array<math::vec2df, 4> corners = {
+                math::vec2df{ min.x, min.y },
+                math::vec2df{ max.x, min.y },
+                math::vec2df{ max.x, max.y },
+                math::vec2df{ min.x, max.y }
+        };
+
+        if (rotation != 0.0f) {
+            auto angle = to<float>(rotation * math::toRads);
+            auto c = std::cos(angle);
+            auto s = std::sin(angle);
+            for (auto& corner : corners) {
+                corner = { corner.x * c - corner.y * s, corner.x * s + corner.y * c };
+            }
+        }
+
+        for (auto& corner : corners) {
+            corner += coords;
+        }
+
+        return corners;
+    }
+
+}
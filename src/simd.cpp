@@ -0,0 +1,42 @@
+//
+// Created by Alcachofa
+//
+
+#include <utils/simd.hpp>
+
+#include <algorithm>
+
+namespace arti::simd {
+
+    namespace {
+
+        level& currentLevel() {
+            static level current = bestLevel();
+            return current;
+        }
+
+    }
+
+    level bestLevel() {
+#ifdef ARTI_SIMD_AVX2
+        if (hasAVX2()) {
+            return level::AVX2;
+        }
+#endif
+#ifdef ARTI_SIMD_SSE2
+        return level::SSE2;
+#else
+        return level::Scalar;
+#endif
+    }
+
+    level activeLevel() {
+        return currentLevel();
+    }
+
+    level setLevel(level forced) {
+        currentLevel() = std::min(forced, bestLevel());
+        return activeLevel();
+    }
+
+}
@@ -0,0 +1,347 @@
+//
+// Created by Alcachofa
+//
+
+#include <software_rasterizer.hpp>
+
+#include <cmath>
+#include <thread>
+#include <limits>
+#include <algorithm>
+
+#include <pixel_ops.hpp>
+
+#include <utils/logger.hpp>
+
+#include "shape_geometry.hpp"
+
+namespace arti {
+
+    namespace {
+
+        using shape_geometry::rectCorners;
+
+        // Keeps float extents representable once they are turned into rows
+        constexpr float rowLimit = 1.0e9f;
+
+        // Horizontal extent of a convex quad at height y, false if the row misses it
+        bool quadSpan(const std::array<math::vec2df, 4>& corners, float y, float& left, float& right) {
+            left = std::numeric_limits<float>::max();
+            right = std::numeric_limits<float>::lowest();
+
+            for (std::size_t i = 0; i < 4; ++i) {
+                const auto& a = corners[i];
+                const auto& b = corners[(i + 1) % 4];
+
+                if ((a.y <= y && b.y > y) || (b.y <= y && a.y > y)) {
+                    auto x = a.x + (y - a.y) * (b.x - a.x) / (b.y - a.y);
+                    left = std::min(left, x);
+                    right = std::max(right, x);
+                }
+            }
+
+            return left < right;
+        }
+
+    }
+
+    software_rasterizer::software_rasterizer(uint32_t threads)
+            : pixels(nullptr),
+              size(0, 0),
+              buffer(nullptr),
+              threadCount(1),
+              drawnMin(std::numeric_limits<float>::max(), std::numeric_limits<float>::max()),
+              drawnMax(std::numeric_limits<float>::lowest(), std::numeric_limits<float>::lowest()) {
+        setThreadCount(threads);
+    }
+
+    void software_rasterizer::setTarget(pixel_buffer& target) {
+        flush();
+        buffer = &target;
+        pixels = nullptr;
+        size = target.getSize();
+    }
+
+    void software_rasterizer::setTarget(span<pixel> target, const math::vec2di& targetSize) {
+        flush();
+
+        if (target.size() < to<std::size_t>(std::max(targetSize.x, 0)) * std::max(targetSize.y, 0)) {
+            logger::error("Rasterizer target of {} pixels is too small for {}", target.size(), targetSize.to_string());
+            buffer = nullptr;
+            pixels = nullptr;
+            size = { 0, 0 };
+            return;
+        }
+
+        buffer = nullptr;
+        pixels = target.data();
+        size = targetSize;
+    }
+
+    void software_rasterizer::setThreadCount(uint32_t threads) {
+        if (threads == 0) {
+            threads = std::max(std::thread::hardware_concurrency(), 1u);
+        }
+        threadCount = threads;
+        workers.setWorkerCount(threads - 1);
+    }
+
+    uint32_t software_rasterizer::getThreadCount() const {
+        return threadCount;
+    }
+
+    void software_rasterizer::clear(const pixel& color) {
+        // Nothing before a clear can show, so it doesn't have to be rasterized
+        shapes.clear();
+
+        shape s{};
+        s.type = shape::Clear;
+        s.color = color;
+        s.top = 0;
+        s.bottom = std::numeric_limits<int32_t>::max();
+        shapes.push_back(s);
+
+        drawnMin = { 0.0f, 0.0f };
+        drawnMax = { rowLimit, rowLimit };
+    }
+
+    void software_rasterizer::renderCircle(const math::vec2df& coords, float radius, const pixel& fillColor) {
+        shape s{};
+        s.type = shape::Circle;
+        s.color = fillColor;
+        s.center = coords;
+        s.outerRadius = radius;
+        record(s);
+    }
+
+    void software_rasterizer::renderCircle(const math::vec2df& coords, float radius, float borderThickness, const pixel& fillColor, const pixel& borderColor) {
+        renderCircle(coords, radius, fillColor);
+
+        if (borderThickness > 0.0f) {
+            shape s{};
+            s.type = shape::Ring;
+            s.color = borderColor;
+            s.center = coords;
+            s.innerRadius = radius;
+            s.outerRadius = radius + borderThickness;
+            record(s);
+        }
+    }
+
+    void software_rasterizer::renderRectangle(const math::vec2df& coords, const math::vec2df& rectSize, const pixel& fillColor, float rotation) {
+        pushQuad(rectCorners(coords, { 0.0f, 0.0f }, rectSize, rotation), fillColor);
+    }
+
+    void software_rasterizer::renderRectangle(const math::vec2df& coords, const math::vec2df& rectSize, float borderThickness, const pixel& fillColor, const pixel& borderColor, float rotation) {
+        auto inner = rectCorners(coords, { 0.0f, 0.0f }, rectSize, rotation);
+        pushQuad(inner, fillColor);
+
+        if (borderThickness > 0.0f) {
+            auto outer = rectCorners(coords, { -borderThickness, -borderThickness }, rectSize + borderThickness, rotation);
+            pushQuadRing(inner, outer, borderColor);
+        }
+    }
+
+    void software_rasterizer::renderSquare(const math::vec2df& coords, float sideSize, const pixel& fillColor, float rotation) {
+        renderRectangle(coords, { sideSize, sideSize }, fillColor, rotation);
+    }
+
+    void software_rasterizer::renderSquare(const math::vec2df& coords, float sideSize, float borderThickness, const pixel& fillColor, const pixel& borderColor, float rotation) {
+        renderRectangle(coords, { sideSize, sideSize }, borderThickness, fillColor, borderColor, rotation);
+    }
+
+    void software_rasterizer::renderLine(const math::vec2df& pointA, const math::vec2df& pointB, const pixel& color) {
+        // Same as the batched renderer, a hairline is a 1px wide quad
+        renderLine(pointA, pointB, 1.0f, color);
+    }
+
+    void software_rasterizer::renderLine(const math::vec2df& pointA, const math::vec2df& pointB, float thickness, const pixel& color) {
+        if (pointA.x == pointB.x && pointA.y == pointB.y) {
+            return;
+        }
+
+        math::vec2df perpendicular = (pointB - pointA).perpendicular().normalize() * (thickness * 0.5f);
+        pushQuad({ pointA + perpendicular, pointA - perpendicular, pointB - perpendicular, pointB + perpendicular }, color);
+    }
+
+    void software_rasterizer::flush() {
+        if (shapes.empty()) {
+            return;
+        }
+
+        if (buffer != nullptr) {
+            pixels = buffer->data();
+            size = buffer->getSize();
+        }
+
+        if (pixels != nullptr && size.x > 0 && size.y > 0) {
+            const int32_t strips = (size.y + stripHeight - 1) / stripHeight;
+
+            workers.run(to<std::size_t>(strips), [&](std::size_t strip) {
+                const auto top = to<int32_t>(strip) * stripHeight;
+                rasterize(top, std::min(top + stripHeight, size.y));
+            });
+
+            if (buffer != nullptr && drawnMin.x <= drawnMax.x && drawnMin.y <= drawnMax.y) {
+                auto left = to<int32_t>(std::max(std::floor(drawnMin.x), -1.0f));
+                auto top = to<int32_t>(std::max(std::floor(drawnMin.y), -1.0f));
+                auto right = to<int32_t>(std::min(std::ceil(drawnMax.x), to<float>(size.x))) + 1;
+                auto bottom = to<int32_t>(std::min(std::ceil(drawnMax.y), to<float>(size.y))) + 1;
+                buffer->markDirty({ left, top, right - left, bottom - top });
+            }
+        }
+
+        shapes.clear();
+        drawnMin = { std::numeric_limits<float>::max(), std::numeric_limits<float>::max() };
+        drawnMax = { std::numeric_limits<float>::lowest(), std::numeric_limits<float>::lowest() };
+    }
+
+    std::size_t software_rasterizer::getPendingShapes() const {
+        return shapes.size();
+    }
+
+    void software_rasterizer::record(const shape& s) {
+        if (s.color.a == 0) {
+            return;
+        }
+
+        math::vec2df min, max;
+        if (s.type == shape::Circle || s.type == shape::Ring) {
+            min = s.center - s.outerRadius;
+            max = s.center + s.outerRadius;
+        }
+        else {
+            const auto& corners = s.type == shape::PolygonRing ? s.outer : s.inner;
+            min = max = corners[0];
+            for (const auto& corner : corners) {
+                min = { std::min(min.x, corner.x), std::min(min.y, corner.y) };
+                max = { std::max(max.x, corner.x), std::max(max.y, corner.y) };
+            }
+        }
+
+        // Also drops NaN and infinite shapes
+        if (! (min.y > -rowLimit && max.y < rowLimit && min.x > -rowLimit && max.x < rowLimit)) {
+            return;
+        }
+
+        auto& recorded = shapes.emplace_back(s);
+        recorded.top = to<int32_t>(std::floor(min.y));
+        recorded.bottom = to<int32_t>(std::ceil(max.y)) + 1;
+
+        drawnMin = { std::min(drawnMin.x, min.x), std::min(drawnMin.y, min.y) };
+        drawnMax = { std::max(drawnMax.x, max.x), std::max(drawnMax.y, max.y) };
+    }
+
+    void software_rasterizer::pushQuad(const quad& corners, const pixel& color) {
+        shape s{};
+        s.type = shape::Polygon;
+        s.color = color;
+        s.inner = corners;
+        record(s);
+    }
+
+    void software_rasterizer::pushQuadRing(const quad& inner, const quad& outer, const pixel& color) {
+        shape s{};
+        s.type = shape::PolygonRing;
+        s.color = color;
+        s.inner = inner;
+        s.outer = outer;
+        record(s);
+    }
+
+    void software_rasterizer::rasterize(int32_t top, int32_t bottom) const {
+        for (const auto& s : shapes) {
+            if (s.bottom <= top || s.top >= bottom) {
+                continue;
+            }
+            rasterize(s, std::max(top, s.top), std::min(bottom, s.bottom));
+        }
+    }
+
+    void software_rasterizer::rasterize(const shape& s, int32_t top, int32_t bottom) const {
+        for (auto y = top; y < bottom; ++y) {
+            // Rows are sampled at the pixel centres
+            const auto rowY = to<float>(y) + 0.5f;
+
+            switch (s.type) {
+                case shape::Clear:
+                    std::fill_n(pixels + to<std::size_t>(y) * size.x, size.x, s.color);
+                    break;
+
+                case shape::Circle: {
+                    auto dy = rowY - s.center.y;
+                    auto squared = s.outerRadius * s.outerRadius - dy * dy;
+                    if (squared > 0.0f) {
+                        auto dx = std::sqrt(squared);
+                        fillSpan(y, s.center.x - dx, s.center.x + dx, s.color);
+                    }
+                    break;
+                }
+
+                case shape::Ring: {
+                    auto dy = rowY - s.center.y;
+                    auto outerSquared = s.outerRadius * s.outerRadius - dy * dy;
+                    if (outerSquared <= 0.0f) {
+                        break;
+                    }
+
+                    auto outer = std::sqrt(outerSquared);
+                    auto innerSquared = s.innerRadius * s.innerRadius - dy * dy;
+                    if (innerSquared > 0.0f) {
+                        auto inner = std::sqrt(innerSquared);
+                        fillSpan(y, s.center.x - outer, s.center.x - inner, s.color);
+                        fillSpan(y, s.center.x + inner, s.center.x + outer, s.color);
+                    }
+                    else {
+                        fillSpan(y, s.center.x - outer, s.center.x + outer, s.color);
+                    }
+                    break;
+                }
+
+                case shape::Polygon: {
+                    float left, right;
+                    if (quadSpan(s.inner, rowY, left, right)) {
+                        fillSpan(y, left, right, s.color);
+                    }
+                    break;
+                }
+
+                case shape::PolygonRing: {
+                    float outerLeft, outerRight;
+                    if (! quadSpan(s.outer, rowY, outerLeft, outerRight)) {
+                        break;
+                    }
+
+                    float innerLeft, innerRight;
+                    if (quadSpan(s.inner, rowY, innerLeft, innerRight)) {
+                        fillSpan(y, outerLeft, innerLeft, s.color);
+                        fillSpan(y, innerRight, outerRight, s.color);
+                    }
+                    else {
+                        fillSpan(y, outerLeft, outerRight, s.color);
+                    }
+                    break;
+                }
+            }
+        }
+    }
+
+    void software_rasterizer::fillSpan(int32_t y, float left, float right, const pixel& color) const {
+        // Covers the pixels whose centre is in [left, right), so spans that share an edge never overlap
+        auto first = std::max(to<int32_t>(std::ceil(std::max(left - 0.5f, -1.0f))), 0);
+        auto last = std::min(to<int32_t>(std::ceil(std::min(right - 0.5f, to<float>(size.x)))), size.x);
+
+        if (last <= first) {
+            return;
+        }
+
+        auto row = pixels + to<std::size_t>(y) * size.x;
+        if (color.a == 0xFF) {
+            std::fill(row + first, row + last, color);
+        }
+        else {
+            pixel_ops::blend({ row + first, to<std::size_t>(last - first) }, color);
+        }
+    }
+
+}
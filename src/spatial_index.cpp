@@ -0,0 +1,468 @@
+//
+// Created by Alcachofa
+//
+
+#include <spatial_index.hpp>
+
+#include <cmath>
+#include <algorithm>
+
+#include <renderer.hpp>
+
+#include <utils/utils.hpp>
+#include <utils/logger.hpp>
+
+namespace arti {
+
+    namespace {
+
+        // Keeps cell coordinates far from overflowing, NaN ends up in the lowest cell
+        constexpr float cellLimit = 1 << 30;
+
+        int32_t toCell(float coord) {
+            auto cell = std::floor(coord);
+            if (! (cell >= -cellLimit)) return to<int32_t>(-cellLimit);
+            if (cell > cellLimit) return to<int32_t>(cellLimit);
+            return to<int32_t>(cell);
+        }
+
+        inline bool touchesBox(const math::vec2df& position, float radius, const math::vec2df& min, const math::vec2df& max) {
+            return position.x + radius >= min.x && position.x - radius <= max.x &&
+                   position.y + radius >= min.y && position.y - radius <= max.y;
+        }
+
+        inline bool touchesCircle(const math::vec2df& position, float radius, const math::vec2df& center, float queryRadius) {
+            auto dx = position.x - center.x;
+            auto dy = position.y - center.y;
+            auto reach = radius + queryRadius;
+            return dx * dx + dy * dy <= reach * reach;
+        }
+
+        math::vec2df visibleMin(renderer& graphics) {
+            auto area = graphics.getVisibleArea();
+            return { area.left, area.top };
+        }
+
+        math::vec2df visibleMax(renderer& graphics) {
+            auto area = graphics.getVisibleArea();
+            return { area.left + area.width, area.top + area.height };
+        }
+
+    }
+
+    spatial_hash::spatial_hash(float cellSize)
+            : cellSize(cellSize > 0.0f ? cellSize : defaultCellSize),
+              inverseCellSize(1.0f / this->cellSize),
+              maxRadius(0.0f),
+              count(0) {}
+
+    bool spatial_hash::insert(uint32_t id, const math::vec2df& position, float radius) {
+        if (contains(id)) {
+            logger::error("Couldn't insert {} in the spatial hash, it's already there", id);
+            return false;
+        }
+
+        if (id >= entries.size()) {
+            entries.resize(to<std::size_t>(id) + 1, entry{ {}, 0.0f, 0, 0, false });
+        }
+
+        auto& e = entries[id];
+        e.position = position;
+        e.radius = std::max(radius, 0.0f);
+        e.alive = true;
+        maxRadius = std::max(maxRadius, e.radius);
+
+        link(id, cellKey(cellCoords(position)));
+        ++count;
+        return true;
+    }
+
+    bool spatial_hash::move(uint32_t id, const math::vec2df& position) {
+        if (! contains(id)) {
+            logger::error("Couldn't move {} in the spatial hash, it isn't there", id);
+            return false;
+        }
+
+        auto& e = entries[id];
+        e.position = position;
+
+        auto cell = cellKey(cellCoords(position));
+        if (cell != e.cell) {
+            unlink(id);
+            link(id, cell);
+        }
+
+        return true;
+    }
+
+    bool spatial_hash::remove(uint32_t id) {
+        if (! contains(id)) {
+            logger::error("Couldn't remove {} from the spatial hash, it isn't there", id);
+            return false;
+        }
+
+        unlink(id);
+        entries[id].alive = false;
+        --count;
+        return true;
+    }
+
+    bool spatial_hash::contains(uint32_t id) const {
+        return id < entries.size() && entries[id].alive;
+    }
+
+    math::vec2df spatial_hash::getPosition(uint32_t id) const {
+        return contains(id) ? entries[id].position : math::vec2df();
+    }
+
+    void spatial_hash::clear() {
+        entries.clear();
+        cells.clear();
+        spareLists.clear();
+        count = 0;
+        maxRadius = 0.0f;
+    }
+
+    std::size_t spatial_hash::size() const {
+        return count;
+    }
+
+    float spatial_hash::getCellSize() const {
+        return cellSize;
+    }
+
+    std::size_t spatial_hash::queryRange(const math::vec2df& min, const math::vec2df& max, std::vector<uint32_t>& found) const {
+        return query(min, max, [&](const entry& e) {
+            return touchesBox(e.position, e.radius, min, max);
+        }, found);
+    }
+
+    std::size_t spatial_hash::queryRadius(const math::vec2df& center, float radius, std::vector<uint32_t>& found) const {
+        return query(center - radius, center + radius, [&](const entry& e) {
+            return touchesCircle(e.position, e.radius, center, radius);
+        }, found);
+    }
+
+    std::size_t spatial_hash::queryVisible(renderer& graphics, std::vector<uint32_t>& found) const {
+        return queryRange(visibleMin(graphics), visibleMax(graphics), found);
+    }
+
+    math::vec2di spatial_hash::cellCoords(const math::vec2df& position) const {
+        return { toCell(position.x * inverseCellSize), toCell(position.y * inverseCellSize) };
+    }
+
+    uint64_t spatial_hash::cellKey(const math::vec2di& coords) {
+        return (to<uint64_t>(static_cast<uint32_t>(coords.x)) << 32) | static_cast<uint32_t>(coords.y);
+    }
+
+    void spatial_hash::link(uint32_t id, uint64_t cell) {
+        auto [it, created] = cells.try_emplace(cell);
+        if (created && ! spareLists.empty()) {
+            it->second = std::move(spareLists.back());
+            spareLists.pop_back();
+        }
+
+        auto& list = it->second;
+        entries[id].cell = cell;
+        entries[id].slot = to<uint32_t>(list.size());
+        list.push_back(id);
+    }
+
+    void spatial_hash::unlink(uint32_t id) {
+        auto& e = entries[id];
+        auto cell = cells.find(e.cell);
+        auto& list = cell->second;
+
+        // Swap with the last one
+        auto last = list.back();
+        list[e.slot] = last;
+        entries[last].slot = e.slot;
+        list.pop_back();
+
+        // Empty cells are dropped so cells only ever holds occupied ones (the sparse query
+        // path walks all of them), their memory goes to the next new cell
+        if (list.empty()) {
+            if (spareLists.size() < maxSpareLists) {
+                spareLists.push_back(std::move(list));
+            }
+            cells.erase(cell);
+        }
+    }
+
+    template <typename Test>
+    std::size_t spatial_hash::query(const math::vec2df& min, const math::vec2df& max, Test test, std::vector<uint32_t>& found) const {
+        const auto before = found.size();
+
+        if (count == 0) {
+            return 0;
+        }
+
+        const auto low = cellCoords(min - maxRadius);
+        const auto high = cellCoords(max + maxRadius);
+
+        if (low.x > high.x || low.y > high.y) {
+            return 0;
+        }
+
+        auto testCell = [&](const std::vector<uint32_t>& list) {
+            for (auto id : list) {
+                if (test(entries[id])) {
+                    found.push_back(id);
+                }
+            }
+        };
+
+        const auto covered = (to<int64_t>(high.x) - low.x + 1) * (to<int64_t>(high.y) - low.y + 1);
+
+        // Big areas over a sparse world, walking the occupied cells is cheaper than looking up every covered one
+        if (covered > to<int64_t>(cells.size())) {
+            for (const auto& [key, list] : cells) {
+                const auto x = static_cast<int32_t>(key >> 32);
+                const auto y = static_cast<int32_t>(key & 0xFFFFFFFFu);
+                if (x >= low.x && x <= high.x && y >= low.y && y <= high.y) {
+                    testCell(list);
+                }
+            }
+        }
+        else {
+            for (auto y = low.y; y <= high.y; ++y) {
+                for (auto x = low.x; x <= high.x; ++x) {
+                    auto cell = cells.find(cellKey({ x, y }));
+                    if (cell != cells.end()) {
+                        testCell(cell->second);
+                    }
+                }
+            }
+        }
+
+        return found.size() - before;
+    }
+
+    loose_quadtree::loose_quadtree(const math::vec2df& worldMin, const math::vec2df& worldMax, uint32_t maxDepth)
+            : worldCenter((worldMin + worldMax) * 0.5f),
+              worldHalfSize(std::max(std::max(worldMax.x - worldMin.x, worldMax.y - worldMin.y) * 0.5f, 1.0f)),
+              maxDepth(std::min(maxDepth, 24u)),
+              count(0) {
+        createNode(worldCenter, worldHalfSize, 0, noNode);
+    }
+
+    bool loose_quadtree::insert(uint32_t id, const math::vec2df& position, float radius) {
+        if (contains(id)) {
+            logger::error("Couldn't insert {} in the quadtree, it's already there", id);
+            return false;
+        }
+
+        if (id >= entries.size()) {
+            entries.resize(to<std::size_t>(id) + 1, entry{ {}, 0.0f, noNode, 0, false });
+        }
+
+        auto& e = entries[id];
+        e.position = position;
+        e.radius = std::max(radius, 0.0f);
+        e.alive = true;
+
+        link(id, findNode(position, e.radius));
+        ++count;
+        return true;
+    }
+
+    bool loose_quadtree::move(uint32_t id, const math::vec2df& position) {
+        if (! contains(id)) {
+            logger::error("Couldn't move {} in the quadtree, it isn't there", id);
+            return false;
+        }
+
+        auto& e = entries[id];
+        e.position = position;
+
+        // Still inside a node it can't go any deeper from, the common case for small steps
+        const auto& current = nodes[e.node];
+        if (e.node != 0 && (current.depth == maxDepth || e.radius > current.halfSize * 0.5f) &&
+            std::abs(position.x - current.center.x) <= current.halfSize && std::abs(position.y - current.center.y) <= current.halfSize) {
+            return true;
+        }
+
+        auto target = findNode(position, e.radius);
+        if (target != e.node) {
+            unlink(id);
+            link(id, target);
+        }
+
+        return true;
+    }
+
+    bool loose_quadtree::remove(uint32_t id) {
+        if (! contains(id)) {
+            logger::error("Couldn't remove {} from the quadtree, it isn't there", id);
+            return false;
+        }
+
+        unlink(id);
+        entries[id].alive = false;
+        --count;
+        return true;
+    }
+
+    bool loose_quadtree::contains(uint32_t id) const {
+        return id < entries.size() && entries[id].alive;
+    }
+
+    math::vec2df loose_quadtree::getPosition(uint32_t id) const {
+        return contains(id) ? entries[id].position : math::vec2df();
+    }
+
+    void loose_quadtree::clear() {
+        nodes.clear();
+        entries.clear();
+        count = 0;
+        createNode(worldCenter, worldHalfSize, 0, noNode);
+    }
+
+    std::size_t loose_quadtree::size() const {
+        return count;
+    }
+
+    std::size_t loose_quadtree::getNodeCount() const {
+        return nodes.size();
+    }
+
+    std::size_t loose_quadtree::queryRange(const math::vec2df& min, const math::vec2df& max, std::vector<uint32_t>& found) const {
+        return query(min, max, true, [&](const entry& e) {
+            return touchesBox(e.position, e.radius, min, max);
+        }, found);
+    }
+
+    std::size_t loose_quadtree::queryRadius(const math::vec2df& center, float radius, std::vector<uint32_t>& found) const {
+        return query(center - radius, center + radius, false, [&](const entry& e) {
+            return touchesCircle(e.position, e.radius, center, radius);
+        }, found);
+    }
+
+    std::size_t loose_quadtree::queryVisible(renderer& graphics, std::vector<uint32_t>& found) const {
+        return queryRange(visibleMin(graphics), visibleMax(graphics), found);
+    }
+
+    int32_t loose_quadtree::createNode(const math::vec2df& center, float halfSize, uint32_t depth, int32_t parent) {
+        nodes.push_back(node{ center, halfSize, depth, parent, { noNode, noNode, noNode, noNode }, 0, {} });
+        return to<int32_t>(nodes.size() - 1);
+    }
+
+    int32_t loose_quadtree::findNode(const math::vec2df& position, float radius) {
+        const bool inside = position.x >= worldCenter.x - worldHalfSize && position.x <= worldCenter.x + worldHalfSize &&
+                            position.y >= worldCenter.y - worldHalfSize && position.y <= worldCenter.y + worldHalfSize;
+
+        if (! inside || radius > worldHalfSize) {
+            return 0;
+        }
+
+        int32_t current = 0;
+        for (uint32_t depth = 0; depth < maxDepth; ++depth) {
+            const auto childHalf = nodes[current].halfSize * 0.5f;
+            if (radius > childHalf) {
+                break;
+            }
+
+            const auto center = nodes[current].center;
+            const auto quadrant = (position.x >= center.x ? 1 : 0) | (position.y >= center.y ? 2 : 0);
+
+            auto child = nodes[current].children[quadrant];
+            if (child == noNode) {
+                const math::vec2df childCenter(center.x + (quadrant & 1 ? childHalf : -childHalf),
+                                               center.y + (quadrant & 2 ? childHalf : -childHalf));
+                child = createNode(childCenter, childHalf, depth + 1, current);
+                nodes[current].children[quadrant] = child;
+            }
+
+            current = child;
+        }
+
+        return current;
+    }
+
+    void loose_quadtree::link(uint32_t id, int32_t nodeIndex) {
+        auto& objects = nodes[nodeIndex].objects;
+        entries[id].node = nodeIndex;
+        entries[id].slot = to<uint32_t>(objects.size());
+        objects.push_back(id);
+
+        for (auto n = nodeIndex; n != noNode; n = nodes[n].parent) {
+            ++nodes[n].subtreeCount;
+        }
+    }
+
+    void loose_quadtree::unlink(uint32_t id) {
+        auto& e = entries[id];
+        auto& objects = nodes[e.node].objects;
+
+        auto last = objects.back();
+        objects[e.slot] = last;
+        entries[last].slot = e.slot;
+        objects.pop_back();
+
+        for (auto n = e.node; n != noNode; n = nodes[n].parent) {
+            --nodes[n].subtreeCount;
+        }
+    }
+
+    void loose_quadtree::collect(int32_t nodeIndex, std::vector<uint32_t>& found) const {
+        const auto& n = nodes[nodeIndex];
+        found.insert(found.end(), n.objects.begin(), n.objects.end());
+
+        for (auto child : n.children) {
+            if (child != noNode && nodes[child].subtreeCount > 0) {
+                collect(child, found);
+            }
+        }
+    }
+
+    template <typename Test>
+    std::size_t loose_quadtree::query(const math::vec2df& min, const math::vec2df& max, bool takeWhole, Test test, std::vector<uint32_t>& found) const {
+        const auto before = found.size();
+
+        // Depth first, at most three siblings wait per level
+        std::vector<int32_t> pending;
+        pending.reserve(3 * maxDepth + 4);
+        pending.push_back(0);
+
+        while (! pending.empty()) {
+            const auto index = pending.back();
+            pending.pop_back();
+
+            const auto& n = nodes[index];
+            if (n.subtreeCount == 0) {
+                continue;
+            }
+
+            // The root also holds whatever is outside the world, its bounds don't mean anything
+            if (index != 0) {
+                const auto reach = 2.0f * n.halfSize;
+                const math::vec2df looseMin(n.center.x - reach, n.center.y - reach);
+                const math::vec2df looseMax(n.center.x + reach, n.center.y + reach);
+
+                if (looseMax.x < min.x || looseMin.x > max.x || looseMax.y < min.y || looseMin.y > max.y) {
+                    continue;
+                }
+
+                if (takeWhole && looseMin.x >= min.x && looseMax.x <= max.x && looseMin.y >= min.y && looseMax.y <= max.y) {
+                    collect(index, found);
+                    continue;
+                }
+            }
+
+            for (auto id : n.objects) {
+                if (test(entries[id])) {
+                    found.push_back(id);
+                }
+            }
+
+            for (auto child : n.children) {
+                if (child != noNode) {
+                    pending.push_back(child);
+                }
+            }
+        }
+
+        return found.size() - before;
+    }
+
+}
@@ -0,0 +1,150 @@
+//
+// Created by Alcachofa
+//
+
+#include <texture_atlas.hpp>
+
+#include <string>
+#include <algorithm>
+
+#include <utils/utils.hpp>
+#include <utils/logger.hpp>
+
+// Same setup imgui_draw.cpp uses, the implementation stays private to this file
+#define STBRP_STATIC
+#define STB_RECT_PACK_IMPLEMENTATION
+#include <imgui/imstb_rectpack.h>
+
+namespace arti {
+
+    struct texture_atlas::page {
+        sf::Texture texture;
+        stbrp_context context;
+        std::vector<stbrp_node> nodes;
+    };
+
+    texture_atlas::texture_atlas(uint32_t pageSize)
+            : pageSize(std::min(pageSize, sf::Texture::getMaximumSize())),
+              smooth(false) {}
+
+    texture_atlas::~texture_atlas() = default;
+
+    texture_atlas::texture_id texture_atlas::add(const sf::Image& image) {
+        const auto size = image.getSize();
+
+        if (size.x == 0 || size.y == 0) {
+            logger::error("Couldn't add an empty image to the texture atlas");
+            return invalidTexture;
+        }
+
+        if (regions.size() >= invalidTexture) {
+            logger::error("Couldn't add image, the texture atlas is full");
+            return invalidTexture;
+        }
+
+        stbrp_rect rect{};
+        rect.w = to<stbrp_coord>(size.x + 2 * padding);
+        rect.h = to<stbrp_coord>(size.y + 2 * padding);
+
+        std::size_t pageIndex = 0;
+        for (; pageIndex < pages.size(); ++pageIndex) {
+            if (stbrp_pack_rects(&pages[pageIndex]->context, &rect, 1) && rect.was_packed) {
+                break;
+            }
+        }
+
+        if (pageIndex == pages.size()) {
+            auto created = createPage({ to<uint32_t>(rect.w), to<uint32_t>(rect.h) });
+            if (created == nullptr || ! stbrp_pack_rects(&created->context, &rect, 1)) {
+                logger::error("Couldn't fit a {}x{} image in the texture atlas", size.x, size.y);
+                return invalidTexture;
+            }
+        }
+
+        // Repeat the edges into the padding, clamping the source coordinates
+        sf::Image padded;
+        padded.create(to<uint32_t>(rect.w), to<uint32_t>(rect.h));
+        for (int32_t y = 0; y < rect.h; ++y) {
+            auto srcY = to<uint32_t>(std::clamp(y - padding, 0, to<int32_t>(size.y) - 1));
+            for (int32_t x = 0; x < rect.w; ++x) {
+                auto srcX = to<uint32_t>(std::clamp(x - padding, 0, to<int32_t>(size.x) - 1));
+                padded.setPixel(to<uint32_t>(x), to<uint32_t>(y), image.getPixel(srcX, srcY));
+            }
+        }
+
+        pages[pageIndex]->texture.update(padded, to<uint32_t>(rect.x), to<uint32_t>(rect.y));
+
+        regions.push_back({
+            to<uint16_t>(pageIndex),
+            sf::IntRect(rect.x + padding, rect.y + padding, to<int32_t>(size.x), to<int32_t>(size.y))
+        });
+
+        return to<texture_id>(regions.size() - 1);
+    }
+
+    texture_atlas::texture_id texture_atlas::add(std::string_view file) {
+        sf::Image image;
+
+        if (! image.loadFromFile(std::string(file))) {
+            logger::error("Couldn't load texture '{}'", file);
+            return invalidTexture;
+        }
+
+        return add(image);
+    }
+
+    bool texture_atlas::isValid(texture_id id) const {
+        return id < regions.size();
+    }
+
+    const texture_atlas::region& texture_atlas::getRegion(texture_id id) const {
+        return regions[id];
+    }
+
+    const sf::Texture& texture_atlas::getPage(uint16_t index) const {
+        return pages[index]->texture;
+    }
+
+    std::size_t texture_atlas::getTextureCount() const {
+        return regions.size();
+    }
+
+    std::size_t texture_atlas::getPageCount() const {
+        return pages.size();
+    }
+
+    void texture_atlas::setSmooth(bool enabled) {
+        smooth = enabled;
+        for (auto& p : pages) {
+            p->texture.setSmooth(smooth);
+        }
+    }
+
+    texture_atlas::page* texture_atlas::createPage(const sf::Vector2u& minSize) {
+        if (pages.size() >= std::numeric_limits<uint16_t>::max()) {
+            return nullptr;
+        }
+
+        const auto maxSize = sf::Texture::getMaximumSize();
+        const auto width = std::max(pageSize, minSize.x);
+        const auto height = std::max(pageSize, minSize.y);
+
+        if (width > maxSize || height > maxSize) {
+            return nullptr;
+        }
+
+        auto created = std::make_unique<page>();
+
+        if (! created->texture.create(width, height)) {
+            return nullptr;
+        }
+        created->texture.setSmooth(smooth);
+
+        created->nodes.resize(width);
+        stbrp_init_target(&created->context, to<int>(width), to<int>(height), created->nodes.data(), to<int>(created->nodes.size()));
+
+        pages.push_back(std::move(created));
+        return pages.back().get();
+    }
+
+}
@@ -0,0 +1,354 @@
+//
+// Created by Alcachofa
+//
+
+#include <tilemap.hpp>
+
+#include <cmath>
+#include <algorithm>
+
+#include <SFML/Graphics/RenderStates.hpp>
+
+#include <utils/utils.hpp>
+#include <utils/logger.hpp>
+#include <utils/trace.hpp>
+
+namespace arti {
+
+    tilemap::tilemap(const math::vec2di& mapSize, const math::vec2df& tileSize, int32_t chunkSize)
+            : mapSize(std::max(mapSize.x, 0), std::max(mapSize.y, 0)),
+              tileSize(tileSize),
+              chunkSize(std::max(chunkSize, 1)),
+              position(0.0f, 0.0f),
+              tilesetTexture(nullptr),
+              tileTexels(0, 0),
+              tilesetColumns(0),
+              tilesetTiles(0),
+              useBuffers(sf::VertexBuffer::isAvailable()),
+              layer(renderer::invalidLayer),
+              drawnChunks(0),
+              uploadedChunks(0) {
+        chunkCount = { (this->mapSize.x + this->chunkSize - 1) / this->chunkSize, (this->mapSize.y + this->chunkSize - 1) / this->chunkSize };
+
+        tiles.resize(to<std::size_t>(this->mapSize.x) * to<std::size_t>(this->mapSize.y));
+        chunks.resize(to<std::size_t>(chunkCount.x) * to<std::size_t>(chunkCount.y));
+
+        for (auto& c : chunks) {
+            c.buffer.setPrimitiveType(sf::Triangles);
+            c.buffer.setUsage(sf::VertexBuffer::Static);
+            c.filled = 0;
+            c.uploadQueued = false;
+        }
+
+        markAllDirty();
+    }
+
+    bool tilemap::setTileset(const renderer& graphics, renderer::texture_id tileset, const math::vec2di& tileTexels) {
+        const auto& atlas = graphics.getTextureAtlas();
+
+        if (! atlas.isValid(tileset)) {
+            logger::error("Couldn't set tileset {}, it isn't loaded", tileset);
+            return false;
+        }
+
+        const auto& region = atlas.getRegion(tileset);
+
+        if (tileTexels.x <= 0 || tileTexels.y <= 0 || tileTexels.x > region.rect.width || tileTexels.y > region.rect.height) {
+            logger::error("Couldn't cut {}x{} tiles from a {}x{} tileset", tileTexels.x, tileTexels.y, region.rect.width, region.rect.height);
+            return false;
+        }
+
+        tilesetTexture = &atlas.getPage(region.page);
+        tilesetRect = region.rect;
+        this->tileTexels = tileTexels;
+        tilesetColumns = region.rect.width / tileTexels.x;
+        tilesetTiles = tilesetColumns * (region.rect.height / tileTexels.y);
+
+        markAllDirty();
+        return true;
+    }
+
+    void tilemap::clearTileset() {
+        tilesetTexture = nullptr;
+        tilesetColumns = 0;
+        tilesetTiles = 0;
+        markAllDirty();
+    }
+
+    bool tilemap::setTile(const math::vec2di& coords, const tile& value) {
+        if (! isInside(coords)) {
+            return false;
+        }
+
+        if (! isValidIndex(value.index)) {
+            logger::error("Couldn't set tile {} at {}, the tileset has {} tiles", value.index, coords.to_string(), tilesetTiles);
+            return false;
+        }
+
+        auto& current = tiles[tileIndex(coords)];
+        auto& c = chunks[to<std::size_t>(coords.y / chunkSize) * to<std::size_t>(chunkCount.x) + to<std::size_t>(coords.x / chunkSize)];
+
+        if (current.index != emptyTile) --c.filled;
+        if (value.index != emptyTile) ++c.filled;
+
+        current = value;
+        markDirty(coords);
+        return true;
+    }
+
+    const tilemap::tile& tilemap::getTile(const math::vec2di& coords) const {
+        static const tile outside;
+        return isInside(coords) ? tiles[tileIndex(coords)] : outside;
+    }
+
+    bool tilemap::isInside(const math::vec2di& coords) const {
+        return coords.x >= 0 && coords.y >= 0 && coords.x < mapSize.x && coords.y < mapSize.y;
+    }
+
+    bool tilemap::fill(const tile& value) {
+        if (! isValidIndex(value.index)) {
+            logger::error("Couldn't fill with tile {}, the tileset has {} tiles", value.index, tilesetTiles);
+            return false;
+        }
+
+        std::fill(tiles.begin(), tiles.end(), value);
+
+        for (int32_t cy = 0; cy < chunkCount.y; ++cy) {
+            for (int32_t cx = 0; cx < chunkCount.x; ++cx) {
+                const auto width = std::min(chunkSize, mapSize.x - cx * chunkSize);
+                const auto height = std::min(chunkSize, mapSize.y - cy * chunkSize);
+                chunks[to<std::size_t>(cy) * to<std::size_t>(chunkCount.x) + to<std::size_t>(cx)].filled =
+                        value.index != emptyTile ? to<uint32_t>(width * height) : 0;
+            }
+        }
+
+        markAllDirty();
+        return true;
+    }
+
+    void tilemap::setPosition(const math::vec2df& position) {
+        this->position = position;
+    }
+
+    math::vec2df tilemap::getPosition() const {
+        return position;
+    }
+
+    math::vec2di tilemap::worldToTile(const math::vec2df& world) const {
+        return { to<int32_t>(std::floor((world.x - position.x) / tileSize.x)), to<int32_t>(std::floor((world.y - position.y) / tileSize.y)) };
+    }
+
+    math::vec2di tilemap::getSize() const {
+        return mapSize;
+    }
+
+    math::vec2df tilemap::getTileSize() const {
+        return tileSize;
+    }
+
+    int32_t tilemap::getChunkSize() const {
+        return chunkSize;
+    }
+
+    void tilemap::render(renderer& graphics) {
+        ARTI_TRACE_SCOPE("tilemap::render");
+
+        drawnChunks = 0;
+        uploadedChunks = 0;
+
+        if (chunks.empty()) {
+            return;
+        }
+
+        const auto previous = graphics.getTargetedLayer();
+        const bool switched = layer != renderer::invalidLayer && layer != previous && graphics.setTargetedLayer(layer);
+
+        // Visible chunk range, straight from the layer view
+        const auto area = graphics.getVisibleArea();
+        const math::vec2df chunkWorld(tileSize.x * to<float>(chunkSize), tileSize.y * to<float>(chunkSize));
+
+        auto firstChunk = [](float from, float world, int32_t count) {
+            return to<int32_t>(std::clamp(std::floor(from / world), 0.0f, to<float>(count)));
+        };
+        auto lastChunk = [](float until, float world, int32_t count) {
+            return to<int32_t>(std::clamp(std::floor(until / world) + 1.0f, 0.0f, to<float>(count)));
+        };
+
+        const auto left = firstChunk(area.left - position.x, chunkWorld.x, chunkCount.x);
+        const auto top = firstChunk(area.top - position.y, chunkWorld.y, chunkCount.y);
+        const auto right = lastChunk(area.left + area.width - position.x, chunkWorld.x, chunkCount.x);
+        const auto bottom = lastChunk(area.top + area.height - position.y, chunkWorld.y, chunkCount.y);
+
+        sf::RenderStates states(tilesetTexture);
+        states.transform.translate(position.x, position.y);
+
+        for (auto cy = top; cy < bottom; ++cy) {
+            for (auto cx = left; cx < right; ++cx) {
+                auto& c = chunks[to<std::size_t>(cy) * to<std::size_t>(chunkCount.x) + to<std::size_t>(cx)];
+
+                if (c.filled == 0) {
+                    continue;
+                }
+
+                if (useBuffers && c.dirtyFirst != c.dirtyLast) {
+                    queueUpload(graphics, { cx, cy });
+                }
+
+                // Checked again, the upload turns buffers off if the driver can't create them
+                if (useBuffers) {
+                    graphics.render(c.buffer, states);
+                }
+                else {
+                    scratch.clear();
+                    buildVertices({ cx, cy }, 0, to<uint32_t>(chunkSize * chunkSize), scratch);
+                    for (auto& v : scratch) {
+                        v.position += sf::Vector2f(position.x, position.y);
+                    }
+                    graphics.renderVertices(scratch, tilesetTexture);
+                }
+
+                ++drawnChunks;
+            }
+        }
+
+        if (switched) {
+            graphics.setTargetedLayer(previous);
+        }
+    }
+
+    void tilemap::setLayer(renderer::layer_id id) {
+        layer = id;
+    }
+
+    renderer::layer_id tilemap::getLayer() const {
+        return layer;
+    }
+
+    uint32_t tilemap::getDrawnChunks() const {
+        return drawnChunks;
+    }
+
+    uint32_t tilemap::getUploadedChunks() const {
+        return uploadedChunks;
+    }
+
+    std::size_t tilemap::tileIndex(const math::vec2di& coords) const {
+        return to<std::size_t>(coords.y) * to<std::size_t>(mapSize.x) + to<std::size_t>(coords.x);
+    }
+
+    bool tilemap::isValidIndex(tile_index index) const {
+        return index == emptyTile || tilesetTexture == nullptr || index < tilesetTiles;
+    }
+
+    void tilemap::markDirty(const math::vec2di& coords) {
+        auto& c = chunks[to<std::size_t>(coords.y / chunkSize) * to<std::size_t>(chunkCount.x) + to<std::size_t>(coords.x / chunkSize)];
+        auto slot = to<uint32_t>((coords.y % chunkSize) * chunkSize + coords.x % chunkSize);
+
+        if (c.dirtyFirst == c.dirtyLast) {
+            c.dirtyFirst = slot;
+            c.dirtyLast = slot + 1;
+        }
+        else {
+            c.dirtyFirst = std::min(c.dirtyFirst, slot);
+            c.dirtyLast = std::max(c.dirtyLast, slot + 1);
+        }
+    }
+
+    void tilemap::markAllDirty() {
+        for (auto& c : chunks) {
+            c.dirtyFirst = 0;
+            c.dirtyLast = to<uint32_t>(chunkSize * chunkSize);
+        }
+    }
+
+    void tilemap::buildVertices(const math::vec2di& chunkCoords, uint32_t first, uint32_t last, std::vector<sf::Vertex>& out) const {
+        const auto origin = chunkCoords * chunkSize;
+
+        for (auto slot = first; slot < last; ++slot) {
+            const math::vec2di coords(origin.x + to<int32_t>(slot) % chunkSize, origin.y + to<int32_t>(slot) / chunkSize);
+
+            const sf::Vector2f topLeft(to<float>(coords.x) * tileSize.x, to<float>(coords.y) * tileSize.y);
+
+            // Tiles set before a smaller tileset was picked have no texels to sample
+            if (! isInside(coords) || tiles[tileIndex(coords)].index == emptyTile || ! isValidIndex(tiles[tileIndex(coords)].index)) {
+                // Degenerate, nothing gets rasterized
+                out.insert(out.end(), 6, sf::Vertex(topLeft, sf::Color::Transparent));
+                continue;
+            }
+
+            const auto& t = tiles[tileIndex(coords)];
+            const sf::Color color = t.color;
+
+            const sf::Vector2f topRight(topLeft.x + tileSize.x, topLeft.y);
+            const sf::Vector2f bottomRight(topLeft.x + tileSize.x, topLeft.y + tileSize.y);
+            const sf::Vector2f bottomLeft(topLeft.x, topLeft.y + tileSize.y);
+
+            sf::Vector2f texTopLeft, texBottomRight;
+            if (tilesetTexture != nullptr) {
+                const auto column = t.index % tilesetColumns;
+                const auto row = t.index / tilesetColumns;
+                texTopLeft = sf::Vector2f(to<float>(tilesetRect.left + column * tileTexels.x), to<float>(tilesetRect.top + row * tileTexels.y));
+                texBottomRight = texTopLeft + sf::Vector2f(to<float>(tileTexels.x), to<float>(tileTexels.y));
+            }
+
+            out.emplace_back(topLeft, color, texTopLeft);
+            out.emplace_back(topRight, color, sf::Vector2f(texBottomRight.x, texTopLeft.y));
+            out.emplace_back(bottomRight, color, texBottomRight);
+            out.emplace_back(topLeft, color, texTopLeft);
+            out.emplace_back(bottomRight, color, texBottomRight);
+            out.emplace_back(bottomLeft, color, sf::Vector2f(texTopLeft.x, texBottomRight.y));
+        }
+    }
+
+    void tilemap::queueUpload(renderer& graphics, const math::vec2di& chunkCoords) {
+        auto& c = chunks[to<std::size_t>(chunkCoords.y) * to<std::size_t>(chunkCount.x) + to<std::size_t>(chunkCoords.x)];
+
+        if (c.uploadQueued) {
+            return;
+        }
+        c.uploadQueued = true;
+
+        // One task per frame uploads every chunk queued for it
+        if (pendingUploads.empty()) {
+            graphics.runBeforeSubmit([this] { uploadPending(); });
+        }
+        pendingUploads.push_back(chunkCoords);
+    }
+
+    void tilemap::uploadPending() {
+        for (const auto& coords : pendingUploads) {
+            auto& c = chunks[to<std::size_t>(coords.y) * to<std::size_t>(chunkCount.x) + to<std::size_t>(coords.x)];
+            c.uploadQueued = false;
+
+            if (useBuffers && c.dirtyFirst != c.dirtyLast) {
+                upload(coords, c);
+            }
+        }
+
+        pendingUploads.clear();
+    }
+
+    void tilemap::upload(const math::vec2di& chunkCoords, chunk& c) {
+        const auto slots = to<uint32_t>(chunkSize * chunkSize);
+
+        if (c.buffer.getVertexCount() == 0) {
+            if (! c.buffer.create(6 * slots)) {
+                logger::error("Couldn't create a tilemap vertex buffer, drawing chunks from memory");
+                useBuffers = false;
+                return;
+            }
+
+            c.dirtyFirst = 0;
+            c.dirtyLast = slots;
+        }
+
+        scratch.clear();
+        buildVertices(chunkCoords, c.dirtyFirst, c.dirtyLast, scratch);
+
+        c.buffer.update(scratch.data(), scratch.size(), 6 * c.dirtyFirst);
+        c.dirtyFirst = c.dirtyLast = 0;
+
+        ++uploadedChunks;
+    }
+
+}
@@ -0,0 +1,150 @@
+//
+// Created by Alcachofa
+//
+
+#include <utils/trace.hpp>
+
+#ifdef ARTI_ENABLE_TRACE
+
+#include <fstream>
+#include <algorithm>
+
+#include <fmt/format.h>
+
+#include <utils/utils.hpp>
+#include <utils/logger.hpp>
+
+namespace arti {
+
+    trace_recorder::trace_recorder()
+            : epoch(clock::now()),
+              epochTicks(now()),
+              enabled(true) {
+
+    }
+
+    trace_recorder::~trace_recorder() {
+        waitForDump();
+    }
+
+    trace_recorder& trace_recorder::get() {
+        static trace_recorder instance;
+        return instance;
+    }
+
+    void trace_recorder::setEnabled(bool enable) {
+        enabled.store(enable, std::memory_order_relaxed);
+    }
+
+    bool trace_recorder::isEnabled() const {
+        return enabled.load(std::memory_order_relaxed);
+    }
+
+    void trace_recorder::setThreadName(const char* name) {
+        threadBuffer().name.store(name, std::memory_order_release);
+    }
+
+    trace_recorder::thread_buffer& trace_recorder::registerThread() {
+        std::lock_guard<std::mutex> lock(threadsMutex);
+
+        auto buffer = std::make_unique<thread_buffer>();
+        buffer->tid = to<uint32_t>(threads.size() + 1);
+        buffer->name.store(nullptr, std::memory_order_relaxed);
+        buffer->head.store(0, std::memory_order_relaxed);
+        buffer->events = std::make_unique<event[]>(ringSize);
+
+        // Buffers are never freed, events of finished threads can still be dumped
+        threads.push_back(std::move(buffer));
+        return *threads.back();
+    }
+
+    void trace_recorder::dump(std::string_view path) {
+        std::vector<thread_snapshot> snapshot;
+
+        {
+            std::lock_guard<std::mutex> lock(threadsMutex);
+            snapshot.reserve(threads.size());
+
+            for (const auto& buffer : threads) {
+                auto end = buffer->head.load(std::memory_order_acquire);
+                auto begin = end > ringSize ? end - ringSize : 0;
+
+                thread_snapshot copy{ buffer->tid, buffer->name.load(std::memory_order_acquire), {} };
+                copy.events.reserve(to<std::size_t>(end - begin));
+                for (auto i = begin; i < end; ++i) {
+                    copy.events.push_back(buffer->events[i & (ringSize - 1)]);
+                }
+
+                // The owner kept recording while we copied, drop whatever it overwrote. It may
+                // also be halfway through slot `after`, which is copied index after - ringSize
+                auto after = buffer->head.load(std::memory_order_acquire);
+                if (after >= begin + ringSize) {
+                    auto overwritten = std::min<std::size_t>(to<std::size_t>(after + 1 - ringSize - begin), copy.events.size());
+                    copy.events.erase(copy.events.begin(), copy.events.begin() + overwritten);
+                }
+
+                snapshot.push_back(std::move(copy));
+            }
+        }
+
+        // Calibrate ticks against steady_clock over the whole recording
+        auto elapsedNs = std::chrono::duration<double, std::nano>(clock::now() - epoch).count();
+        auto elapsedTicks = to<double>(now() - epochTicks);
+        auto nsPerTick = elapsedTicks > 0.0 ? elapsedNs / elapsedTicks : 1.0;
+
+        waitForDump();
+        writer = std::thread(&trace_recorder::write, std::string(path), std::move(snapshot), epochTicks, nsPerTick);
+    }
+
+    void trace_recorder::waitForDump() {
+        if (writer.joinable()) {
+            writer.join();
+        }
+    }
+
+    void trace_recorder::write(const std::string& path, const std::vector<thread_snapshot>& snapshot, int64_t epochTicks, double nsPerTick) {
+        auto escaped = [](const char* name) {
+            std::string out;
+            for (auto c = name; *c != '\0'; ++c) {
+                if (*c == '"' || *c == '\\') {
+                    out += '\\';
+                }
+                out += *c;
+            }
+            return out;
+        };
+
+        fmt::memory_buffer out;
+        fmt::format_to(std::back_inserter(out), "{{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n");
+
+        bool first = true;
+        for (const auto& thread : snapshot) {
+            if (thread.name != nullptr) {
+                fmt::format_to(std::back_inserter(out), "{}{{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":{},\"args\":{{\"name\":\"{}\"}}}}",
+                               first ? "" : ",\n", thread.tid, escaped(thread.name));
+                first = false;
+            }
+
+            for (const auto& ev : thread.events) {
+                fmt::format_to(std::back_inserter(out), "{}{{\"name\":\"{}\",\"ph\":\"X\",\"pid\":1,\"tid\":{},\"ts\":{:.3f},\"dur\":{:.3f}}}",
+                               first ? "" : ",\n", escaped(ev.name), thread.tid,
+                               to<double>(ev.start - epochTicks) * nsPerTick / 1000.0, to<double>(ev.duration) * nsPerTick / 1000.0);
+                first = false;
+            }
+        }
+
+        fmt::format_to(std::back_inserter(out), "\n]}}\n");
+
+        std::ofstream file(path, std::ios::binary);
+        if (! file) {
+            logger::error("Couldn't open trace file {}", path);
+            return;
+        }
+
+        file.write(out.data(), to<std::streamsize>(out.size()));
+        logger::info("Trace written to {}", path);
+    }
+
+}
+
+#endif
@@ -0,0 +1,219 @@
+//
+// Created by Alcachofa
+//
+
+#include <transformed_view.hpp>
+
+#include <cmath>
+#include <algorithm>
+
+#include <renderer.hpp>
+
+#include <utils/utils.hpp>
+#include <utils/simd.hpp>
+
+namespace arti {
+
+    namespace {
+
+        static_assert(sizeof(math::vec2df) == 2 * sizeof(float), "transformed_view reads positions as packed float pairs");
+
+        void applyAffine(const transformed_view::affine& transform, span<const math::vec2df> in, span<math::vec2df> out) {
+            const auto count = std::min(in.size(), out.size());
+            std::size_t i = 0;
+
+#ifdef ARTI_SIMD_SSE2
+            // Two points per register, laid out x y x y
+            const auto scale = _mm_setr_ps(transform.scale.x, transform.scale.y, transform.scale.x, transform.scale.y);
+            const auto translation = _mm_setr_ps(transform.translation.x, transform.translation.y, transform.translation.x, transform.translation.y);
+            const auto* src = reinterpret_cast<const float*>(in.data());
+            auto* dst = reinterpret_cast<float*>(out.data());
+
+            for (; i + 4 <= count; i += 4) {
+                auto p01 = _mm_loadu_ps(src + 2 * i);
+                auto p23 = _mm_loadu_ps(src + 2 * i + 4);
+                _mm_storeu_ps(dst + 2 * i, _mm_add_ps(_mm_mul_ps(p01, scale), translation));
+                _mm_storeu_ps(dst + 2 * i + 4, _mm_add_ps(_mm_mul_ps(p23, scale), translation));
+            }
+#endif
+
+            for (; i < count; ++i) {
+                out[i] = transform.apply(in[i]);
+            }
+        }
+
+        // Eases in and out, so chained zooms don't jerk
+        float smoothstep(float t) {
+            return t * t * (3.0f - 2.0f * t);
+        }
+
+    }
+
+    transformed_view::transformed_view(const math::vec2df& viewportSize)
+            : viewOffset(0.0f, 0.0f),
+              viewScale(1.0f),
+              minScale(1e-4f),
+              maxScale(1e4f),
+              layerOffset(0.0f, 0.0f),
+              layerScale(1.0f),
+              viewportSize(viewportSize),
+              zooming(false),
+              zoomFrom(1.0f),
+              zoomTarget(1.0f),
+              zoomElapsed(0.0f),
+              zoomDuration(0.0f),
+              zoomAnchor(0.0f, 0.0f) {
+        updateTransforms();
+    }
+
+    void transformed_view::setOffset(const math::vec2df& offset) {
+        viewOffset = offset;
+        updateTransforms();
+    }
+
+    math::vec2df transformed_view::getOffset() const {
+        return viewOffset;
+    }
+
+    void transformed_view::setScale(float scale) {
+        viewScale = std::clamp(scale, minScale, maxScale);
+        zooming = false;
+        updateTransforms();
+    }
+
+    float transformed_view::getScale() const {
+        return viewScale;
+    }
+
+    void transformed_view::setScaleLimits(float minScale, float maxScale) {
+        this->minScale = std::max(minScale, 1e-6f);
+        this->maxScale = std::max(maxScale, this->minScale);
+        zoomTarget = std::clamp(zoomTarget, this->minScale, this->maxScale);
+        setScaleKeeping(viewScale, zooming ? zoomAnchor : layerOffset);
+    }
+
+    void transformed_view::pan(const math::vec2df& screenDelta) {
+        viewOffset -= screenDelta / (viewScale * layerScale);
+        updateTransforms();
+    }
+
+    void transformed_view::zoomAt(float factor, const math::vec2df& screenPoint) {
+        zooming = false;
+        setScaleKeeping(viewScale * factor, screenPoint);
+    }
+
+    void transformed_view::smoothZoomAt(float factor, const math::vec2df& screenPoint, float duration) {
+        const auto target = (zooming ? zoomTarget : viewScale) * factor;
+
+        if (duration <= 0.0f) {
+            zooming = false;
+            setScaleKeeping(target, screenPoint);
+            return;
+        }
+
+        zoomTarget = std::clamp(target, minScale, maxScale);
+        zoomFrom = viewScale;
+        zoomAnchor = screenPoint;
+        zoomElapsed = 0.0f;
+        zoomDuration = duration;
+        zooming = true;
+    }
+
+    bool transformed_view::update(float deltaTime) {
+        if (! zooming) {
+            return false;
+        }
+
+        zoomElapsed += deltaTime;
+        auto t = std::min(zoomElapsed / zoomDuration, 1.0f);
+
+        // Interpolated in log space, every step looks like the same amount of zoom
+        setScaleKeeping(zoomFrom * std::pow(zoomTarget / zoomFrom, smoothstep(t)), zoomAnchor);
+
+        if (t >= 1.0f) {
+            zooming = false;
+        }
+
+        return true;
+    }
+
+    bool transformed_view::isZooming() const {
+        return zooming;
+    }
+
+    void transformed_view::apply(renderer& graphics) {
+        auto& layer = *graphics.target;
+
+        layerOffset = layer.offset;
+        layerScale = layer.scale;
+        viewportSize = math::vec2df{ layer.texture.getSize() };
+
+        if (layer.viewOffset.x != viewOffset.x || layer.viewOffset.y != viewOffset.y || layer.viewScale != viewScale) {
+            layer.viewOffset = viewOffset;
+            layer.viewScale = viewScale;
+            graphics.applyView();
+        }
+
+        updateTransforms();
+    }
+
+    void transformed_view::worldToScreen(span<const math::vec2df> in, span<math::vec2df> out) const {
+        applyAffine(forward, in, out);
+    }
+
+    void transformed_view::screenToWorld(span<const math::vec2df> in, span<math::vec2df> out) const {
+        applyAffine(inverse, in, out);
+    }
+
+    const transformed_view::affine& transformed_view::getWorldToScreen() const {
+        return forward;
+    }
+
+    const transformed_view::affine& transformed_view::getScreenToWorld() const {
+        return inverse;
+    }
+
+    math::vec2df transformed_view::getVisibleMin() const {
+        return visibleMin;
+    }
+
+    math::vec2df transformed_view::getVisibleMax() const {
+        return visibleMax;
+    }
+
+    std::size_t transformed_view::cullBatch(span<const math::vec2df> positions, float radius, std::vector<uint32_t>& visible) const {
+        const auto before = visible.size();
+        const auto min = visibleMin - radius;
+        const auto max = visibleMax + radius;
+
+        for (std::size_t i = 0; i < positions.size(); ++i) {
+            const auto& p = positions[i];
+            if (p.x >= min.x && p.x <= max.x && p.y >= min.y && p.y <= max.y) {
+                visible.push_back(to<uint32_t>(i));
+            }
+        }
+
+        return visible.size() - before;
+    }
+
+    void transformed_view::setScaleKeeping(float scale, const math::vec2df& screenPoint) {
+        auto anchor = screenToWorld(screenPoint);
+        viewScale = std::clamp(scale, minScale, maxScale);
+        viewOffset = anchor - (screenPoint - layerOffset) / (viewScale * layerScale);
+        updateTransforms();
+    }
+
+    void transformed_view::updateTransforms() {
+        const auto s = viewScale * layerScale;
+
+        forward.scale = { s, s };
+        forward.translation = layerOffset - viewOffset * s;
+
+        inverse.scale = { 1.0f / s, 1.0f / s };
+        inverse.translation = viewOffset - layerOffset / s;
+
+        visibleMin = viewOffset;
+        visibleMax = viewOffset + viewportSize / viewScale;
+    }
+
+}
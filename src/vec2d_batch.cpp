@@ -0,0 +1,442 @@
+//
+// Created by Alcachofa
+//
+
+#include <math/vec2d_batch.hpp>
+
+#include <utils/simd.hpp>
+
+namespace arti::math::batch_ops {
+
+    static_assert(sizeof(vec2d<float>) == 2 * sizeof(float), "deinterleave reads vec2d<float> as float pairs");
+
+    namespace {
+
+        struct kernel_table {
+            void (*add)(float*, float*, const float*, const float*, std::size_t);
+            void (*sub)(float*, float*, const float*, const float*, std::size_t);
+            void (*mul)(float*, float*, const float*, const float*, std::size_t);
+            void (*offset)(float*, float*, float, float, std::size_t);
+            void (*scale)(float*, float*, float, std::size_t);
+            void (*rotate)(float*, float*, float, float, std::size_t);
+            void (*normalize)(float*, float*, std::size_t);
+            void (*dot)(const float*, const float*, const float*, const float*, float*, std::size_t);
+            void (*length)(const float*, const float*, float*, std::size_t);
+            void (*deinterleave)(const float*, float*, float*, std::size_t);
+            void (*interleave)(const float*, const float*, float*, std::size_t);
+        };
+
+        // Scalar kernels, the SIMD ones do the same operations in the same order (no FMA,
+        // no reciprocal estimates) so every level gives the same floats
+
+        void addScalar(float* x, float* y, const float* otherX, const float* otherY, std::size_t count) {
+            for (std::size_t i = 0; i < count; ++i) {
+                x[i] += otherX[i];
+                y[i] += otherY[i];
+            }
+        }
+
+        void subScalar(float* x, float* y, const float* otherX, const float* otherY, std::size_t count) {
+            for (std::size_t i = 0; i < count; ++i) {
+                x[i] -= otherX[i];
+                y[i] -= otherY[i];
+            }
+        }
+
+        void mulScalar(float* x, float* y, const float* otherX, const float* otherY, std::size_t count) {
+            for (std::size_t i = 0; i < count; ++i) {
+                x[i] *= otherX[i];
+                y[i] *= otherY[i];
+            }
+        }
+
+        void offsetScalar(float* x, float* y, float offsetX, float offsetY, std::size_t count) {
+            for (std::size_t i = 0; i < count; ++i) {
+                x[i] += offsetX;
+                y[i] += offsetY;
+            }
+        }
+
+        void scaleScalar(float* x, float* y, float factor, std::size_t count) {
+            for (std::size_t i = 0; i < count; ++i) {
+                x[i] *= factor;
+                y[i] *= factor;
+            }
+        }
+
+        void rotateScalar(float* x, float* y, float cos, float sin, std::size_t count) {
+            for (std::size_t i = 0; i < count; ++i) {
+                const float px = x[i];
+                const float py = y[i];
+                x[i] = px * cos - py * sin;
+                y[i] = px * sin + py * cos;
+            }
+        }
+
+        void normalizeScalar(float* x, float* y, std::size_t count) {
+            for (std::size_t i = 0; i < count; ++i) {
+                const float length = std::sqrt(x[i] * x[i] + y[i] * y[i]);
+                const float inverse = length > 0 ? 1.0f / length : 0.0f;
+                x[i] *= inverse;
+                y[i] *= inverse;
+            }
+        }
+
+        void dotScalar(const float* x, const float* y, const float* otherX, const float* otherY, float* out, std::size_t count) {
+            for (std::size_t i = 0; i < count; ++i) {
+                out[i] = x[i] * otherX[i] + y[i] * otherY[i];
+            }
+        }
+
+        void lengthScalar(const float* x, const float* y, float* out, std::size_t count) {
+            for (std::size_t i = 0; i < count; ++i) {
+                out[i] = std::sqrt(x[i] * x[i] + y[i] * y[i]);
+            }
+        }
+
+        void deinterleaveScalar(const float* pairs, float* x, float* y, std::size_t count) {
+            for (std::size_t i = 0; i < count; ++i) {
+                x[i] = pairs[2 * i];
+                y[i] = pairs[2 * i + 1];
+            }
+        }
+
+        void interleaveScalar(const float* x, const float* y, float* pairs, std::size_t count) {
+            for (std::size_t i = 0; i < count; ++i) {
+                pairs[2 * i] = x[i];
+                pairs[2 * i + 1] = y[i];
+            }
+        }
+
+        constexpr kernel_table scalarKernels = {
+                addScalar,
+                subScalar,
+                mulScalar,
+                offsetScalar,
+                scaleScalar,
+                rotateScalar,
+                normalizeScalar,
+                dotScalar,
+                lengthScalar,
+                deinterleaveScalar,
+                interleaveScalar
+        };
+
+#ifdef ARTI_SIMD_SSE2
+        void addSSE2(float* x, float* y, const float* otherX, const float* otherY, std::size_t count) {
+            std::size_t i = 0;
+            for (; i + 4 <= count; i += 4) {
+                _mm_storeu_ps(x + i, _mm_add_ps(_mm_loadu_ps(x + i), _mm_loadu_ps(otherX + i)));
+                _mm_storeu_ps(y + i, _mm_add_ps(_mm_loadu_ps(y + i), _mm_loadu_ps(otherY + i)));
+            }
+            addScalar(x + i, y + i, otherX + i, otherY + i, count - i);
+        }
+
+        void subSSE2(float* x, float* y, const float* otherX, const float* otherY, std::size_t count) {
+            std::size_t i = 0;
+            for (; i + 4 <= count; i += 4) {
+                _mm_storeu_ps(x + i, _mm_sub_ps(_mm_loadu_ps(x + i), _mm_loadu_ps(otherX + i)));
+                _mm_storeu_ps(y + i, _mm_sub_ps(_mm_loadu_ps(y + i), _mm_loadu_ps(otherY + i)));
+            }
+            subScalar(x + i, y + i, otherX + i, otherY + i, count - i);
+        }
+
+        void mulSSE2(float* x, float* y, const float* otherX, const float* otherY, std::size_t count) {
+            std::size_t i = 0;
+            for (; i + 4 <= count; i += 4) {
+                _mm_storeu_ps(x + i, _mm_mul_ps(_mm_loadu_ps(x + i), _mm_loadu_ps(otherX + i)));
+                _mm_storeu_ps(y + i, _mm_mul_ps(_mm_loadu_ps(y + i), _mm_loadu_ps(otherY + i)));
+            }
+            mulScalar(x + i, y + i, otherX + i, otherY + i, count - i);
+        }
+
+        void offsetSSE2(float* x, float* y, float offsetX, float offsetY, std::size_t count) {
+            const auto ox = _mm_set1_ps(offsetX);
+            const auto oy = _mm_set1_ps(offsetY);
+
+            std::size_t i = 0;
+            for (; i + 4 <= count; i += 4) {
+                _mm_storeu_ps(x + i, _mm_add_ps(_mm_loadu_ps(x + i), ox));
+                _mm_storeu_ps(y + i, _mm_add_ps(_mm_loadu_ps(y + i), oy));
+            }
+            offsetScalar(x + i, y + i, offsetX, offsetY, count - i);
+        }
+
+        void scaleSSE2(float* x, float* y, float factor, std::size_t count) {
+            const auto f = _mm_set1_ps(factor);
+
+            std::size_t i = 0;
+            for (; i + 4 <= count; i += 4) {
+                _mm_storeu_ps(x + i, _mm_mul_ps(_mm_loadu_ps(x + i), f));
+                _mm_storeu_ps(y + i, _mm_mul_ps(_mm_loadu_ps(y + i), f));
+            }
+            scaleScalar(x + i, y + i, factor, count - i);
+        }
+
+        void rotateSSE2(float* x, float* y, float cos, float sin, std::size_t count) {
+            const auto c = _mm_set1_ps(cos);
+            const auto s = _mm_set1_ps(sin);
+
+            std::size_t i = 0;
+            for (; i + 4 <= count; i += 4) {
+                const auto px = _mm_loadu_ps(x + i);
+                const auto py = _mm_loadu_ps(y + i);
+                _mm_storeu_ps(x + i, _mm_sub_ps(_mm_mul_ps(px, c), _mm_mul_ps(py, s)));
+                _mm_storeu_ps(y + i, _mm_add_ps(_mm_mul_ps(px, s), _mm_mul_ps(py, c)));
+            }
+            rotateScalar(x + i, y + i, cos, sin, count - i);
+        }
+
+        void normalizeSSE2(float* x, float* y, std::size_t count) {
+            const auto one = _mm_set1_ps(1.0f);
+            const auto zero = _mm_setzero_ps();
+
+            std::size_t i = 0;
+            for (; i + 4 <= count; i += 4) {
+                const auto px = _mm_loadu_ps(x + i);
+                const auto py = _mm_loadu_ps(y + i);
+                const auto length = _mm_sqrt_ps(_mm_add_ps(_mm_mul_ps(px, px), _mm_mul_ps(py, py)));
+                const auto inverse = _mm_and_ps(_mm_cmpgt_ps(length, zero), _mm_div_ps(one, length));
+                _mm_storeu_ps(x + i, _mm_mul_ps(px, inverse));
+                _mm_storeu_ps(y + i, _mm_mul_ps(py, inverse));
+            }
+            normalizeScalar(x + i, y + i, count - i);
+        }
+
+        void dotSSE2(const float* x, const float* y, const float* otherX, const float* otherY, float* out, std::size_t count) {
+            std::size_t i = 0;
+            for (; i + 4 <= count; i += 4) {
+                const auto px = _mm_mul_ps(_mm_loadu_ps(x + i), _mm_loadu_ps(otherX + i));
+                const auto py = _mm_mul_ps(_mm_loadu_ps(y + i), _mm_loadu_ps(otherY + i));
+                _mm_storeu_ps(out + i, _mm_add_ps(px, py));
+            }
+            dotScalar(x + i, y + i, otherX + i, otherY + i, out + i, count - i);
+        }
+
+        void lengthSSE2(const float* x, const float* y, float* out, std::size_t count) {
+            std::size_t i = 0;
+            for (; i + 4 <= count; i += 4) {
+                const auto px = _mm_loadu_ps(x + i);
+                const auto py = _mm_loadu_ps(y + i);
+                _mm_storeu_ps(out + i, _mm_sqrt_ps(_mm_add_ps(_mm_mul_ps(px, px), _mm_mul_ps(py, py))));
+            }
+            lengthScalar(x + i, y + i, out + i, count - i);
+        }
+
+        // The AVX2 level uses these too, 256-bit shuffles stay within 128-bit halves
+        void deinterleaveSSE2(const float* pairs, float* x, float* y, std::size_t count) {
+            std::size_t i = 0;
+            for (; i + 4 <= count; i += 4) {
+                const auto low = _mm_loadu_ps(pairs + 2 * i);
+                const auto high = _mm_loadu_ps(pairs + 2 * i + 4);
+                _mm_storeu_ps(x + i, _mm_shuffle_ps(low, high, _MM_SHUFFLE(2, 0, 2, 0)));
+                _mm_storeu_ps(y + i, _mm_shuffle_ps(low, high, _MM_SHUFFLE(3, 1, 3, 1)));
+            }
+            deinterleaveScalar(pairs + 2 * i, x + i, y + i, count - i);
+        }
+
+        void interleaveSSE2(const float* x, const float* y, float* pairs, std::size_t count) {
+            std::size_t i = 0;
+            for (; i + 4 <= count; i += 4) {
+                const auto px = _mm_loadu_ps(x + i);
+                const auto py = _mm_loadu_ps(y + i);
+                _mm_storeu_ps(pairs + 2 * i, _mm_unpacklo_ps(px, py));
+                _mm_storeu_ps(pairs + 2 * i + 4, _mm_unpackhi_ps(px, py));
+            }
+            interleaveScalar(x + i, y + i, pairs + 2 * i, count - i);
+        }
+
+        constexpr kernel_table sse2Kernels = {
+                addSSE2,
+                subSSE2,
+                mulSSE2,
+                offsetSSE2,
+                scaleSSE2,
+                rotateSSE2,
+                normalizeSSE2,
+                dotSSE2,
+                lengthSSE2,
+                deinterleaveSSE2,
+                interleaveSSE2
+        };
+#endif
+
+#ifdef ARTI_SIMD_AVX2
+        ARTI_TARGET_AVX2 void addAVX2(float* x, float* y, const float* otherX, const float* otherY, std::size_t count) {
+            std::size_t i = 0;
+            for (; i + 8 <= count; i += 8) {
+                _mm256_storeu_ps(x + i, _mm256_add_ps(_mm256_loadu_ps(x + i), _mm256_loadu_ps(otherX + i)));
+                _mm256_storeu_ps(y + i, _mm256_add_ps(_mm256_loadu_ps(y + i), _mm256_loadu_ps(otherY + i)));
+            }
+            addScalar(x + i, y + i, otherX + i, otherY + i, count - i);
+        }
+
+        ARTI_TARGET_AVX2 void subAVX2(float* x, float* y, const float* otherX, const float* otherY, std::size_t count) {
+            std::size_t i = 0;
+            for (; i + 8 <= count; i += 8) {
+                _mm256_storeu_ps(x + i, _mm256_sub_ps(_mm256_loadu_ps(x + i), _mm256_loadu_ps(otherX + i)));
+                _mm256_storeu_ps(y + i, _mm256_sub_ps(_mm256_loadu_ps(y + i), _mm256_loadu_ps(otherY + i)));
+            }
+            subScalar(x + i, y + i, otherX + i, otherY + i, count - i);
+        }
+
+        ARTI_TARGET_AVX2 void mulAVX2(float* x, float* y, const float* otherX, const float* otherY, std::size_t count) {
+            std::size_t i = 0;
+            for (; i + 8 <= count; i += 8) {
+                _mm256_storeu_ps(x + i, _mm256_mul_ps(_mm256_loadu_ps(x + i), _mm256_loadu_ps(otherX + i)));
+                _mm256_storeu_ps(y + i, _mm256_mul_ps(_mm256_loadu_ps(y + i), _mm256_loadu_ps(otherY + i)));
+            }
+            mulScalar(x + i, y + i, otherX + i, otherY + i, count - i);
+        }
+
+        ARTI_TARGET_AVX2 void offsetAVX2(float* x, float* y, float offsetX, float offsetY, std::size_t count) {
+            const auto ox = _mm256_set1_ps(offsetX);
+            const auto oy = _mm256_set1_ps(offsetY);
+
+            std::size_t i = 0;
+            for (; i + 8 <= count; i += 8) {
+                _mm256_storeu_ps(x + i, _mm256_add_ps(_mm256_loadu_ps(x + i), ox));
+                _mm256_storeu_ps(y + i, _mm256_add_ps(_mm256_loadu_ps(y + i), oy));
+            }
+            offsetScalar(x + i, y + i, offsetX, offsetY, count - i);
+        }
+
+        ARTI_TARGET_AVX2 void scaleAVX2(float* x, float* y, float factor, std::size_t count) {
+            const auto f = _mm256_set1_ps(factor);
+
+            std::size_t i = 0;
+            for (; i + 8 <= count; i += 8) {
+                _mm256_storeu_ps(x + i, _mm256_mul_ps(_mm256_loadu_ps(x + i), f));
+                _mm256_storeu_ps(y + i, _mm256_mul_ps(_mm256_loadu_ps(y + i), f));
+            }
+            scaleScalar(x + i, y + i, factor, count - i);
+        }
+
+        ARTI_TARGET_AVX2 void rotateAVX2(float* x, float* y, float cos, float sin, std::size_t count) {
+            const auto c = _mm256_set1_ps(cos);
+            const auto s = _mm256_set1_ps(sin);
+
+            std::size_t i = 0;
+            for (; i + 8 <= count; i += 8) {
+                const auto px = _mm256_loadu_ps(x + i);
+                const auto py = _mm256_loadu_ps(y + i);
+                _mm256_storeu_ps(x + i, _mm256_sub_ps(_mm256_mul_ps(px, c), _mm256_mul_ps(py, s)));
+                _mm256_storeu_ps(y + i, _mm256_add_ps(_mm256_mul_ps(px, s), _mm256_mul_ps(py, c)));
+            }
+            rotateScalar(x + i, y + i, cos, sin, count - i);
+        }
+
+        ARTI_TARGET_AVX2 void normalizeAVX2(float* x, float* y, std::size_t count) {
+            const auto one = _mm256_set1_ps(1.0f);
+            const auto zero = _mm256_setzero_ps();
+
+            std::size_t i = 0;
+            for (; i + 8 <= count; i += 8) {
+                const auto px = _mm256_loadu_ps(x + i);
+                const auto py = _mm256_loadu_ps(y + i);
+                const auto length = _mm256_sqrt_ps(_mm256_add_ps(_mm256_mul_ps(px, px), _mm256_mul_ps(py, py)));
+                const auto inverse = _mm256_and_ps(_mm256_cmp_ps(length, zero, _CMP_GT_OQ), _mm256_div_ps(one, length));
+                _mm256_storeu_ps(x + i, _mm256_mul_ps(px, inverse));
+                _mm256_storeu_ps(y + i, _mm256_mul_ps(py, inverse));
+            }
+            normalizeScalar(x + i, y + i, count - i);
+        }
+
+        ARTI_TARGET_AVX2 void dotAVX2(const float* x, const float* y, const float* otherX, const float* otherY, float* out, std::size_t count) {
+            std::size_t i = 0;
+            for (; i + 8 <= count; i += 8) {
+                const auto px = _mm256_mul_ps(_mm256_loadu_ps(x + i), _mm256_loadu_ps(otherX + i));
+                const auto py = _mm256_mul_ps(_mm256_loadu_ps(y + i), _mm256_loadu_ps(otherY + i));
+                _mm256_storeu_ps(out + i, _mm256_add_ps(px, py));
+            }
+            dotScalar(x + i, y + i, otherX + i, otherY + i, out + i, count - i);
+        }
+
+        ARTI_TARGET_AVX2 void lengthAVX2(const float* x, const float* y, float* out, std::size_t count) {
+            std::size_t i = 0;
+            for (; i + 8 <= count; i += 8) {
+                const auto px = _mm256_loadu_ps(x + i);
+                const auto py = _mm256_loadu_ps(y + i);
+                _mm256_storeu_ps(out + i, _mm256_sqrt_ps(_mm256_add_ps(_mm256_mul_ps(px, px), _mm256_mul_ps(py, py))));
+            }
+            lengthScalar(x + i, y + i, out + i, count - i);
+        }
+
+        constexpr kernel_table avx2Kernels = {
+                addAVX2,
+                subAVX2,
+                mulAVX2,
+                offsetAVX2,
+                scaleAVX2,
+                rotateAVX2,
+                normalizeAVX2,
+                dotAVX2,
+                lengthAVX2,
+                deinterleaveSSE2,
+                interleaveSSE2
+        };
+#endif
+
+        // Follows simd::setLevel()
+        const kernel_table& activeKernels() {
+            switch (simd::activeLevel()) {
+#ifdef ARTI_SIMD_AVX2
+                case simd::level::AVX2:
+                    return avx2Kernels;
+#endif
+#ifdef ARTI_SIMD_SSE2
+                case simd::level::SSE2:
+                    return sse2Kernels;
+#endif
+                default:
+                    return scalarKernels;
+            }
+        }
+
+    }
+
+    void add(float* x, float* y, const float* otherX, const float* otherY, std::size_t count) {
+        activeKernels().add(x, y, otherX, otherY, count);
+    }
+
+    void sub(float* x, float* y, const float* otherX, const float* otherY, std::size_t count) {
+        activeKernels().sub(x, y, otherX, otherY, count);
+    }
+
+    void mul(float* x, float* y, const float* otherX, const float* otherY, std::size_t count) {
+        activeKernels().mul(x, y, otherX, otherY, count);
+    }
+
+    void offset(float* x, float* y, float offsetX, float offsetY, std::size_t count) {
+        activeKernels().offset(x, y, offsetX, offsetY, count);
+    }
+
+    void scale(float* x, float* y, float factor, std::size_t count) {
+        activeKernels().scale(x, y, factor, count);
+    }
+
+    void rotate(float* x, float* y, float cos, float sin, std::size_t count) {
+        activeKernels().rotate(x, y, cos, sin, count);
+    }
+
+    void normalize(float* x, float* y, std::size_t count) {
+        activeKernels().normalize(x, y, count);
+    }
+
+    void dot(const float* x, const float* y, const float* otherX, const float* otherY, float* out, std::size_t count) {
+        activeKernels().dot(x, y, otherX, otherY, out, count);
+    }
+
+    void length(const float* x, const float* y, float* out, std::size_t count) {
+        activeKernels().length(x, y, out, count);
+    }
+
+    void deinterleave(const vec2d<float>* vectors, float* x, float* y, std::size_t count) {
+        activeKernels().deinterleave(reinterpret_cast<const float*>(vectors), x, y, count);
+    }
+
+    void interleave(const float* x, const float* y, vec2d<float>* vectors, std::size_t count) {
+        activeKernels().interleave(x, y, reinterpret_cast<float*>(vectors), count);
+    }
+
+}
@@ -0,0 +1,116 @@
+//
+// Created by Alcachofa
+//
+
+#include <utils/worker_pool.hpp>
+
+#include <utils/utils.hpp>
+#include <utils/trace.hpp>
+
+namespace arti {
+
+    worker_pool::worker_pool(uint32_t workers)
+            : workerCount(workers),
+              stopping(false),
+              generation(0),
+              busy(0),
+              current(nullptr),
+              taskCount(0),
+              nextTask(0) {
+    }
+
+    worker_pool::~worker_pool() {
+        stopWorkers();
+    }
+
+    void worker_pool::setWorkerCount(uint32_t workers) {
+        if (workers != workerCount) {
+            stopWorkers();
+            workerCount = workers;
+        }
+    }
+
+    uint32_t worker_pool::getWorkerCount() const {
+        return workerCount;
+    }
+
+    void worker_pool::run(std::size_t tasks, const std::function<void(std::size_t)>& task) {
+        if (workerCount == 0 || tasks <= 1) {
+            for (std::size_t i = 0; i < tasks; ++i) {
+                task(i);
+            }
+            return;
+        }
+
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+
+            if (workers.empty()) {
+                stopping = false;
+                // Started before the generation bump below, so they pick up this run
+                for (uint32_t i = 0; i < workerCount; ++i) {
+                    workers.emplace_back(&worker_pool::workerLoop, this, generation);
+                }
+            }
+
+            current = &task;
+            taskCount = tasks;
+            nextTask.store(0, std::memory_order_relaxed);
+            busy = to<uint32_t>(workers.size());
+            ++generation;
+        }
+
+        startSignal.notify_all();
+
+        drain();
+
+        std::unique_lock<std::mutex> lock(mutex);
+        doneSignal.wait(lock, [this] { return busy == 0; });
+        current = nullptr;
+    }
+
+    void worker_pool::workerLoop(uint64_t seen) {
+        ARTI_TRACE_THREAD("Pool worker");
+
+        std::unique_lock<std::mutex> lock(mutex);
+
+        while (true) {
+            startSignal.wait(lock, [&] { return stopping || generation != seen; });
+
+            if (stopping) {
+                return;
+            }
+
+            seen = generation;
+
+            lock.unlock();
+            drain();
+            lock.lock();
+
+            if (--busy == 0) {
+                doneSignal.notify_one();
+            }
+        }
+    }
+
+    void worker_pool::drain() {
+        for (auto i = nextTask.fetch_add(1, std::memory_order_relaxed); i < taskCount; i = nextTask.fetch_add(1, std::memory_order_relaxed)) {
+            (*current)(i);
+        }
+    }
+
+    void worker_pool::stopWorkers() {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            stopping = true;
+        }
+
+        startSignal.notify_all();
+
+        for (auto& worker : workers) {
+            worker.join();
+        }
+        workers.clear();
+    }
+
+}